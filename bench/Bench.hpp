@@ -0,0 +1,48 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "Player.hpp"
+#include "Utils.hpp"
+
+// Small helpers shared by the benchmarks in this directory.
+
+// Prevent the compiler from optimizing away a computed value.
+template <typename T>
+void keep(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Run f repeatedly for roughly minSeconds and return the average time per call in nanoseconds.
+template <typename F>
+double nsPerCall(F f, double minSeconds = 0.5) {
+  using Clock = std::chrono::steady_clock;
+  f(); // Warm up caches and buffers.
+  uint64_t calls = 0;
+  auto start = Clock::now();
+  std::chrono::duration<double> elapsed{0};
+  do {
+    for (int i = 0; i < 16; i++)
+      f();
+    calls += 16;
+    elapsed = Clock::now() - start;
+  } while (elapsed.count() < minSeconds);
+  return elapsed.count() * 1e9 / calls;
+}
+
+// Read an integer command line argument, falling back to a default.
+int intArg(int argc, char* argv[], int index, int fallback) {
+  return argc > index ? std::stoi(argv[index]) : fallback;
+}
+
+// A player with the given ID at a random place inside the world.
+Player randomPlayer(uint32_t id, const WorldSize& world, std::mt19937& rng) {
+  return Player(rng() % (world.width - PLAYER_SIDE), rng() % (world.height - PLAYER_SIDE), id);
+}
+
+#endif
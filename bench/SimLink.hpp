@@ -0,0 +1,45 @@
+#ifndef SIM_LINK_H
+#define SIM_LINK_H
+
+#include <cstdint>
+#include <deque>
+#include <random>
+
+// One direction of a simulated connection that delivers messages in order after a delay of
+// delay to delay + jitter time units, losing each message with the given probability.
+template <typename T>
+class DelayedLink {
+  struct InFlight {
+    uint64_t deliverAt;
+    T msg;
+  };
+  std::deque<InFlight> inFlight_;
+  int delay_;
+  int jitter_;
+  double loss_;
+  std::mt19937& rng_;
+
+public:
+  DelayedLink(int delay, int jitter, double loss, std::mt19937& rng)
+    : delay_(delay), jitter_(jitter), loss_(loss), rng_(rng) {}
+
+  void send(uint64_t now, T msg) {
+    if (std::uniform_real_distribution<double>(0, 1)(rng_) < loss_)
+      return;
+    uint64_t deliverAt = now + delay_ + (jitter_ > 0 ? rng_() % (jitter_ + 1) : 0);
+    // Like TCP, a message is never delivered before one sent earlier.
+    if (!inFlight_.empty() && deliverAt < inFlight_.back().deliverAt)
+      deliverAt = inFlight_.back().deliverAt;
+    inFlight_.push_back({deliverAt, std::move(msg)});
+  }
+
+  template <typename F>
+  void deliver(uint64_t now, F f) {
+    while (!inFlight_.empty() && inFlight_.front().deliverAt <= now) {
+      f(inFlight_.front().msg);
+      inFlight_.pop_front();
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,147 @@
+// Size and encode time of the snapshots sent to each client, with and without area of interest
+// filtering, in worlds that grow with the number of players so that the players are as
+// crowded in every run. With filtering, both should stay about the same as the population grows.
+// The filtered snapshots of every CHECK_EVERY-th client are decoded like a client would and
+// checked to hold exactly the players and bullets in the client's area of interest; the
+// benchmark fails if one does not. The other clients acknowledge every snapshot unseen.
+// Usage: aoi_bench [snapshots] [bullets per player]
+
+#include <cmath>
+#include <random>
+#include <set>
+#include <tuple>
+
+#include "Bench.hpp"
+#include "Snapshot.hpp"
+
+// Side of the world per square root of the number of players: 100 players get a world of
+// 3000 x 3000, in which a client's area of interest holds about a fifth of them.
+const int WORLD_SIDE_PER_ROOT_PLAYER = 300;
+// Clients whose snapshots are decoded and checked. Each client decoding keeps its own history
+// of snapshots, so only some of them do, to keep the memory used down.
+const int CHECK_EVERY = 8;
+
+struct Result {
+  double keyframeBytes = 0; // Mean size of the first snapshot sent to a client.
+  double deltaBytes = 0;    // Mean size of the later snapshots.
+  double encodeUs = 0;      // Time to make one client's snapshot, including its share of building the index.
+  bool ok = true;
+};
+
+// Whether a decoded snapshot holds exactly what is in the area of interest of the player with
+// the given ID in the game.
+bool holdsAreaOf(const Game& decoded, const Game& game, uint32_t id) {
+  Rect view = cameraView(game.getPlayers().at(id).getPos(), game.getWorldSize());
+  Rect area = {view.x - INTEREST_MARGIN, view.y - INTEREST_MARGIN,
+               view.w + 2 * INTEREST_MARGIN, view.h + 2 * INTEREST_MARGIN};
+  std::set<std::tuple<uint32_t, int, int>> expected, actual;
+  for (auto& [pid, player] : game.getPlayers()) {
+    if (collidesRect({player.getPos().x, player.getPos().y, PLAYER_SIDE, PLAYER_SIDE}, area))
+      expected.insert({pid, player.getPos().x, player.getPos().y});
+  }
+  for (auto& [pid, player] : decoded.getPlayers())
+    actual.insert({pid, player.getPos().x, player.getPos().y});
+  const BulletPool& bullets = game.getBullets();
+  for (std::size_t i = 0; i < bullets.size(); i++) {
+    if (collidesRect({bullets.xs()[i], bullets.ys()[i], 2 * BULLET_SIDE, BULLET_SIDE}, area))
+      expected.insert({bullets.ids()[i] | 1u << 31, bullets.xs()[i], bullets.ys()[i]});
+  }
+  const BulletPool& decodedBullets = decoded.getBullets();
+  for (std::size_t i = 0; i < decodedBullets.size(); i++)
+    actual.insert({decodedBullets.ids()[i] | 1u << 31, decodedBullets.xs()[i], decodedBullets.ys()[i]});
+  return expected == actual;
+}
+
+Result run(int numPlayers, int bulletsPerPlayer, int numSnapshots, bool filter) {
+  int side = static_cast<int>(std::sqrt(numPlayers) * WORLD_SIDE_PER_ROOT_PLAYER);
+  WorldSize world = {side, side};
+  std::mt19937 rng(11);
+  Game game(world);
+  for (int id = 0; id < numPlayers; id++)
+    game.addPlayer(randomPlayer(id, world, rng));
+  SnapshotHistory history(world, filter);
+  std::vector<SnapshotReceiver> receivers(filter ? (numPlayers + CHECK_EVERY - 1) / CHECK_EVERY : 0);
+  std::vector<uint8_t> held(numPlayers, 0);
+  uint32_t nextBulletId = 0;
+
+  Result result;
+  uint64_t deltaBytes = 0;
+  uint64_t deltas = 0;
+  double encodeSeconds = 0;
+  for (int s = 0; s < numSnapshots; s++) {
+    // Players wander about, and bullets are kept in flight across the world.
+    for (auto& [id, player] : game.getPlayers()) {
+      if (rng() % 20 == 0)
+        held[id] = rng() % PlayerInput::bit(PlayerAction::FireBullet);
+      game.applyInput(id, PlayerInput{static_cast<uint32_t>(s + 1), static_cast<uint32_t>(s), held[id]});
+    }
+    while (game.getBullets().size() < static_cast<std::size_t>(numPlayers * bulletsPerPlayer) &&
+           !game.getBullets().full()) {
+      uint32_t owner = rng() % numPlayers;
+      game.addBullet(owner, Bullet(rng() % world.width, rng() % world.height, rng() % 360, nextBulletId++));
+    }
+    for (uint32_t id : game.advance())
+      game.addPlayer(randomPlayer(id, world, rng));
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t seq = history.push(game);
+    std::vector<FramePtr<GameMessage>> frames;
+    for (int id = 0; id < numPlayers; id++)
+      frames.push_back(history.frameFor(id));
+    encodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (int id = 0; id < numPlayers; id++) {
+      const Frame<GameMessage>& frame = *frames[id];
+      if (s == 0)
+        result.keyframeBytes += frame.body().size();
+      else {
+        deltaBytes += frame.body().size();
+        deltas++;
+      }
+      if (!filter || id % CHECK_EVERY != 0) {
+        history.ack(id, seq);
+        continue;
+      }
+      SnapshotReceiver& receiver = receivers[id / CHECK_EVERY];
+      Message<GameMessage> msg{frame.header(), frame.body()};
+      if (!receiver.receive(msg)) {
+        std::cout << "snapshot " << s << " for client " << id << " could not be decoded\n";
+        result.ok = false;
+        return result;
+      }
+      history.ack(id, receiver.latestSeq());
+      if (!holdsAreaOf(receiver.latest(), game, id)) {
+        std::cout << "snapshot " << s << " for client " << id << " does not hold its area of interest\n";
+        result.ok = false;
+        return result;
+      }
+    }
+  }
+  result.keyframeBytes /= numPlayers;
+  result.deltaBytes = static_cast<double>(deltaBytes) / deltas;
+  result.encodeUs = encodeSeconds * 1e6 / (static_cast<double>(numSnapshots) * numPlayers);
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  int numSnapshots = intArg(argc, argv, 1, 60);
+  int bulletsPerPlayer = intArg(argc, argv, 2, 2);
+
+  std::cout << "window " << SCREEN_WIDTH << " x " << SCREEN_HEIGHT << ", margin " << INTEREST_MARGIN
+            << ", " << bulletsPerPlayer << " bullets per player, " << numSnapshots << " snapshots\n";
+  std::cout << "players  world  | whole world: keyframe B  delta B  encode us"
+            << "  | area of interest: keyframe B  delta B  encode us\n";
+  for (int numPlayers : {100, 400, 1600}) {
+    Result whole = run(numPlayers, bulletsPerPlayer, numSnapshots, false);
+    Result filtered = run(numPlayers, bulletsPerPlayer, numSnapshots, true);
+    if (!whole.ok || !filtered.ok) {
+      std::cout << "FAILED\n";
+      return 1;
+    }
+    int side = static_cast<int>(std::sqrt(numPlayers) * WORLD_SIDE_PER_ROOT_PLAYER);
+    std::cout << numPlayers << "  " << side << "  | " << whole.keyframeBytes << "  " << whole.deltaBytes << "  "
+              << whole.encodeUs << "  | " << filtered.keyframeBytes << "  " << filtered.deltaBytes << "  "
+              << filtered.encodeUs << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,137 @@
+// Size of the snapshot deltas sent to clients as bullets are fired at a fixed rate in worlds of
+// growing size, where bullets fly for longer and so more of them are in flight. Bullets are sent
+// as spawn and despawn events, so the deltas should grow with the rate of fire and not with the
+// number of bullets in flight; for comparison, the size of sending the position of every bullet
+// every tick is shown too. Every client decodes its snapshots. With the whole world sent, each
+// client's bullets are checked to be exactly the server's, positions included; with area of
+// interest filtering, each despawn is checked to say the bullet left the view if and only if
+// it is still in the game. The benchmark fails if a check does not hold. The despawns decoded
+// are counted by reason.
+// Usage: bullet_bench [ticks] [players] [ticks between shots]
+
+#include <random>
+#include <set>
+#include <tuple>
+
+#include "Bench.hpp"
+#include "Snapshot.hpp"
+
+// Size of an ID and a position, as sending every bullet's position would take.
+const int BULLET_POSITION_BYTES = 12;
+
+struct Result {
+  double bulletsInFlight = 0; // Mean number of bullets in the game.
+  double spawnsPerTick = 0;   // Bullets fired per tick.
+  double deltaBytes = 0;      // Mean size of a delta sent to a client.
+  double positionBytes = 0;   // Mean size of the positions of all the bullets in the game.
+  uint64_t despawns[4] = {};  // Despawns decoded by the clients, by reason.
+  bool ok = true;
+};
+
+// Whether the decoded game has exactly the bullets of the game, where the game has them.
+bool sameBullets(const Game& decoded, const Game& game) {
+  std::set<std::tuple<uint32_t, int, int>> expected, actual;
+  const BulletPool& bullets = game.getBullets();
+  for (std::size_t i = 0; i < bullets.size(); i++)
+    expected.insert({bullets.ids()[i], bullets.xs()[i], bullets.ys()[i]});
+  const BulletPool& decodedBullets = decoded.getBullets();
+  for (std::size_t i = 0; i < decodedBullets.size(); i++)
+    actual.insert({decodedBullets.ids()[i], decodedBullets.xs()[i], decodedBullets.ys()[i]});
+  return expected == actual;
+}
+
+bool hasBullet(const Game& game, uint32_t id) {
+  const BulletPool& bullets = game.getBullets();
+  return std::find(bullets.ids(), bullets.ids() + bullets.size(), id) != bullets.ids() + bullets.size();
+}
+
+Result run(const WorldSize& world, bool filter, int numPlayers, int fireEvery, int numTicks) {
+  std::mt19937 rng(5);
+  Game game(world);
+  for (int id = 0; id < numPlayers; id++)
+    game.addPlayer(randomPlayer(id, world, rng));
+  SnapshotHistory history(world, filter);
+  std::vector<SnapshotReceiver> receivers(numPlayers);
+  uint32_t nextBulletId = 0;
+
+  Result result;
+  uint64_t bullets = 0;
+  uint64_t spawns = 0;
+  uint64_t deltaBytes = 0;
+  uint64_t deltas = 0;
+  for (int t = 0; t < numTicks; t++) {
+    // Every player fires every fireEvery ticks in a random direction; players are spread over
+    // the ticks so that the rate of fire is even.
+    for (auto& [id, player] : game.getPlayers()) {
+      if ((t + id) % fireEvery == 0) {
+        game.addBullet(id, Bullet(player.getPos().x, player.getPos().y, rng() % 360, nextBulletId++));
+        spawns++;
+      }
+    }
+    for (uint32_t id : game.advance())
+      game.addPlayer(randomPlayer(id, world, rng));
+    bullets += game.getBullets().size();
+
+    uint32_t seq = history.push(game);
+    for (int id = 0; id < numPlayers; id++) {
+      FramePtr<GameMessage> frame = history.frameFor(id);
+      if (t > 0) {
+        deltaBytes += frame->body().size();
+        deltas++;
+      }
+      SnapshotReceiver& receiver = receivers[id];
+      Message<GameMessage> msg{frame->header(), frame->body()};
+      if (!receiver.receive(msg)) {
+        std::cout << "snapshot " << seq << " for client " << id << " could not be decoded\n";
+        result.ok = false;
+        return result;
+      }
+      history.ack(id, receiver.latestSeq());
+      if (!filter && !sameBullets(receiver.latest(), game)) {
+        std::cout << "client " << id << " does not have the bullets of snapshot " << seq << "\n";
+        result.ok = false;
+        return result;
+      }
+      for (const BulletDespawn& d : receiver.latestDespawns()) {
+        result.despawns[static_cast<int>(d.reason)]++;
+        if ((d.reason == DespawnReason::LeftView) != hasBullet(game, d.id)) {
+          std::cout << "client " << id << " was told bullet " << d.id << " is gone from snapshot " << seq
+                    << " for the wrong reason\n";
+          result.ok = false;
+          return result;
+        }
+      }
+    }
+  }
+  result.bulletsInFlight = static_cast<double>(bullets) / numTicks;
+  result.spawnsPerTick = static_cast<double>(spawns) / numTicks;
+  result.deltaBytes = static_cast<double>(deltaBytes) / deltas;
+  result.positionBytes = result.bulletsInFlight * BULLET_POSITION_BYTES;
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  int numTicks = intArg(argc, argv, 1, 600);
+  int numPlayers = intArg(argc, argv, 2, 32);
+  int fireEvery = intArg(argc, argv, 3, 15);
+
+  std::cout << numPlayers << " players firing every " << fireEvery << " ticks, " << numTicks << " ticks\n";
+  std::cout << "world  filtered  | bullets in flight  spawns per tick  delta B  all positions B"
+            << "  | despawns: hit player  left world  owner gone  left view\n";
+  struct Run {
+    int side;
+    bool filter;
+  };
+  for (Run r : {Run{1000, false}, Run{2000, false}, Run{4000, false}, Run{4000, true}}) {
+    Result result = run({r.side, r.side}, r.filter, numPlayers, fireEvery, numTicks);
+    if (!result.ok) {
+      std::cout << "FAILED\n";
+      return 1;
+    }
+    std::cout << r.side << "  " << (r.filter ? "yes" : "no") << "  | " << result.bulletsInFlight << "  "
+              << result.spawnsPerTick << "  " << result.deltaBytes << "  " << result.positionBytes << "  | "
+              << result.despawns[0] << "  " << result.despawns[1] << "  " << result.despawns[2] << "  "
+              << result.despawns[3] << "\n";
+  }
+  return 0;
+}
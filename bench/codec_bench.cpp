@@ -0,0 +1,94 @@
+// Compares the binary wire codec with the Boost text archives it replaced, and with the
+// bit-packed keyframes of SnapshotCodec.
+// Usage: codec_bench [players] [bullets per player]
+
+#include <sstream>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+
+#include "Bench.hpp"
+#include "Game.hpp"
+#include "GameMessage.hpp"
+#include "Message.hpp"
+#include "SnapshotCodec.hpp"
+
+// Build a game with the given number of players, each with a number of bullets in flight.
+Game makeGame(int numPlayers, int bulletsPerPlayer) {
+  std::mt19937 rng(42);
+  Game game;
+  uint32_t bulletId = 0;
+  for (int id = 0; id < numPlayers; id++) {
+    game.addPlayer(randomPlayer(id, DEFAULT_WORLD_SIZE, rng));
+    for (int i = 0; i < bulletsPerPlayer; i++)
+      game.addBullet(id, Bullet((id * 13 + i * 7) % SCREEN_WIDTH, (id * 17 + i * 3) % SCREEN_HEIGHT, i * 2.0, bulletId++));
+  }
+  return game;
+}
+
+int main(int argc, char* argv[]) {
+  int numPlayers = intArg(argc, argv, 1, 32);
+  int bulletsPerPlayer = intArg(argc, argv, 2, 20);
+  Game game = makeGame(numPlayers, bulletsPerPlayer);
+
+  // The previous format: a text archive written through a string stream.
+  std::string textBody;
+  double textEncodeNs = nsPerCall([&]() {
+    std::stringstream ss;
+    {
+      boost::archive::text_oarchive oa(ss);
+      oa & game;
+    }
+    textBody = ss.str();
+    keep(textBody);
+  });
+  double textDecodeNs = nsPerCall([&]() {
+    Game decoded;
+    std::stringstream ss;
+    ss << textBody;
+    {
+      boost::archive::text_iarchive ia(ss);
+      ia & decoded;
+    }
+    keep(decoded);
+  });
+
+  Message<GameMessage> msg;
+  double binaryEncodeNs = nsPerCall([&]() {
+    msg.setData(game);
+    keep(msg.body);
+  });
+  double binaryDecodeNs = nsPerCall([&]() {
+    Game decoded;
+    msg.getData(decoded);
+    keep(decoded);
+  });
+
+  std::string packed;
+  double packedEncodeNs = nsPerCall([&]() {
+    packed.clear();
+    {
+      BitWriter bits(packed);
+      SnapshotCodec::writeGame(bits, game);
+    }
+    keep(packed);
+  });
+  double packedDecodeNs = nsPerCall([&]() {
+    Game decoded;
+    BitReader bits(packed.data(), packed.size());
+    SnapshotCodec::readGame(bits, decoded);
+    keep(decoded);
+  });
+
+  auto report = [](const char* name, std::size_t bytes, double encodeNs, double decodeNs) {
+    std::cout << name << ": " << bytes << " bytes, encode " << encodeNs / 1000 << " us ("
+              << bytes / encodeNs * 1000 << " MB/s), decode " << decodeNs / 1000 << " us ("
+              << bytes / decodeNs * 1000 << " MB/s)\n";
+  };
+  std::cout << numPlayers << " players, " << bulletsPerPlayer << " bullets per player\n";
+  report("boost text", textBody.size(), textEncodeNs, textDecodeNs);
+  report("binary    ", msg.body.size(), binaryEncodeNs, binaryDecodeNs);
+  report("packed    ", packed.size(), packedEncodeNs, packedDecodeNs);
+  std::cout << "speedup: encode " << textEncodeNs / binaryEncodeNs << "x, decode "
+            << textDecodeNs / binaryDecodeNs << "x\n";
+  return 0;
+}
@@ -0,0 +1,102 @@
+// Measures how the time of Game::advance scales with the number of players and bullets,
+// compared with the nested loop that tested every bullet against every player.
+// Usage: collision_bench [bullets per player]
+
+#include <random>
+
+#include "Bench.hpp"
+#include "Game.hpp"
+
+// A player owning its bullets, as players did before the bullet pool.
+struct LegacyPlayer {
+  Player player;
+  std::vector<Bullet> bullets;
+};
+
+// The tests the legacy pass made, when the world was the size of the window.
+bool isOutsideScreen(int x, int y) {
+  return x < 0 || x > SCREEN_WIDTH || y < 0 || y > SCREEN_HEIGHT;
+}
+
+bool collides(int bulletX, int bulletY, const Player& p) {
+  return collidesRect({bulletX, bulletY, BULLET_SIDE, BULLET_SIDE},
+                      {p.getPos().x, p.getPos().y, PLAYER_SIDE, PLAYER_SIDE});
+}
+
+// The collision pass as it was before the grid broadphase and the bullet pool, kept for comparison.
+std::vector<uint32_t> legacyAdvance(std::map<uint32_t, LegacyPlayer>& players) {
+  std::vector<uint32_t> playersToDelete;
+  for (auto& [_, owner] : players) {
+    std::vector<Bullet>& bullets = owner.bullets;
+    std::vector<Bullet> bulletsToDelete;
+    for (Bullet& b : bullets) {
+      bool bulletDeleted = false;
+      for (auto [_, other] : players) {
+        const Player& p = other.player;
+        if (owner.player.getID() != p.getID() && collides(b.getPos().x, b.getPos().y, p)) {
+          playersToDelete.push_back(p.getID());
+          bulletsToDelete.push_back(b);
+          bulletDeleted = true;
+        }
+        else if (isOutsideScreen(b.getPos().x, b.getPos().y)) {
+          bulletsToDelete.push_back(b);
+          bulletDeleted = true;
+        }
+      }
+      if (!bulletDeleted) {
+        // Bullets used to move by their velocity every tick.
+        Velocity vel = b.getVel();
+        b = Bullet(b.getPos().x + vel.dx / FRAMES_PER_SECOND, b.getPos().y + vel.dy / FRAMES_PER_SECOND,
+                   vel.dx, vel.dy, b.getAngle(), b.getID());
+      }
+    }
+    // Bullets used to be removed by comparing positions.
+    for (Bullet& b : bulletsToDelete) {
+      bullets.erase(std::remove_if(bullets.begin(), bullets.end(), [&](const Bullet& other) {
+            return other.getPos().x == b.getPos().x && other.getPos().y == b.getPos().y;
+          }), bullets.end());
+    }
+  }
+  for (uint32_t id : playersToDelete)
+    players.erase(id);
+  return playersToDelete;
+}
+
+// Players spread over the screen, each with bullets in flight around it.
+std::map<uint32_t, LegacyPlayer> makePlayers(int numPlayers, int bulletsPerPlayer) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> coord(0, SCREEN_WIDTH - PLAYER_SIDE - 1);
+  std::uniform_int_distribution<int> angle(0, 179);
+  std::map<uint32_t, LegacyPlayer> players;
+  uint32_t bulletId = 0;
+  for (int id = 0; id < numPlayers; id++) {
+    LegacyPlayer player{Player(coord(rng), coord(rng), id), {}};
+    for (int i = 0; i < bulletsPerPlayer; i++)
+      player.bullets.push_back(Bullet(coord(rng), coord(rng), angle(rng) * 2.0, bulletId++));
+    players.insert({id, player});
+  }
+  return players;
+}
+
+int main(int argc, char* argv[]) {
+  int bulletsPerPlayer = intArg(argc, argv, 1, 10);
+  std::cout << "players bullets   nested(us)     grid(us)  speedup\n";
+  for (int numPlayers : {10, 30, 100, 300, 1000}) {
+    std::map<uint32_t, LegacyPlayer> players = makePlayers(numPlayers, bulletsPerPlayer);
+    Game game;
+    for (auto& [id, p] : players) {
+      game.addPlayer(p.player);
+      for (const Bullet& b : p.bullets)
+        game.addBullet(id, b);
+    }
+
+    // Both variants start from a fresh copy of the same state on every call.
+    double copyMapNs = nsPerCall([&]() { auto copy = players; keep(copy); }, 0.2);
+    double copyGameNs = nsPerCall([&]() { Game copy = game; keep(copy); }, 0.2);
+    double nestedNs = nsPerCall([&]() { auto copy = players; keep(legacyAdvance(copy)); }) - copyMapNs;
+    double gridNs = nsPerCall([&]() { Game copy = game; keep(copy.advance()); }) - copyGameNs;
+    printf("%7d %7d %12.1f %12.1f %8.1fx\n", numPlayers, numPlayers * bulletsPerPlayer,
+           nestedNs / 1000, gridNs / 1000, nestedNs / gridNs);
+  }
+  return 0;
+}
@@ -0,0 +1,223 @@
+// Cost of catching up after a hiccup on the client. A server plays a game with players firing
+// and sends a snapshot every tick to one client, whose SnapshotDecoder keeps up for a while;
+// then the client stalls and the snapshots of many ticks queue up. Given the whole burst, the
+// decoder must decode one snapshot, the newest, and the render thread must take one game
+// state, the server's latest, and nothing after it. The time that takes is compared with
+// decoding every snapshot of the burst, as the client did before. The burst is given once to
+// the decoder's own thread, started after it was queued, and then again and again to poll()
+// for timing. Before that, a writer thread publishes values through a TripleBuffer as fast as
+// it can while the reader takes them: every value taken must be whole and newer than the one
+// before. The benchmark fails if a check does not hold.
+// Usage: decode_burst_bench [snapshots in a burst] [players] [bursts timed]
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Bench.hpp"
+#include "MPSCQueue.hpp"
+#include "SnapshotDecoder.hpp"
+
+// Ticks the client keeps up for before each burst.
+const int WARM_UP_TICKS = 30;
+// Values published through the triple buffer in the check of it.
+const uint32_t NUM_PUBLISHED = 200000;
+
+// Stands in for the client's transport: the server's snapshots are pushed straight into its
+// queue, and the acknowledgements sent to it are passed on to the server's history.
+struct QueueClient {
+  MPSCQueue<OwnedMessage<GameMessage>> incomingMsgs{4096};
+  SnapshotHistory& history;
+  uint32_t id;
+  std::atomic<uint64_t> acks{0};
+
+  QueueClient(SnapshotHistory& history, uint32_t id) : history(history), id(id) {}
+
+  MPSCQueue<OwnedMessage<GameMessage>>& getIncomingMsgs() { return incomingMsgs; }
+
+  void send(const Message<ClientMessage>& msg) {
+    uint32_t seq;
+    if (msg.header.messageId == ClientMessage::SnapshotAck && msg.getData(seq)) {
+      history.ack(id, seq);
+      acks++;
+    }
+  }
+};
+
+// The server's side: a game with players firing, and the snapshots sent to the client.
+struct Sender {
+  WorldSize world = DEFAULT_WORLD_SIZE;
+  Game game{world};
+  SnapshotHistory history{world};
+  std::mt19937 rng{9};
+  uint32_t nextBulletId = 0;
+  uint32_t latestSeq = 0;
+  // The snapshots sent since the last burst, and where the burst starts among them.
+  std::vector<Message<GameMessage>> sent;
+  std::size_t burstStart = 0;
+
+  explicit Sender(int numPlayers) {
+    for (int id = 0; id < numPlayers; id++)
+      game.addPlayer(randomPlayer(id, world, rng));
+  }
+
+  // Advance the game a tick and queue its snapshot for the client.
+  void tick(QueueClient& client) {
+    for (auto& [id, player] : game.getPlayers()) {
+      if (rng() % 8 == 0)
+        game.addBullet(id, Bullet(player.getPos().x, player.getPos().y, rng() % 360, nextBulletId++));
+    }
+    for (uint32_t id : game.advance())
+      game.addPlayer(randomPlayer(id, world, rng));
+    latestSeq = history.push(game);
+    FramePtr<GameMessage> frame = history.frameFor(client.id);
+    Message<GameMessage> msg{frame->header(), frame->body()};
+    sent.push_back(msg);
+    client.incomingMsgs.push({0, std::move(msg)});
+  }
+};
+
+// Whether the client's game state is the server's: the same tick, players and bullets.
+bool sameState(const Game& decoded, const Game& game) {
+  if (decoded.getTick() != game.getTick() || decoded.getPlayers().size() != game.getPlayers().size() ||
+      decoded.getBullets().size() != game.getBullets().size())
+    return false;
+  for (auto& [id, player] : game.getPlayers()) {
+    auto found = decoded.getPlayers().find(id);
+    if (found == decoded.getPlayers().end() || found->second.getPos().x != player.getPos().x ||
+        found->second.getPos().y != player.getPos().y)
+      return false;
+  }
+  return true;
+}
+
+// Let the client keep up for a while, and then queue a burst. Returns the seq of the newest.
+uint32_t queueBurst(Sender& sender, QueueClient& client, SnapshotDecoder<QueueClient>& decoder, int burst) {
+  sender.sent.clear();
+  for (int t = 0; t < WARM_UP_TICKS; t++) {
+    sender.tick(client);
+    decoder.poll();
+    decoder.takeLatest();
+  }
+  sender.burstStart = sender.sent.size();
+  for (int t = 0; t < burst; t++)
+    sender.tick(client);
+  return sender.latestSeq;
+}
+
+// The checks of one burst given to the decoder: one decode, one state taken, the newest.
+bool checkBurst(SnapshotDecoder<QueueClient>& decoder, Sender& sender, uint32_t newestSeq, uint64_t decodedBefore,
+                uint64_t decodedAfter) {
+  bool ok = true;
+  if (decodedAfter - decodedBefore != 1) {
+    std::cout << "  the burst took " << decodedAfter - decodedBefore << " decodes\n";
+    ok = false;
+  }
+  if (!decoder.takeLatest()) {
+    std::cout << "  no game state was published\n";
+    return false;
+  }
+  if (decoder.latest().seq != newestSeq || !sameState(decoder.latest().game, sender.game)) {
+    std::cout << "  the game state taken is not the newest\n";
+    ok = false;
+  }
+  if (decoder.takeLatest()) {
+    std::cout << "  more than one game state was taken\n";
+    ok = false;
+  }
+  return ok;
+}
+
+// Publish values of many words, each word the value's number, while taking them on another
+// thread. Returns whether every value taken was whole and newer than the one before.
+bool checkTripleBuffer() {
+  TripleBuffer<std::array<uint32_t, 64>> buffer;
+  std::thread writer([&]() {
+      for (uint32_t n = 1; n <= NUM_PUBLISHED; n++) {
+        buffer.back().fill(n);
+        buffer.publish();
+      }
+    });
+  uint32_t last = 0;
+  uint64_t taken = 0;
+  bool ok = true;
+  while (last < NUM_PUBLISHED && ok) {
+    if (!buffer.take())
+      continue;
+    const std::array<uint32_t, 64>& value = buffer.front();
+    ok = value[0] > last && std::all_of(value.begin(), value.end(), [&](uint32_t word) { return word == value[0]; });
+    last = value[0];
+    taken++;
+  }
+  writer.join();
+  std::cout << "triple buffer: " << taken << " of " << NUM_PUBLISHED << " values taken\n";
+  if (!ok)
+    std::cout << "  a value taken was torn or older than the one before\n";
+  return ok;
+}
+
+int main(int argc, char* argv[]) {
+  int burst = std::max(1, intArg(argc, argv, 1, 100));
+  int numPlayers = intArg(argc, argv, 2, 16);
+  int numBursts = std::max(1, intArg(argc, argv, 3, 50));
+  std::cout << "bursts of " << burst << " snapshots, " << numPlayers << " players\n";
+  bool ok = checkTripleBuffer();
+
+  // On the decoder's thread, started with the burst already queued.
+  {
+    Sender sender(numPlayers);
+    QueueClient client(sender.history, 0);
+    SnapshotDecoder<QueueClient> decoder(client, 0);
+    uint32_t newestSeq = queueBurst(sender, client, decoder, burst);
+    uint64_t before = decoder.decoded();
+    decoder.start();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    // The decoder takes every message queued before decoding.
+    while (decoder.decoded() == before && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    decoder.stop();
+    std::cout << "decoder thread: " << decoder.decoded() - before << " decode, " << decoder.skipped()
+              << " snapshots skipped\n";
+    ok = checkBurst(decoder, sender, newestSeq, before, decoder.decoded()) && ok;
+  }
+
+  // Timed, against decoding every snapshot of the burst.
+  Sender sender(numPlayers);
+  QueueClient client(sender.history, 0);
+  SnapshotDecoder<QueueClient> decoder(client, 0);
+  SnapshotReceiver everySnapshot;
+  double latestUs = 0;
+  double everyUs = 0;
+  for (int b = 0; b < numBursts && ok; b++) {
+    uint32_t newestSeq = queueBurst(sender, client, decoder, burst);
+    uint64_t before = decoder.decoded();
+    auto start = std::chrono::steady_clock::now();
+    decoder.poll();
+    latestUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    ok = checkBurst(decoder, sender, newestSeq, before, decoder.decoded()) && ok;
+
+    // The same snapshots, each decoded as the client used to, after those the client kept up
+    // with, which the burst's deltas are based on.
+    for (std::size_t i = 0; i < sender.burstStart; i++)
+      everySnapshot.receive(sender.sent[i]);
+    start = std::chrono::steady_clock::now();
+    for (std::size_t i = sender.burstStart; i < sender.sent.size(); i++) {
+      if (!everySnapshot.receive(sender.sent[i])) {
+        std::cout << "  snapshot " << i - sender.burstStart << " of the burst could not be decoded\n";
+        ok = false;
+      }
+    }
+    everyUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    keep(everySnapshot.latestSeq());
+  }
+  std::cout << "burst of " << burst << ": newest only " << latestUs / numBursts << " us, every snapshot "
+            << everyUs / numBursts << " us\n";
+
+  if (!ok) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,102 @@
+// Frame time of the client's GameDrawer, batched against drawing sprites one by one, in games
+// with more and more bullets in view. Runs with SDL's dummy video driver and the software
+// renderer unless SDL_VIDEODRIVER says otherwise, so it needs no display; it must be run from
+// the repository root, where the images are. Players and bullets are scattered over a world
+// the size of the window, at random angles. Both ways must draw the same sprites, and the
+// batched one in a single call; the benchmark fails otherwise.
+// Built with the client, as it needs SDL: make draw_bench.
+// Usage: draw_bench [frames] [players]
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "Bench.hpp"
+#include "GameDrawer.hpp"
+
+struct Result {
+  double meanMs = 0;
+  double p99Ms = 0;
+  FrameStats frame;
+};
+
+Game makeGame(int numPlayers, int numBullets, std::mt19937& rng) {
+  const WorldSize& world = DEFAULT_WORLD_SIZE;
+  Game game(world);
+  std::uniform_int_distribution<int> x(0, world.width - PLAYER_SIDE);
+  std::uniform_int_distribution<int> y(0, world.height - PLAYER_SIDE);
+  std::uniform_int_distribution<int> angle(0, ANGLE_STEPS - 1);
+  for (int id = 0; id < numPlayers; id++)
+    game.addPlayer(randomPlayer(id, world, rng));
+  for (int i = 0; i < numBullets; i++)
+    game.addBullet(i % std::max(1, numPlayers), Bullet(x(rng), y(rng), angle(rng) * 360.0 / ANGLE_STEPS, i));
+  return game;
+}
+
+Result run(GameDrawer& drawer, DrawMode mode, const Game& game, int numFrames) {
+  drawer.setDrawMode(mode);
+  Rect view = cameraView({0, 0}, game.getWorldSize());
+  // Warm up the batch and the renderer.
+  drawer.drawGame(game, view);
+  std::vector<double> frameMs;
+  for (int i = 0; i < numFrames; i++) {
+    auto start = std::chrono::steady_clock::now();
+    drawer.drawGame(game, view);
+    frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  std::sort(frameMs.begin(), frameMs.end());
+  Result result;
+  for (double ms : frameMs)
+    result.meanMs += ms / frameMs.size();
+  result.p99Ms = frameMs[std::min(frameMs.size() - 1, static_cast<std::size_t>(0.99 * frameMs.size()))];
+  result.frame = drawer.lastFrame();
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  int numFrames = std::max(1, intArg(argc, argv, 1, 200));
+  int numPlayers = intArg(argc, argv, 2, 16);
+  // Does not replace a driver given in the environment.
+  setenv("SDL_VIDEODRIVER", "dummy", 0);
+
+  GameDrawer drawer;
+  if (!drawer.isInit()) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+  std::cout << numFrames << " frames of " << SCREEN_WIDTH << " x " << SCREEN_HEIGHT << ", " << numPlayers
+            << " players, video driver " << std::getenv("SDL_VIDEODRIVER") << "\n";
+  std::cout << "bullets  per sprite ms (p99)  batched ms (p99)  speedup  sprites  draw calls\n";
+  bool ok = true;
+  std::mt19937 rng(7);
+  for (int numBullets : {0, 100, 500, 2000}) {
+    Game game = makeGame(numPlayers, numBullets, rng);
+    Result perSprite = run(drawer, DrawMode::PerSprite, game, numFrames);
+    Result batched = run(drawer, DrawMode::Batched, game, numFrames);
+    std::cout << numBullets << "  " << perSprite.meanMs << " (" << perSprite.p99Ms << ")  " << batched.meanMs << " ("
+              << batched.p99Ms << ")  " << perSprite.meanMs / batched.meanMs << "x  " << batched.frame.sprites << "  "
+              << perSprite.frame.drawCalls << " -> " << batched.frame.drawCalls << "\n";
+    if (drawer.drawMode() != DrawMode::Batched) {
+      std::cout << "the renderer fell back to drawing sprites one by one\n";
+      ok = false;
+      break;
+    }
+    if (batched.frame.sprites != perSprite.frame.sprites ||
+        batched.frame.sprites != static_cast<std::size_t>(numPlayers + numBullets)) {
+      std::cout << "the batch does not have every sprite in view\n";
+      ok = false;
+    }
+    if (batched.frame.drawCalls > 1) {
+      std::cout << "the batch took more than one draw call\n";
+      ok = false;
+    }
+  }
+  drawer.close();
+
+  if (!ok) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+  return 0;
+}
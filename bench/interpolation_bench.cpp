@@ -0,0 +1,107 @@
+// Smoothness of drawing with the snapshot interpolation buffer compared to drawing the latest
+// snapshot received, for a range of snapshot rates and network jitter. A player moves back and
+// forth at constant speed on the server, and the client draws it at a fixed frame rate.
+// Reported per frame: how often the player does not move (a stall), and how far its movement
+// strays from the steady speed it has on the server.
+// Usage: interpolation_bench [frames per second] [seconds]
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Bench.hpp"
+#include "Interpolation.hpp"
+#include "SimLink.hpp"
+
+struct Smoothness {
+  double stalls = 0;        // Fraction of frames in which the player did not move.
+  double meanDeviation = 0; // Mean difference between the distance moved and the steady distance.
+  int maxStep = 0;          // Longest distance moved in a frame.
+};
+
+struct Measure {
+  std::vector<int> xs;
+
+  Smoothness result(double steadyStep) const {
+    Smoothness s;
+    double deviation = 0;
+    int frames = 0;
+    for (std::size_t i = 1; i < xs.size(); i++) {
+      int step = std::abs(xs[i] - xs[i - 1]);
+      s.stalls += step == 0;
+      deviation += std::abs(step - steadyStep);
+      s.maxStep = std::max(s.maxStep, step);
+      frames++;
+    }
+    s.stalls /= frames;
+    s.meanDeviation = deviation / frames;
+    return s;
+  }
+};
+
+// Run the server and a client drawing at fps for the given time, with a snapshot every
+// ticksPerSnapshot ticks arriving after delayMs to delayMs + jitterMs.
+void run(int fps, int seconds, int ticksPerSnapshot, int delayMs, int jitterMs,
+         Smoothness& latest, Smoothness& interpolated) {
+  std::mt19937 rng(7);
+  Game game;
+  game.addPlayer(1);
+  DelayedLink<Game> link(delayMs, jitterMs, 0, rng);
+  SnapshotInterpolator interpolator;
+  Game received;
+  bool hasReceived = false;
+  Measure latestX, interpolatedX;
+
+  double frameMs = 1000.0 / fps;
+  double msPerTick = 1000.0 / game.getTicksPerSecond();
+  double endMs = seconds * 1000.0;
+  double nextTickMs = 0;
+  for (double now = 0; now < endMs; now += frameMs) {
+    // Server ticks up to now. The player turns around every 120 ticks.
+    while (nextTickMs <= now) {
+      PlayerInput input;
+      input.seq = game.getTick() + 1;
+      input.set((game.getTick() / 120) % 2 == 0 ? PlayerAction::Right : PlayerAction::Left);
+      game.applyInput(1, input);
+      game.advance();
+      if (game.getTick() % ticksPerSnapshot == 0)
+        link.send(static_cast<uint64_t>(nextTickMs), game);
+      nextTickMs += msPerTick;
+    }
+    // Client frame.
+    link.deliver(static_cast<uint64_t>(now), [&](const Game& snapshot) {
+        received = snapshot;
+        hasReceived = true;
+        interpolator.push(snapshot, now);
+      });
+    if (!hasReceived)
+      continue;
+    latestX.xs.push_back(received.getPlayers().at(1).getPos().x);
+    Game drawn;
+    interpolator.sample(now, drawn);
+    interpolatedX.xs.push_back(drawn.getPlayers().at(1).getPos().x);
+  }
+  double steadyStep = PLAYER_SPEED * frameMs / 1000;
+  latest = latestX.result(steadyStep);
+  interpolated = interpolatedX.result(steadyStep);
+}
+
+int main(int argc, char* argv[]) {
+  int fps = intArg(argc, argv, 1, 60);
+  int seconds = intArg(argc, argv, 2, 20);
+
+  std::cout << "drawing at " << fps << " fps, playout delay " << DEFAULT_PLAYOUT_DELAY_MS << " ms\n";
+  std::cout << "ticks/snapshot  jitter ms  | latest: stalls  deviation  max step"
+            << "  | interpolated: stalls  deviation  max step\n";
+  for (int ticksPerSnapshot : {1, 2, 3, 6}) {
+    for (int jitterMs : {0, 30, 60}) {
+      Smoothness latest, interpolated;
+      run(fps, seconds, ticksPerSnapshot, 20, jitterMs, latest, interpolated);
+      std::cout << ticksPerSnapshot << "  " << jitterMs << "  | "
+                << latest.stalls * 100 << "%  " << latest.meanDeviation << "  " << latest.maxStep << "  | "
+                << interpolated.stalls * 100 << "%  " << interpolated.meanDeviation << "  "
+                << interpolated.maxStep << "\n";
+    }
+  }
+  return 0;
+}
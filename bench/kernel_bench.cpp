@@ -0,0 +1,93 @@
+// Throughput of the batch collision kernels, after checking on random input that every
+// version gives the same results as the scalar one.
+// Usage: kernel_bench [bullets per block]
+
+#include <random>
+#include <vector>
+
+#include "Bench.hpp"
+#include "CollisionKernels.hpp"
+
+struct Kernel {
+  const char* name;
+  HitMaskKernel hitMask;
+  OutsideMaskKernel outsideMask;
+};
+
+std::vector<Kernel> availableKernels() {
+  std::vector<Kernel> kernels = {{"scalar", hitMaskScalar, outsideMaskScalar}};
+#ifdef SHOOTY_X86
+  kernels.push_back({"sse2", hitMaskSSE2, outsideMaskSSE2});
+  if (__builtin_cpu_supports("avx2"))
+    kernels.push_back({"avx2", hitMaskAVX2, outsideMaskAVX2});
+#endif
+  return kernels;
+}
+
+// Compare every kernel with the scalar one on random blocks of every length up to maxLength,
+// with coordinates around and beyond the edges of the screen. Returns false on a mismatch.
+bool checkEquivalence(const std::vector<Kernel>& kernels, int rounds, std::size_t maxLength) {
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> coord(-2 * PLAYER_SIDE, SCREEN_WIDTH + 2 * PLAYER_SIDE);
+  std::uniform_int_distribution<int> near(-BULLET_SIDE - 2, PLAYER_SIDE + 2);
+  std::vector<int32_t> xs(maxLength), ys(maxLength);
+  std::vector<uint8_t> expected(maxLength), actual(maxLength);
+  for (int round = 0; round < rounds; round++) {
+    std::size_t n = round % (maxLength + 1);
+    Rect rect = {coord(rng), coord(rng), PLAYER_SIDE, PLAYER_SIDE};
+    // Half of the bullets are placed close to the rectangle so that edges are hit often.
+    for (std::size_t i = 0; i < n; i++) {
+      bool close = rng() % 2;
+      xs[i] = close ? rect.x + near(rng) : coord(rng);
+      ys[i] = close ? rect.y + near(rng) : coord(rng);
+    }
+    hitMaskScalar(rect, BULLET_SIDE, BULLET_SIDE, xs.data(), ys.data(), n, expected.data());
+    for (const Kernel& k : kernels) {
+      k.hitMask(rect, BULLET_SIDE, BULLET_SIDE, xs.data(), ys.data(), n, actual.data());
+      if (!std::equal(expected.begin(), expected.begin() + n, actual.begin())) {
+        std::cout << k.name << " hit mask differs from scalar in round " << round << "\n";
+        return false;
+      }
+    }
+    outsideMaskScalar(SCREEN_WIDTH, SCREEN_HEIGHT, xs.data(), ys.data(), n, expected.data());
+    for (const Kernel& k : kernels) {
+      k.outsideMask(SCREEN_WIDTH, SCREEN_HEIGHT, xs.data(), ys.data(), n, actual.data());
+      if (!std::equal(expected.begin(), expected.begin() + n, actual.begin())) {
+        std::cout << k.name << " outside mask differs from scalar in round " << round << "\n";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  std::size_t n = intArg(argc, argv, 1, 4096);
+  std::vector<Kernel> kernels = availableKernels();
+  if (!checkEquivalence(kernels, 100000, 67))
+    return 1;
+  std::cout << "all kernels match the scalar version; runtime selection: " << collisionKernels().name << "\n";
+
+  std::mt19937 rng(99);
+  std::uniform_int_distribution<int> coord(-50, SCREEN_WIDTH + 50);
+  std::vector<int32_t> xs(n), ys(n);
+  for (std::size_t i = 0; i < n; i++) {
+    xs[i] = coord(rng);
+    ys[i] = coord(rng);
+  }
+  std::vector<uint8_t> out(n);
+  Rect rect = {SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, PLAYER_SIDE, PLAYER_SIDE};
+  double scalarHitNs = 0, scalarOutsideNs = 0;
+  std::cout << n << " bullets per block\n";
+  for (const Kernel& k : kernels) {
+    double hitNs = nsPerCall([&]() { k.hitMask(rect, BULLET_SIDE, BULLET_SIDE, xs.data(), ys.data(), n, out.data()); keep(out); }, 0.3);
+    double outsideNs = nsPerCall([&]() { k.outsideMask(SCREEN_WIDTH, SCREEN_HEIGHT, xs.data(), ys.data(), n, out.data()); keep(out); }, 0.3);
+    if (scalarHitNs == 0) {
+      scalarHitNs = hitNs;
+      scalarOutsideNs = outsideNs;
+    }
+    printf("%-6s hit %7.1f Mbullets/s (%4.1fx)   outside %7.1f Mbullets/s (%4.1fx)\n", k.name,
+           n / hitNs * 1000, scalarHitNs / hitNs, n / outsideNs * 1000, scalarOutsideNs / outsideNs);
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+// Throughput of the server's network io over loopback with many clients, for an increasing
+// number of io threads. Clients send inputs as fast as a window of messages in flight
+// allows, and the server broadcasts a small frame every millisecond, so reads and writes run
+// on all io threads at once. Build with SANITIZE=thread to check the server for data races.
+// Usage: loopback_bench [clients] [seconds per run] [max io threads]
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Bench.hpp"
+#include "Client.hpp"
+#include "ClientMessage.hpp"
+#include "GameMessage.hpp"
+#include "IoThreadPool.hpp"
+#include "PlayerInput.hpp"
+#include "Server.hpp"
+
+// Messages allowed in flight per client before the sender waits for the server to catch up.
+const uint64_t WINDOW_PER_CLIENT = 32;
+
+struct Result {
+  double msgsPerSecond = 0;
+  uint64_t dropped = 0;
+  bool ok = false;
+};
+
+Result run(int numClients, double seconds, std::size_t numIoThreads, unsigned short port) {
+  Result result;
+  asio::io_context serverContext;
+  Server<ClientMessage, GameMessage> server(serverContext, port);
+  asio::io_context clientContext;
+  asio::ip::tcp::resolver resolver(clientContext);
+  auto endpoints = resolver.resolve("127.0.0.1", std::to_string(port));
+  std::vector<std::unique_ptr<Client<GameMessage, ClientMessage>>> clients;
+  for (int i = 0; i < numClients; i++)
+    clients.push_back(std::make_unique<Client<GameMessage, ClientMessage>>(clientContext, endpoints));
+  // Declared last so the threads are joined before anything they use is destroyed.
+  IoThreadPool serverThreads(serverContext, numIoThreads);
+  IoThreadPool clientThreads(clientContext, numIoThreads);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (server.numConnections() < numClients) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      std::cout << "only " << server.numConnections() << " of " << numClients << " clients connected\n";
+      return result;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // The game loop: count the messages received and broadcast a frame every millisecond.
+  std::atomic<uint64_t> received{0};
+  std::atomic<bool> stop{false};
+  std::thread gameLoop([&]() {
+      auto& incomingMsgs = server.getIncomingMsgs();
+      Message<GameMessage> state;
+      state.header.messageId = GameMessage::GameState;
+      state.setData(std::vector<uint32_t>(16, 0));
+      auto nextBroadcast = std::chrono::steady_clock::now();
+      while (!stop) {
+        std::size_t n = incomingMsgs.drain([](OwnedMessage<ClientMessage>&&) {});
+        received += n;
+        if (std::chrono::steady_clock::now() >= nextBroadcast) {
+          server.writeToAll(state);
+          nextBroadcast += std::chrono::milliseconds(1);
+        }
+        if (n == 0)
+          std::this_thread::yield();
+      }
+    });
+
+  Message<ClientMessage> input;
+  input.header.messageId = ClientMessage::Input;
+  uint64_t sent = 0;
+  uint64_t window = WINDOW_PER_CLIENT * numClients;
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::duration<double>(seconds);
+  std::size_t next = 0;
+  while (std::chrono::steady_clock::now() < end) {
+    uint64_t dropped = server.getIncomingMsgs().dropped();
+    if (sent - received - dropped < window) {
+      input.setData(PlayerInput{static_cast<uint32_t>(sent + 1), 0, PlayerInput::bit(PlayerAction::Up)});
+      clients[next]->send(input);
+      next = (next + 1) % clients.size();
+      sent++;
+    } else {
+      // Take the broadcasts the clients have received, as the client's game loop would.
+      for (auto& client : clients)
+        client->getIncomingMsgs().drain([](OwnedMessage<GameMessage>&&) {});
+      std::this_thread::yield();
+    }
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  stop = true;
+  gameLoop.join();
+  for (auto& client : clients)
+    client->disconnect();
+
+  result.dropped = server.getIncomingMsgs().dropped();
+  result.msgsPerSecond = (received + result.dropped) / elapsed.count();
+  result.ok = true;
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  int numClients = intArg(argc, argv, 1, 200);
+  double seconds = intArg(argc, argv, 2, 2);
+  std::size_t maxThreads = intArg(argc, argv, 3, std::max(1u, std::thread::hardware_concurrency()));
+
+  std::cout << numClients << " clients, " << std::thread::hardware_concurrency() << " hardware threads\n";
+  std::cout << "io threads  Kmsgs/s  scaling  dropped\n";
+  double base = 0;
+  unsigned short port = 60100;
+  for (std::size_t threads = 1; threads <= maxThreads; threads *= 2) {
+    Result result = run(numClients, seconds, threads, port++);
+    if (!result.ok)
+      return 1;
+    if (threads == 1)
+      base = result.msgsPerSecond;
+    std::cout << threads << "  " << result.msgsPerSecond / 1e3 << "  "
+              << result.msgsPerSecond / base << "x  " << result.dropped << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,141 @@
+// Client side prediction against a server behind a link with delay, jitter and loss, run in
+// one process tick by tick. Counts how often reconciling with the server's state moves the
+// predicted player, which the player would see as a jump. Without loss there must be none;
+// the bench fails if there are.
+// Usage: prediction_bench [clients] [ticks]
+
+#include <random>
+#include <vector>
+
+#include "Bench.hpp"
+#include "SimLink.hpp"
+#include "ClientMessage.hpp"
+#include "InputBuffer.hpp"
+#include "Prediction.hpp"
+#include "Snapshot.hpp"
+
+struct SimClient {
+  uint32_t id;
+  SnapshotReceiver snapshots;
+  PlayerPrediction prediction;
+  uint32_t inputSeq = 0;
+  uint8_t held = 0;
+  DelayedLink<Message<ClientMessage>> up;
+  DelayedLink<Message<GameMessage>> down;
+
+  SimClient(uint32_t id, int delay, int jitter, double loss, std::mt19937& rng)
+    : id(id), up(delay, jitter, loss, rng), down(delay, jitter, 0, rng) {}
+};
+
+struct Result {
+  uint64_t corrections = 0;
+  double meanUnacked = 0;
+};
+
+// Run the server and clients for the given number of ticks. Players hold random sets of
+// movement and rotation keys for a while at a time. Only inputs are lost, not snapshots.
+Result run(int numClients, int ticks, int delay, int jitter, double inputLoss) {
+  std::mt19937 rng(42);
+  Game game;
+  InputBuffer inputs;
+  SnapshotHistory history;
+  std::vector<std::unique_ptr<SimClient>> clients;
+  std::vector<uint32_t> ids;
+  for (int i = 0; i < numClients; i++) {
+    clients.push_back(std::make_unique<SimClient>(i, delay, jitter, inputLoss, rng));
+    clients.back()->prediction.setPlayerID(i);
+    ids.push_back(i);
+  }
+  game.syncPlayers(ids);
+
+  uint64_t unackedSum = 0;
+  uint64_t samples = 0;
+  for (uint64_t t = 0; t < static_cast<uint64_t>(ticks); t++) {
+    // Server tick.
+    for (auto& client : clients) {
+      client->up.deliver(t, [&](const Message<ClientMessage>& msg) {
+          if (msg.header.messageId == ClientMessage::Input) {
+            PlayerInput input;
+            if (msg.getData(input))
+              inputs.push(client->id, input);
+          } else {
+            uint32_t seq;
+            if (msg.getData(seq))
+              history.ack(client->id, seq);
+          }
+        });
+    }
+    inputs.popEach([&](uint32_t id, const PlayerInput& input) { game.applyInput(id, input); });
+    game.advance();
+    history.push(game);
+    for (auto& client : clients) {
+      const Frame<GameMessage>& frame = *history.frameFor(client->id);
+      client->down.send(t, Message<GameMessage>{frame.header(), frame.body()});
+    }
+
+    // Client ticks.
+    for (auto& client : clients) {
+      client->down.deliver(t, [&](const Message<GameMessage>& msg) {
+          if (client->snapshots.receive(msg)) {
+            Message<ClientMessage> ack;
+            ack.header.messageId = ClientMessage::SnapshotAck;
+            ack.setData(client->snapshots.latestSeq());
+            client->up.send(t, ack);
+            client->prediction.reconcile(client->snapshots.latest());
+          }
+        });
+      if (rng() % 20 == 0)
+        client->held = rng() % (PlayerInput::bit(PlayerAction::FireBullet));
+      PlayerInput input;
+      input.seq = ++client->inputSeq;
+      input.tick = t;
+      input.actions = client->held;
+      client->prediction.applyLocal(input);
+      Message<ClientMessage> msg;
+      msg.header.messageId = ClientMessage::Input;
+      msg.setData(input);
+      client->up.send(t, msg);
+      unackedSum += client->prediction.numUnacked();
+      samples++;
+    }
+  }
+
+  Result result;
+  for (auto& client : clients)
+    result.corrections += client->prediction.corrections();
+  result.meanUnacked = static_cast<double>(unackedSum) / samples;
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  int numClients = intArg(argc, argv, 1, 8);
+  int ticks = intArg(argc, argv, 2, 3000);
+
+  struct Scenario {
+    const char* name;
+    int delay;
+    int jitter;
+    double loss;
+    bool expectNone;
+  };
+  Scenario scenarios[] = {
+    {"no delay", 0, 0, 0, true},
+    {"50 ms one way", 3, 0, 0, true},
+    {"50-100 ms jitter", 3, 3, 0, true},
+    {"100 ms, 2% input loss", 6, 2, 0.02, false},
+  };
+  std::cout << numClients << " clients, " << ticks << " ticks\n";
+  std::cout << "link  corrections  mean unacked inputs\n";
+  bool ok = true;
+  for (const Scenario& s : scenarios) {
+    Result result = run(numClients, ticks, s.delay, s.jitter, s.loss);
+    std::cout << s.name << "  " << result.corrections << "  " << result.meanUnacked << "\n";
+    if (s.expectNone && result.corrections != 0)
+      ok = false;
+  }
+  if (!ok) {
+    std::cout << "FAILED: the prediction was corrected on a link without loss\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,182 @@
+// Error and size of the players and bullets packed into snapshots by SnapshotCodec, against the
+// byte-aligned format of BinaryWriter. Random players and bullet spawns, with angles anywhere
+// and not only on the grid the game keeps them on, are packed as lists sorted by ID, unpacked,
+// and compared field by field. Positions, IDs, ticks and input sequence numbers must come back
+// exactly and angles within half a step; bullets fired through a game, which puts their angle
+// on the grid, must come back exactly. The benchmark fails if one does not.
+// Usage: quantize_bench [entities]
+
+#include <cmath>
+#include <random>
+
+#include "Bench.hpp"
+#include "SnapshotCodec.hpp"
+
+struct Errors {
+  int pos = 0;          // Largest distance along x or y.
+  double angle = 0;     // Largest difference in degrees, the short way round.
+  uint32_t others = 0;  // Number of IDs, owners, ticks and sequence numbers not sent back exactly.
+};
+
+double angleError(double a, double b) {
+  double d = wrapAngle(a - b);
+  return std::min(d, 360 - d);
+}
+
+struct Result {
+  double playerBytes = 0;   // Bytes per player, packed.
+  double playerBytesNow = 0;
+  double bulletBytes = 0;   // Bytes per bullet, packed.
+  double bulletBytesNow = 0;
+  Errors players;
+  Errors bullets;
+  Errors gameBullets;       // Bullets fired through a game.
+  bool ok = true;
+};
+
+Result run(const WorldSize& world, uint32_t angleSteps, int count) {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> anyAngle(-720, 720);
+  Quantization q(world, angleSteps);
+  Result result;
+
+  // Players, with IDs a few apart, as they are in a room.
+  std::map<uint32_t, Player> players;
+  uint32_t nextId = 0;
+  for (int i = 0; i < count; i++) {
+    nextId += 1 + rng() % 3;
+    Player player = randomPlayer(nextId, world, rng);
+    for (int turns = rng() % 200; turns > 0; turns--)
+      player.rotateRight(1);
+    PlayerInput input{static_cast<uint32_t>(rng() % 100000), 0, 0};
+    player.applyInput(input, world, FRAMES_PER_SECOND);
+    players.insert({nextId, player});
+  }
+  std::string packed;
+  {
+    BitWriter bits(packed);
+    SnapshotCodec::writePlayers(bits, players, q);
+  }
+  std::string now;
+  BinaryWriter writer(now);
+  writer << players;
+  result.playerBytes = static_cast<double>(packed.size()) / count;
+  result.playerBytesNow = static_cast<double>(now.size()) / count;
+  std::map<uint32_t, Player> unpacked;
+  BitReader reader(packed.data(), packed.size());
+  SnapshotCodec::readPlayers(reader, unpacked, q);
+  if (!reader.ok() || unpacked.size() != players.size()) {
+    std::cout << "the players could not be unpacked\n";
+    result.ok = false;
+    return result;
+  }
+  for (auto& [id, player] : players) {
+    const Player& back = unpacked.at(id);
+    result.players.pos = std::max({result.players.pos, std::abs(back.getPos().x - player.getPos().x),
+                                   std::abs(back.getPos().y - player.getPos().y)});
+    result.players.angle = std::max(result.players.angle, angleError(back.getAngle(), player.getAngle()));
+    result.players.others += back.getID() != player.getID() || back.getLastInputSeq() != player.getLastInputSeq();
+  }
+
+  // Bullet spawns at any angle, fired up to a few seconds before the snapshot.
+  uint32_t tick = 100000;
+  std::vector<BulletSpawn> spawns;
+  nextId = 0;
+  for (int i = 0; i < count; i++) {
+    nextId += 1 + rng() % 4;
+    spawns.push_back({nextId, static_cast<uint32_t>(rng() % 64),
+                      {static_cast<int>(rng() % world.width), static_cast<int>(rng() % world.height)},
+                      anyAngle(rng), tick - static_cast<uint32_t>(rng() % 300)});
+  }
+  packed.clear();
+  {
+    BitWriter bits(packed);
+    uint32_t previous = 0;
+    for (const BulletSpawn& spawn : spawns) {
+      SnapshotCodec::writeID(bits, spawn.id, previous);
+      SnapshotCodec::writeSpawn(bits, spawn, tick, q);
+    }
+  }
+  now.clear();
+  for (const BulletSpawn& spawn : spawns)
+    writer << spawn;
+  result.bulletBytes = static_cast<double>(packed.size()) / count;
+  result.bulletBytesNow = static_cast<double>(now.size()) / count;
+  BitReader bulletReader(packed.data(), packed.size());
+  uint32_t previous = 0;
+  for (const BulletSpawn& spawn : spawns) {
+    uint32_t backId = SnapshotCodec::readID(bulletReader, previous);
+    BulletSpawn back = SnapshotCodec::readSpawn(bulletReader, backId, tick, q);
+    result.bullets.pos = std::max({result.bullets.pos, std::abs(back.origin.x - spawn.origin.x),
+                                   std::abs(back.origin.y - spawn.origin.y)});
+    result.bullets.angle = std::max(result.bullets.angle, angleError(back.angle, spawn.angle));
+    result.bullets.others += back.id != spawn.id || back.owner != spawn.owner || back.tick != spawn.tick;
+  }
+
+  // The same bullets fired in a game, and sent in a keyframe.
+  Game game(world);
+  for (const BulletSpawn& spawn : spawns)
+    game.addBullet(spawn.owner, Bullet(spawn.origin.x, spawn.origin.y, spawn.angle, spawn.id));
+  packed.clear();
+  {
+    BitWriter bits(packed);
+    SnapshotCodec::writeGame(bits, game);
+  }
+  Game decoded;
+  BitReader gameReader(packed.data(), packed.size());
+  SnapshotCodec::readGame(gameReader, decoded);
+  const BulletPool& sent = game.getBullets();
+  const BulletPool& received = decoded.getBullets();
+  if (!gameReader.ok() || received.size() != sent.size()) {
+    std::cout << "the game could not be unpacked\n";
+    result.ok = false;
+    return result;
+  }
+  // Both pools are in the order the bullets were fired in, which is by ID.
+  for (std::size_t i = 0; i < sent.size(); i++) {
+    result.gameBullets.pos = std::max({result.gameBullets.pos, std::abs(received.xs()[i] - sent.xs()[i]),
+                                       std::abs(received.ys()[i] - sent.ys()[i])});
+    result.gameBullets.angle = std::max(result.gameBullets.angle, angleError(received.angles()[i], sent.angles()[i]));
+    result.gameBullets.others += received.ids()[i] != sent.ids()[i] || received.owners()[i] != sent.owners()[i];
+  }
+
+  double halfStep = 180.0 / angleSteps + 1e-9;
+  bool exact = result.players.pos == 0 && result.players.others == 0 && result.bullets.pos == 0 &&
+    result.bullets.others == 0;
+  bool withinStep = result.players.angle <= halfStep && result.bullets.angle <= halfStep;
+  // The game puts bullets on the grid of ANGLE_STEPS, which keyframes use, and players turn by
+  // whole steps of it.
+  bool gameExact = result.gameBullets.pos == 0 && result.gameBullets.angle == 0 && result.gameBullets.others == 0 &&
+    (angleSteps != ANGLE_STEPS || result.players.angle == 0);
+  result.ok = exact && withinStep && gameExact;
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  int count = intArg(argc, argv, 1, 1000);
+
+  std::cout << count << " players and bullets; bytes per entity packed and with BinaryWriter, "
+            << "largest position and angle errors\n";
+  std::cout << "world  angle steps  | player B  now B  pos  angle  | bullet B  now B  pos  angle"
+            << "  | fired in game: pos  angle\n";
+  bool ok = true;
+  for (WorldSize world : {DEFAULT_WORLD_SIZE, WorldSize{3000, 3000}, WorldSize{12000, 12000}}) {
+    for (uint32_t angleSteps : {ANGLE_STEPS, 360u, 64u}) {
+      Result r = run(world, angleSteps, count);
+      std::cout << world.width << " x " << world.height << "  " << angleSteps << "  | " << r.playerBytes << "  "
+                << r.playerBytesNow << "  " << r.players.pos << "  " << r.players.angle << "  | " << r.bulletBytes
+                << "  " << r.bulletBytesNow << "  " << r.bullets.pos << "  " << r.bullets.angle << "  | "
+                << r.gameBullets.pos << "  " << r.gameBullets.angle << "\n";
+      if (!r.ok) {
+        std::cout << "errors out of bounds: " << r.players.others + r.bullets.others + r.gameBullets.others
+                  << " other fields not sent back exactly\n";
+        ok = false;
+      }
+    }
+  }
+  if (!ok) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+  return 0;
+}
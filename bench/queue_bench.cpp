@@ -0,0 +1,160 @@
+// Contention benchmark of the lock-free MPSCQueue against the mutex-based TSQueue, with several
+// producer threads pushing to one consumer the way connections push to the game loop.
+// Before timing, a stress run checks that the MPSCQueue neither loses, duplicates nor reorders
+// values, and that a full queue drops values as documented.
+// Usage: queue_bench [producers] [values per producer]
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Bench.hpp"
+#include "MPSCQueue.hpp"
+#include "TSQueue.hpp"
+
+struct Item {
+  uint32_t producer = 0;
+  uint32_t seq = 0;
+};
+
+// Checks the values taken from the queue: every producer's values must arrive in the order
+// they were pushed, without gaps.
+struct OrderCheck {
+  std::vector<uint32_t> next;
+  uint64_t received = 0;
+  bool ok = true;
+
+  explicit OrderCheck(int producers) : next(producers, 0) {}
+
+  void take(const Item& item) {
+    if (item.producer >= next.size() || item.seq != next[item.producer]) {
+      ok = false;
+      return;
+    }
+    next[item.producer]++;
+    received++;
+  }
+};
+
+// Start the producers, each pushing count values with push(item), which returns false if the
+// value has to be pushed again. They wait for go so that they all start together.
+template <typename Push>
+std::vector<std::thread> startProducers(int producers, uint32_t count, std::atomic<bool>& go, Push push) {
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([p, count, &go, push]() {
+        while (!go.load())
+          std::this_thread::yield();
+        for (uint32_t seq = 0; seq < count; seq++) {
+          while (!push(Item{static_cast<uint32_t>(p), seq}))
+            std::this_thread::yield();
+        }
+      });
+  }
+  return threads;
+}
+
+// Transfer every producer's values through an MPSCQueue. Returns the time taken in seconds.
+double runMPSC(int producers, uint32_t count, std::size_t capacity, OrderCheck& check) {
+  MPSCQueue<Item> queue(capacity);
+  std::atomic<bool> go{false};
+  std::vector<std::thread> threads =
+    startProducers(producers, count, go, [&queue](Item item) { return queue.push(item); });
+  uint64_t total = static_cast<uint64_t>(producers) * count;
+  auto start = std::chrono::steady_clock::now();
+  go = true;
+  while (check.received < total && check.ok) {
+    if (queue.drain([&check](Item&& item) { check.take(item); }) == 0)
+      std::this_thread::yield();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  for (std::thread& t : threads)
+    t.join();
+  return elapsed.count();
+}
+
+// The same transfer through a TSQueue, consumed the way the game loop used to.
+double runTSQueue(int producers, uint32_t count, OrderCheck& check) {
+  TSQueue<Item> queue;
+  std::atomic<bool> go{false};
+  std::vector<std::thread> threads =
+    startProducers(producers, count, go, [&queue](Item item) { queue.push(item); return true; });
+  uint64_t total = static_cast<uint64_t>(producers) * count;
+  auto start = std::chrono::steady_clock::now();
+  go = true;
+  while (check.received < total && check.ok) {
+    if (queue.empty())
+      std::this_thread::yield();
+    while (!queue.empty())
+      check.take(queue.pop());
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  for (std::thread& t : threads)
+    t.join();
+  return elapsed.count();
+}
+
+// Pushing to a full queue must fail and be counted, and must not disturb the values already queued.
+bool checkFullPolicy() {
+  MPSCQueue<Item> queue(5); // Rounded up to 8.
+  if (queue.capacity() != 8)
+    return false;
+  for (uint32_t i = 0; i < 8; i++) {
+    if (!queue.push({0, i}))
+      return false;
+  }
+  if (queue.push({0, 8}) || queue.push({0, 9}) || queue.dropped() != 2)
+    return false;
+  // Free three slots and wrap around.
+  Item item;
+  for (uint32_t i = 0; i < 3; i++) {
+    if (!queue.pop(item) || item.seq != i)
+      return false;
+  }
+  for (uint32_t i = 8; i < 11; i++) {
+    if (!queue.push({0, i}))
+      return false;
+  }
+  OrderCheck check(1);
+  check.next[0] = 3;
+  std::size_t drained = queue.drain([&check](Item&& item) { check.take(item); });
+  return drained == 8 && check.ok && check.next[0] == 11 && queue.empty() && !queue.pop(item);
+}
+
+int main(int argc, char* argv[]) {
+  int producers = intArg(argc, argv, 1, 4);
+  uint32_t count = intArg(argc, argv, 2, 200000);
+
+  if (!checkFullPolicy()) {
+    std::cout << "MPSCQueue full queue policy check FAILED\n";
+    return 1;
+  }
+  // A small queue fills up often, which exercises wrapping and the full path under contention.
+  for (std::size_t capacity : {16, 4096}) {
+    OrderCheck check(producers);
+    runMPSC(producers, count, capacity, check);
+    if (!check.ok || check.received != static_cast<uint64_t>(producers) * count) {
+      std::cout << "MPSCQueue stress check FAILED with capacity " << capacity << "\n";
+      return 1;
+    }
+  }
+  std::cout << "MPSCQueue stress check passed: " << producers << " producers x " << count
+            << " values, every value received once and in order\n\n";
+
+  std::cout << "producers  TSQueue Mvalues/s  MPSCQueue Mvalues/s  speedup\n";
+  for (int p = 1; p <= producers; p *= 2) {
+    OrderCheck tsCheck(p);
+    OrderCheck mpscCheck(p);
+    double tsSeconds = runTSQueue(p, count, tsCheck);
+    double mpscSeconds = runMPSC(p, count, 4096, mpscCheck);
+    if (!tsCheck.ok || !mpscCheck.ok) {
+      std::cout << "values lost or reordered\n";
+      return 1;
+    }
+    double values = static_cast<double>(p) * count / 1e6;
+    std::cout << p << "  " << values / tsSeconds << "  " << values / mpscSeconds
+              << "  " << tsSeconds / mpscSeconds << "x\n";
+  }
+  std::cout << "(" << std::thread::hardware_concurrency() << " hardware threads)\n";
+  return 0;
+}
@@ -0,0 +1,264 @@
+// Many rooms hosted by one server process, without the network: a LocalServer stands in for
+// the transport, taking the clients' messages straight into its queue and recording the
+// snapshots written to each client. Every client joins its room through the Lobby like a real
+// one would, and sends an input every tick.
+// Reported: the time to create a room (with its first players) and to tear one down, and the
+// gaps between the snapshots the clients of the quiet rooms receive, first with only quiet
+// rooms and then next to a busy room with many players. A busy room should not make the gaps
+// of the others longer. Every client is checked to be welcomed, to receive snapshots and to
+// be sent only players of its own room, and every room to be destroyed once its players are
+// gone; the benchmark fails if not.
+// Usage: room_bench [seconds per run] [rooms] [busy room players]
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Bench.hpp"
+#include "Lobby.hpp"
+
+// Players in each quiet room.
+const int PLAYERS_PER_ROOM = 4;
+// Side of the world of every room. It is larger than the window, so that each client gets its
+// own view of the game, which makes a room with many players expensive to tick.
+const int WORLD_SIDE = 3000;
+
+uint64_t nowUs() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// What a client has been sent. Written by the thread of the client's room, or by the lobby's
+// for the welcome, and read once the rooms are gone.
+struct ClientLog {
+  std::atomic<bool> welcomed{false};
+  std::vector<uint64_t> snapshotUs;
+  FramePtr<GameMessage> first;
+};
+
+// Server with the interface of Server and UdpServer used by Lobby and Room, whose clients are
+// made up by the benchmark.
+class LocalServer {
+  std::vector<uint32_t> ids_;
+  std::mutex idsMutex_;
+  MPSCQueue<OwnedMessage<ClientMessage>> incomingMsgs_{1 << 14};
+  std::atomic<uint64_t> connectionChanges_{0};
+  std::vector<ClientLog> logs_;
+  std::atomic<uint64_t> disconnects_{0};
+
+public:
+  explicit LocalServer(std::size_t maxClients) : logs_(maxClients) {}
+
+  void connect(uint32_t id) {
+    std::scoped_lock guard(idsMutex_);
+    ids_.push_back(id);
+    connectionChanges_++;
+  }
+
+  void disconnectAll() {
+    std::scoped_lock guard(idsMutex_);
+    ids_.clear();
+    connectionChanges_++;
+  }
+
+  int numConnections() {
+    std::scoped_lock guard(idsMutex_);
+    return ids_.size();
+  }
+
+  uint64_t connectionChanges() const { return connectionChanges_; }
+
+  std::vector<uint32_t> getIDs() {
+    std::scoped_lock guard(idsMutex_);
+    return ids_;
+  }
+
+  MPSCQueue<OwnedMessage<ClientMessage>>& getIncomingMsgs() { return incomingMsgs_; }
+
+  void writeTo(uint32_t id, Message<GameMessage> msg) {
+    if (msg.header.messageId == GameMessage::Welcome)
+      logs_[id].welcomed = true;
+  }
+
+  template <typename MakeFrame>
+  void writeToEach(const std::vector<uint32_t>& ids, MakeFrame makeFrame) {
+    uint64_t now = nowUs();
+    for (uint32_t id : ids) {
+      FramePtr<GameMessage> frame = makeFrame(id);
+      ClientLog& log = logs_[id];
+      log.snapshotUs.push_back(now);
+      if (!log.first)
+        log.first = std::move(frame);
+    }
+  }
+
+  // Players killed in a room; the benchmark's players do not fire, so there should be none.
+  void disconnect(uint32_t /* id */) { disconnects_++; }
+  void disconnectFrom(const std::vector<uint32_t>& ids) { disconnects_ += ids.size(); }
+
+  ClientLog& log(uint32_t id) { return logs_[id]; }
+  uint64_t disconnects() const { return disconnects_; }
+};
+
+void send(LocalServer& server, uint32_t id, ClientMessage type, uint32_t value) {
+  Message<ClientMessage> msg;
+  msg.header.messageId = type;
+  msg.setData(value);
+  server.getIncomingMsgs().push({id, std::move(msg)});
+}
+
+void sendInput(LocalServer& server, uint32_t id, const PlayerInput& input) {
+  Message<ClientMessage> msg;
+  msg.header.messageId = ClientMessage::Input;
+  msg.setData(input);
+  server.getIncomingMsgs().push({id, std::move(msg)});
+}
+
+// Value below which the given fraction of the values lie.
+double percentile(std::vector<double> values, double fraction) {
+  if (values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, static_cast<std::size_t>(fraction * values.size()))];
+}
+
+struct Result {
+  bool ok = true;
+  double createUs = 0;   // Time for the lobby to create a room and add its players.
+  double teardownUs = 0; // Time for the lobby to take the players out of a room and destroy it.
+  std::vector<double> quietGapsMs;
+  std::vector<double> busyGapsMs;
+};
+
+// Connect the clients of numRooms quiet rooms and, if busyPlayers is not zero, of one busy room,
+// run them for the given time and then disconnect them all.
+Result run(int numRooms, int busyPlayers, double seconds) {
+  Result result;
+  int numQuiet = numRooms * PLAYERS_PER_ROOM;
+  int numClients = numQuiet + busyPlayers;
+  LocalServer server(numClients);
+  Lobby<LocalServer> lobby(server, 1, WorldSize{WORLD_SIDE, WORLD_SIDE});
+  // Client i is in room i / PLAYERS_PER_ROOM; the busy room comes last.
+  auto roomOf = [](int id) { return static_cast<uint32_t>(id / PLAYERS_PER_ROOM); };
+
+  // Welcome the quiet rooms' clients, then time how long the lobby takes to put them in rooms.
+  for (int id = 0; id < numQuiet; id++)
+    server.connect(id);
+  lobby.update();
+  for (int id = 0; id < numQuiet; id++)
+    send(server, id, ClientMessage::Join, roomOf(id));
+  auto start = std::chrono::steady_clock::now();
+  lobby.update();
+  result.createUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / numRooms;
+  if (busyPlayers > 0) {
+    for (int id = numQuiet; id < numClients; id++)
+      server.connect(id);
+    lobby.update();
+    for (int id = numQuiet; id < numClients; id++)
+      send(server, id, ClientMessage::Join, numRooms);
+    lobby.update();
+  }
+  if (lobby.numRooms() != static_cast<std::size_t>(numRooms + (busyPlayers > 0))) {
+    std::cout << lobby.numRooms() << " rooms created\n";
+    result.ok = false;
+  }
+
+  // Every client moves about, as a player would; inputs are sent every tick and routed every
+  // millisecond, like the server's main loop does.
+  std::mt19937 rng(5);
+  std::vector<uint8_t> held(numClients, 0);
+  auto tickDuration = std::chrono::microseconds(1000000 / FRAMES_PER_SECOND);
+  auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+  auto nextTick = std::chrono::steady_clock::now();
+  uint32_t tick = 0;
+  while (std::chrono::steady_clock::now() < end) {
+    if (std::chrono::steady_clock::now() >= nextTick) {
+      tick++;
+      for (int id = 0; id < numClients; id++) {
+        if (rng() % 20 == 0)
+          held[id] = rng() % PlayerInput::bit(PlayerAction::FireBullet);
+        sendInput(server, id, PlayerInput{tick, tick, held[id]});
+      }
+      nextTick += tickDuration;
+    }
+    lobby.update();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // Disconnecting everyone should tear down every room.
+  server.disconnectAll();
+  start = std::chrono::steady_clock::now();
+  lobby.update();
+  result.teardownUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() /
+                      (numRooms + (busyPlayers > 0));
+  if (lobby.numRooms() != 0) {
+    std::cout << lobby.numRooms() << " rooms left after every client disconnected\n";
+    result.ok = false;
+  }
+  if (server.disconnects() != 0) {
+    std::cout << server.disconnects() << " players were disconnected by their room\n";
+    result.ok = false;
+  }
+
+  for (int id = 0; id < numClients; id++) {
+    ClientLog& log = server.log(id);
+    uint32_t room = id < numQuiet ? roomOf(id) : numRooms;
+    SnapshotReceiver receiver;
+    if (!log.welcomed || !log.first) {
+      std::cout << "client " << id << " was not welcomed or got no snapshot\n";
+      result.ok = false;
+      continue;
+    }
+    Message<GameMessage> msg{log.first->header(), log.first->body()};
+    if (!receiver.receive(msg) || receiver.latest().getPlayers().count(id) == 0) {
+      std::cout << "the first snapshot of client " << id << " does not hold its player\n";
+      result.ok = false;
+      continue;
+    }
+    for (auto& [pid, player] : receiver.latest().getPlayers()) {
+      if ((pid < static_cast<uint32_t>(numQuiet) ? roomOf(pid) : numRooms) != room) {
+        std::cout << "client " << id << " in room " << room << " was sent player " << pid << "\n";
+        result.ok = false;
+        break;
+      }
+    }
+    std::vector<double>& gaps = id < numQuiet ? result.quietGapsMs : result.busyGapsMs;
+    for (std::size_t i = 1; i < log.snapshotUs.size(); i++)
+      gaps.push_back((log.snapshotUs[i] - log.snapshotUs[i - 1]) / 1000.0);
+  }
+  return result;
+}
+
+void print(const char* name, const std::vector<double>& gapsMs) {
+  std::cout << "  " << name << " snapshot gap ms: p50 " << percentile(gapsMs, 0.5) << "  p99 "
+            << percentile(gapsMs, 0.99) << "  max " << percentile(gapsMs, 1) << "\n";
+}
+
+int main(int argc, char* argv[]) {
+  double seconds = intArg(argc, argv, 1, 5);
+  int numRooms = intArg(argc, argv, 2, 100);
+  int busyPlayers = intArg(argc, argv, 3, 200);
+
+  std::cout << numRooms << " rooms of " << PLAYERS_PER_ROOM << " players, world " << WORLD_SIDE << " x "
+            << WORLD_SIDE << ", " << FRAMES_PER_SECOND << " ticks per second\n";
+  for (int busy : {0, busyPlayers}) {
+    Result r = run(numRooms, busy, seconds);
+    if (!r.ok) {
+      std::cout << "FAILED\n";
+      return 1;
+    }
+    if (busy == 0)
+      std::cout << "quiet rooms only\n";
+    else
+      std::cout << "with a busy room of " << busy << " players\n";
+    std::cout << "  room created in " << r.createUs << " us, torn down in " << r.teardownUs << " us\n";
+    print("quiet rooms", r.quietGapsMs);
+    if (busy > 0)
+      print("busy room", r.busyGapsMs);
+  }
+  return 0;
+}
@@ -0,0 +1,156 @@
+// Memory held by the server for a client that stops reading. Two clients connect over
+// loopback: one reads everything, the other never reads, with a small receive buffer so that
+// the server's writes to it stall soon. The server writes each a fresh snapshot of a few
+// kilobytes every millisecond, as a busy game would, and a message that must arrive every
+// quarter of a second. Snapshots waiting to be sent replace each other, so the stalled
+// client's queue holds at most the snapshot being written, the latest one and the messages
+// that must arrive. The benchmark fails if the heap grows by more than that after the first
+// second, if the stalled queue holds more frames than that, or if the reading client misses
+// or reorders a message that must arrive.
+// Usage: send_queue_bench [seconds] [snapshot bytes]
+
+#include <malloc.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Bench.hpp"
+#include "Client.hpp"
+#include "ClientMessage.hpp"
+#include "GameMessage.hpp"
+#include "IoThreadPool.hpp"
+#include "Server.hpp"
+
+const unsigned short PORT = 60200;
+// Bytes the stalled client's socket receives before the server's writes to it wait.
+const int STALLED_RECEIVE_BUFFER = 4096;
+const auto RELIABLE_INTERVAL = std::chrono::milliseconds(250);
+// Heap growth allowed after the first second, for what the io thread and the queues of the
+// two clients hold at a time, which does not depend on how long the client stalls.
+const std::size_t ALLOWED_GROWTH = 1 << 20;
+
+// Bytes of heap in use.
+std::size_t heapInUse() { return mallinfo2().uordblks; }
+
+int main(int argc, char* argv[]) {
+  double seconds = intArg(argc, argv, 1, 5);
+  std::size_t snapshotBytes = intArg(argc, argv, 2, 4096);
+
+  asio::io_context serverContext;
+  Server<ClientMessage, GameMessage> server(serverContext, PORT);
+  asio::io_context clientContext;
+  asio::ip::tcp::resolver resolver(clientContext);
+  auto endpoints = resolver.resolve("127.0.0.1", std::to_string(PORT));
+  Client<GameMessage, ClientMessage> reader(clientContext, endpoints);
+  asio::ip::tcp::socket stalled(clientContext);
+  stalled.open(asio::ip::tcp::v4());
+  stalled.set_option(asio::socket_base::receive_buffer_size(STALLED_RECEIVE_BUFFER));
+  stalled.connect(*endpoints.begin());
+  // Declared last so the threads are joined before anything they use is destroyed.
+  IoThreadPool serverThreads(serverContext, 1);
+  IoThreadPool clientThreads(clientContext, 1);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (server.numConnections() < 2) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      std::cout << "only " << server.numConnections() << " of 2 clients connected\n";
+      return 1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  // The reading client connected first, so it has the lower ID.
+  std::vector<uint32_t> ids = server.getIDs();
+  uint32_t stalledId = std::max(ids[0], ids[1]);
+
+  uint32_t reliableSent = 0;
+  uint32_t reliableReceived = 0;
+  bool inOrder = true;
+  uint64_t snapshotsSent = 0;
+  uint64_t snapshotsReceived = 0;
+  std::size_t heapAfterFirstSecond = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::duration<double>(seconds);
+  auto nextSnapshot = start;
+  auto nextReliable = start;
+  while (std::chrono::steady_clock::now() < end) {
+    auto now = std::chrono::steady_clock::now();
+    if (now >= nextSnapshot) {
+      Message<GameMessage> snapshot;
+      snapshot.header.messageId = GameMessage::GameState;
+      snapshot.body.assign(snapshotBytes, 'x');
+      server.writeToAll(std::move(snapshot));
+      snapshotsSent++;
+      nextSnapshot += std::chrono::milliseconds(1);
+    }
+    if (now >= nextReliable) {
+      Message<GameMessage> welcome;
+      welcome.header.messageId = GameMessage::Welcome;
+      welcome.setData(++reliableSent);
+      server.writeToAll(std::move(welcome));
+      nextReliable += RELIABLE_INTERVAL;
+    }
+    reader.getIncomingMsgs().drain([&](OwnedMessage<GameMessage>&& owned) {
+        uint32_t n = 0;
+        if (owned.msg.header.messageId == GameMessage::GameState) {
+          snapshotsReceived++;
+        } else if (owned.msg.getData(n)) {
+          inOrder = inOrder && n == reliableReceived + 1;
+          reliableReceived = n;
+        }
+      });
+    if (heapAfterFirstSecond == 0 && now >= start + std::chrono::seconds(1))
+      heapAfterFirstSecond = heapInUse();
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  std::size_t heapAtEnd = heapInUse();
+  // Let the reading client catch up with the last messages that must arrive.
+  deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (reliableReceived < reliableSent && std::chrono::steady_clock::now() < deadline) {
+    reader.getIncomingMsgs().drain([&](OwnedMessage<GameMessage>&& owned) {
+        uint32_t n = 0;
+        if (owned.msg.header.messageId == GameMessage::Welcome && owned.msg.getData(n)) {
+          inOrder = inOrder && n == reliableReceived + 1;
+          reliableReceived = n;
+        }
+      });
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  std::map<uint32_t, SendQueueStats> stats = server.sendQueueStats();
+  std::cout << seconds << " s, " << snapshotsSent << " snapshots of " << snapshotBytes << " bytes and "
+            << reliableSent << " messages that must arrive written to each client\n";
+  std::cout << "client  | queue depth  max depth  bytes queued  sent  replaced\n";
+  for (auto& [id, s] : stats) {
+    std::cout << (id == stalledId ? "stalled" : "reading") << "  | " << s.depth << "  " << s.maxDepth << "  "
+              << s.bytes << "  " << s.sent << "  " << s.replaced << "\n";
+  }
+  const SendQueueStats& stalledStats = stats[stalledId];
+  std::cout << "reading client received " << snapshotsReceived << " snapshots and " << reliableReceived
+            << " messages that must arrive" << (inOrder ? "" : ", out of order") << "\n";
+  std::cout << "heap after 1 s: " << heapAfterFirstSecond / 1024 << " KB, at the end: " << heapAtEnd / 1024
+            << " KB; without replacing, the stalled queue would hold "
+            << stalledStats.replaced * snapshotBytes / 1024 << " KB more\n";
+
+  bool ok = true;
+  if (heapAtEnd > heapAfterFirstSecond + ALLOWED_GROWTH) {
+    std::cout << "the heap grew while the client stalled\n";
+    ok = false;
+  }
+  if (stalledStats.maxDepth > reliableSent + 2 || stalledStats.replaced == 0) {
+    std::cout << "the stalled client's snapshots were not replaced\n";
+    ok = false;
+  }
+  if (reliableReceived != reliableSent || !inOrder) {
+    std::cout << "the reading client did not get every message that must arrive, in order\n";
+    ok = false;
+  }
+  reader.disconnect();
+  stalled.close();
+  if (!ok) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,185 @@
+// Deterministic benchmark of the game simulation alone, without networking or drawing.
+// Each scenario sets up a game from a fixed seed with a number of players, keeps a number of
+// bullets in flight and has the players fire in a pattern, then times applying the players'
+// inputs and advancing the game for a number of ticks.
+// Reported per scenario: time per tick, heap allocations per tick and entities (players plus
+// bullets) simulated per second. The results are also written as CSV to the output file
+// (default bin/sim_bench.csv).
+// Usage: sim_bench [ticks] [output file] [players bullets pattern]
+// Without the last three arguments a standard suite of scenarios is run.
+// Patterns: none (players only move), volley (each player fires every 15 ticks, as often as
+// the fire cooldown allows) and stream (each player fires every tick).
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Bench.hpp"
+#include "Game.hpp"
+
+// Every heap allocation in the program is counted.
+std::atomic<uint64_t> allocations{0};
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+enum class FirePattern { None, Volley, Stream };
+
+const char* patternName(FirePattern pattern) {
+  switch (pattern) {
+  case FirePattern::None:
+    return "none";
+  case FirePattern::Volley:
+    return "volley";
+  case FirePattern::Stream:
+    return "stream";
+  }
+  return "";
+}
+
+bool parsePattern(const std::string& name, FirePattern& pattern) {
+  for (FirePattern p : {FirePattern::None, FirePattern::Volley, FirePattern::Stream}) {
+    if (name == patternName(p)) {
+      pattern = p;
+      return true;
+    }
+  }
+  return false;
+}
+
+struct Scenario {
+  int players;
+  int bullets;
+  FirePattern pattern;
+};
+
+struct Result {
+  double nsPerTick = 0;
+  double allocsPerTick = 0;
+  double entitiesPerSecond = 0;
+  double meanBullets = 0; // Mean number of bullets at the start of a tick.
+};
+
+const uint32_t SEED = 2024;
+const int WARMUP_TICKS = 60;
+
+Result run(const Scenario& scenario, int ticks) {
+  std::mt19937 rng(SEED);
+  Game game;
+  for (int id = 0; id < scenario.players; id++)
+    game.addPlayer(randomPlayer(id, DEFAULT_WORLD_SIZE, rng));
+  std::vector<uint8_t> held(scenario.players, 0);
+  // Bullets are spawned by the benchmark, with IDs that cannot clash with the game's own.
+  uint32_t nextBulletId = 1u << 31;
+
+  Result result;
+  uint64_t totalNs = 0;
+  uint64_t totalAllocs = 0;
+  uint64_t entities = 0;
+  uint64_t bulletsSum = 0;
+  for (int tick = 0; tick < WARMUP_TICKS + ticks; tick++) {
+    // Inputs: each player holds random movement keys for a while, like the bots do.
+    std::vector<std::pair<uint32_t, PlayerInput>> inputs;
+    for (auto& [id, player] : game.getPlayers()) {
+      if (rng() % 20 == 0)
+        held[id] = rng() % PlayerInput::bit(PlayerAction::FireBullet);
+      inputs.push_back({id, PlayerInput{static_cast<uint32_t>(tick + 1), static_cast<uint32_t>(tick), held[id]}});
+    }
+    // Firing. Bullets are fired directly rather than through the inputs, so that the stream
+    // pattern is not held back by the game's fire cooldown.
+    std::vector<std::pair<uint32_t, Bullet>> fired;
+    for (auto& [id, player] : game.getPlayers()) {
+      bool fire = scenario.pattern == FirePattern::Stream ||
+        (scenario.pattern == FirePattern::Volley && (tick + id) % 15 == 0);
+      if (fire)
+        fired.push_back({id, player.fire(nextBulletId++)});
+    }
+    // Keep the bullet density up with bullets in random places and directions.
+    std::vector<std::pair<uint32_t, Bullet>> spawned;
+    for (std::size_t n = game.getBullets().size() + fired.size(); n < static_cast<std::size_t>(scenario.bullets); n++) {
+      uint32_t owner = scenario.players > 0 ? rng() % scenario.players : 0;
+      spawned.push_back({owner, Bullet(rng() % SCREEN_WIDTH, rng() % SCREEN_HEIGHT, rng() % 360, nextBulletId++)});
+    }
+    for (auto& [owner, bullet] : spawned)
+      game.addBullet(owner, bullet);
+
+    uint64_t allocsBefore = allocations.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    for (auto& [id, input] : inputs)
+      game.applyInput(id, input);
+    for (auto& [owner, bullet] : fired)
+      game.addBullet(owner, bullet);
+    std::size_t numBullets = game.getBullets().size();
+    std::size_t numEntities = game.getPlayers().size() + numBullets;
+    const std::vector<uint32_t>& dead = game.advance();
+    auto end = std::chrono::steady_clock::now();
+    uint64_t allocsAfter = allocations.load(std::memory_order_relaxed);
+
+    if (tick >= WARMUP_TICKS) {
+      totalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+      totalAllocs += allocsAfter - allocsBefore;
+      entities += numEntities;
+      bulletsSum += numBullets;
+    }
+    // Players that were hit come back somewhere else, so the number of players stays the same.
+    for (uint32_t id : dead)
+      game.addPlayer(randomPlayer(id, DEFAULT_WORLD_SIZE, rng));
+  }
+  result.nsPerTick = static_cast<double>(totalNs) / ticks;
+  result.allocsPerTick = static_cast<double>(totalAllocs) / ticks;
+  result.entitiesPerSecond = entities / (totalNs / 1e9);
+  result.meanBullets = static_cast<double>(bulletsSum) / ticks;
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  int ticks = intArg(argc, argv, 1, 2000);
+  std::string outputPath = argc > 2 ? argv[2] : "bin/sim_bench.csv";
+
+  std::vector<Scenario> scenarios;
+  if (argc > 5) {
+    Scenario scenario = {std::stoi(argv[3]), std::stoi(argv[4]), FirePattern::None};
+    if (!parsePattern(argv[5], scenario.pattern)) {
+      std::cout << "Unknown fire pattern " << argv[5] << "\n";
+      return 1;
+    }
+    scenarios.push_back(scenario);
+  } else {
+    for (int players : {10, 100, 1000}) {
+      for (int bullets : {0, 1000, 4000})
+        scenarios.push_back({players, bullets, FirePattern::None});
+      scenarios.push_back({players, 0, FirePattern::Volley});
+      scenarios.push_back({players, 0, FirePattern::Stream});
+    }
+  }
+
+  std::ofstream out(outputPath);
+  if (!out) {
+    std::cout << "Could not open " << outputPath << "\n";
+    return 1;
+  }
+  out << "players,bullets,pattern,seed,ticks,mean_bullets,ns_per_tick,allocs_per_tick,entities_per_second\n";
+  std::cout << "players  bullets  pattern  mean bullets  ns/tick  allocs/tick  Mentities/s\n";
+  for (const Scenario& scenario : scenarios) {
+    Result r = run(scenario, ticks);
+    std::cout << scenario.players << "  " << scenario.bullets << "  " << patternName(scenario.pattern) << "  "
+              << r.meanBullets << "  " << r.nsPerTick << "  " << r.allocsPerTick << "  "
+              << r.entitiesPerSecond / 1e6 << "\n";
+    out << scenario.players << "," << scenario.bullets << "," << patternName(scenario.pattern) << ","
+        << SEED << "," << ticks << "," << r.meanBullets << "," << r.nsPerTick << ","
+        << r.allocsPerTick << "," << r.entitiesPerSecond << "\n";
+  }
+  std::cout << "Results written to " << outputPath << "\n";
+  return 0;
+}
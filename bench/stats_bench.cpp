@@ -0,0 +1,98 @@
+// Accuracy and cost of the server's stats (see Stats.hpp). Durations drawn from a log-normal
+// distribution, like tick times with a long tail, are recorded in a LatencyHistogram, and its
+// percentiles are compared with the exact ones; each must be within 1/16 of the exact value.
+// The histogram of two halves added together must give the same percentiles as the whole.
+// Then the time taken by recording a value, by timing a phase of a tick with a TickTimer and
+// by reading percentiles while another thread records is measured. Built with NO_STATS, the
+// timer reads no clock and the tick stats take no memory.
+// Usage: stats_bench [values]
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Bench.hpp"
+#include "Stats.hpp"
+
+int main(int argc, char* argv[]) {
+  int numValues = intArg(argc, argv, 1, 1000000);
+
+  std::mt19937 rng(3);
+  // Around 50 us, with one value in a thousand above about 1 ms.
+  std::lognormal_distribution<double> durationNs(std::log(50000.0), 1.0);
+  std::vector<uint64_t> values(numValues);
+  for (uint64_t& value : values)
+    value = static_cast<uint64_t>(durationNs(rng));
+
+  auto whole = std::make_unique<LatencyHistogram>();
+  auto firstHalf = std::make_unique<LatencyHistogram>();
+  auto secondHalf = std::make_unique<LatencyHistogram>();
+  for (int i = 0; i < numValues; i++) {
+    whole->record(values[i]);
+    (i < numValues / 2 ? firstHalf : secondHalf)->record(values[i]);
+  }
+  firstHalf->add(*secondHalf);
+  std::vector<uint64_t> sorted = values;
+  std::sort(sorted.begin(), sorted.end());
+
+  bool ok = true;
+  std::cout << numValues << " durations; percentile  exact us  histogram us  error\n";
+  for (double fraction : {0.5, 0.9, 0.99, 0.999, 0.9999}) {
+    double exact = sorted[std::min<std::size_t>(sorted.size() - 1, fraction * sorted.size())];
+    double estimate = whole->percentile(fraction);
+    double error = std::abs(estimate - exact) / exact;
+    std::cout << "p" << fraction * 100 << "  " << exact / 1000 << "  " << estimate / 1000 << "  " << error * 100
+              << " %\n";
+    if (error > 1.0 / 16) {
+      std::cout << "the histogram is off by more than a bucket\n";
+      ok = false;
+    }
+    if (firstHalf->percentile(fraction) != estimate) {
+      std::cout << "the two halves added together do not give the whole\n";
+      ok = false;
+    }
+  }
+  if (whole->count() != static_cast<uint64_t>(numValues) || whole->max() != sorted.back()) {
+    std::cout << "the histogram lost values\n";
+    ok = false;
+  }
+
+  std::size_t i = 0;
+  double recordNs = nsPerCall([&]() { whole->record(values[i++ % values.size()]); });
+  auto ticks = std::make_unique<TickStats>();
+  double phaseNs = nsPerCall([&]() {
+      TickTimer timer(*ticks);
+      timer.phase(TickPhase::Members);
+      timer.phase(TickPhase::Messages);
+      timer.phase(TickPhase::Simulate);
+      timer.phase(TickPhase::Record);
+      timer.phase(TickPhase::Snapshot);
+      timer.end(std::chrono::milliseconds(16));
+    }) / NUM_TICK_PHASES;
+  std::cout << "record: " << recordNs << " ns, a phase of a tick: " << phaseNs << " ns, tick stats: "
+            << sizeof(TickStats) << " bytes" << (STATS_ENABLED ? "" : " (built with NO_STATS)") << "\n";
+
+  // A writer and a reader, as a room and the server's stats file.
+  std::atomic<bool> done{false};
+  auto shared = std::make_unique<LatencyHistogram>();
+  std::thread writer([&]() {
+      for (std::size_t n = 0; !done; n++)
+        shared->record(values[n % values.size()]);
+    });
+  double p99 = 0;
+  double readNs = nsPerCall([&]() { p99 = std::max(p99, shared->percentile(0.99)); }, 0.2);
+  done = true;
+  writer.join();
+  keep(p99);
+  std::cout << "percentile read while recording: " << readNs / 1000 << " us\n";
+
+  if (!ok) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+  return 0;
+}
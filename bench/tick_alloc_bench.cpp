@@ -0,0 +1,181 @@
+// Checks that the server's rooms do no heap allocation once warmed up. Rooms are hosted by a
+// Lobby like in the server, with a stand-in for the transport that takes the clients' messages
+// straight into its queue and drops the frames written to it once it has read their sequence
+// numbers. Every client sends an input and acknowledges a recent snapshot every tick, so
+// snapshots are sent as deltas. Like clients with different round trip times, the clients of a
+// room acknowledge snapshots up to MAX_ACK_LAG snapshots old, so that deltas against several
+// bases are made every tick. Half the rooms have players moving about; the other half have
+// one player each, firing all the time, so that there are bullets to simulate and send without
+// players being killed, which would change the rooms. The player first turns to face the top
+// of the world, which is close, so that its bullets leave the world soon after being fired and
+// there are never more than a few in flight, however late the rooms tick.
+// After a warm-up, every heap allocation in the process is counted over thousands of room
+// ticks, in a world the size of the window and in a larger world where every client is sent
+// its area of interest. The benchmark fails if any allocation is made. The transports are not
+// part of the check: asio allocates for the writes it is handed.
+// Usage: tick_alloc_bench [seconds of warm-up] [seconds counted] [rooms] [players per room]
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Bench.hpp"
+#include "Lobby.hpp"
+
+// Ticks a player turning left takes to face the top of the world.
+const uint32_t TURN_TICKS = 45;
+// Most snapshots a client's acknowledgement is behind the latest it was sent.
+const uint32_t MAX_ACK_LAG = 2;
+
+// Every heap allocation in the program is counted.
+std::atomic<uint64_t> allocations{0};
+
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// Server with the interface of Server and UdpServer used by Lobby and Room. Its connections
+// are made up by the benchmark; what is written to them is dropped.
+class NullServer {
+  std::vector<uint32_t> ids_;
+  MPSCQueue<OwnedMessage<ClientMessage>> incomingMsgs_{1 << 14};
+  // Sequence number of the latest snapshot written to each client.
+  std::vector<std::atomic<uint32_t>> latestSeq_;
+  std::atomic<uint64_t> snapshots_{0};
+  std::atomic<uint64_t> disconnects_{0};
+
+public:
+  explicit NullServer(int numClients) : latestSeq_(numClients) {
+    for (int id = 0; id < numClients; id++)
+      ids_.push_back(id);
+  }
+
+  // Connections are only made before the lobby is.
+  int numConnections() { return ids_.size(); }
+  uint64_t connectionChanges() const { return 1; }
+  std::vector<uint32_t> getIDs() { return ids_; }
+
+  MPSCQueue<OwnedMessage<ClientMessage>>& getIncomingMsgs() { return incomingMsgs_; }
+
+  void writeTo(uint32_t /* id */, Message<GameMessage> /* msg */) {}
+
+  // Called by the rooms' threads, each for its own clients.
+  template <typename MakeFrame>
+  void writeToEach(const std::vector<uint32_t>& ids, MakeFrame makeFrame) {
+    for (uint32_t id : ids) {
+      FramePtr<GameMessage> frame = makeFrame(id);
+      // Keyframes and deltas both start with the sequence number of the snapshot.
+      latestSeq_[id] = loadLE<uint32_t>(reinterpret_cast<const uint8_t*>(frame->body().data()));
+    }
+    snapshots_++;
+  }
+
+  void disconnect(uint32_t /* id */) { disconnects_++; }
+  void disconnectFrom(const std::vector<uint32_t>& ids) { disconnects_ += ids.size(); }
+
+  uint32_t latestSeq(uint32_t id) const { return latestSeq_[id]; }
+  // Number of snapshots written, one per room tick.
+  uint64_t snapshots() const { return snapshots_; }
+  uint64_t disconnects() const { return disconnects_; }
+};
+
+template <typename BodyData>
+void send(NullServer& server, uint32_t id, ClientMessage type, const BodyData& data) {
+  Message<ClientMessage> msg;
+  msg.header.messageId = type;
+  msg.setData(data);
+  server.getIncomingMsgs().push({id, std::move(msg)});
+}
+
+struct Result {
+  bool ok = true;
+  uint64_t roomTicks = 0;
+  uint64_t allocations = 0;
+};
+
+// Run numRooms rooms of playersPerRoom moving players and numRooms rooms of one firing player
+// in a world of the given size, and count the allocations after the warm-up.
+Result run(const WorldSize& world, int numRooms, int playersPerRoom, double warmupSeconds, double seconds) {
+  Result result;
+  int numMovers = numRooms * playersPerRoom;
+  int numClients = numMovers + numRooms;
+  NullServer server(numClients);
+  Lobby<NullServer> lobby(server, 1, world);
+  lobby.update();
+  for (int id = 0; id < numClients; id++)
+    send(server, id, ClientMessage::Join, static_cast<uint32_t>(id < numMovers ? id / playersPerRoom : id));
+  lobby.update();
+
+  std::mt19937 rng(3);
+  std::vector<uint8_t> held(numClients, 0);
+  auto tickDuration = std::chrono::microseconds(1000000 / FRAMES_PER_SECOND);
+  auto start = std::chrono::steady_clock::now();
+  auto countFrom = start + std::chrono::duration<double>(warmupSeconds);
+  auto end = countFrom + std::chrono::duration<double>(seconds);
+  auto nextTick = start;
+  bool counting = false;
+  uint64_t allocationsBefore = 0;
+  uint64_t snapshotsBefore = 0;
+  uint32_t tick = 0;
+  while (std::chrono::steady_clock::now() < end) {
+    if (!counting && std::chrono::steady_clock::now() >= countFrom) {
+      counting = true;
+      allocationsBefore = allocations;
+      snapshotsBefore = server.snapshots();
+    }
+    if (std::chrono::steady_clock::now() >= nextTick) {
+      tick++;
+      for (int id = 0; id < numClients; id++) {
+        if (id < numMovers && rng() % 20 == 0)
+          held[id] = rng() % PlayerInput::bit(PlayerAction::FireBullet);
+        uint8_t firing = PlayerInput::bit(tick <= TURN_TICKS ? PlayerAction::RotateLeft : PlayerAction::FireBullet);
+        send(server, id, ClientMessage::Input, PlayerInput{tick, tick, id < numMovers ? held[id] : firing});
+        uint32_t seq = server.latestSeq(id);
+        uint32_t lag = id % (MAX_ACK_LAG + 1);
+        send(server, id, ClientMessage::SnapshotAck, seq > lag ? seq - lag : 0);
+      }
+      nextTick += tickDuration;
+    }
+    lobby.update();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  result.allocations = allocations - allocationsBefore;
+  result.roomTicks = server.snapshots() - snapshotsBefore;
+  if (server.disconnects() != 0 || server.getIncomingMsgs().dropped() != 0) {
+    std::cout << server.disconnects() << " players disconnected and " << server.getIncomingMsgs().dropped()
+              << " messages dropped; the rooms did not stay the same\n";
+    result.ok = false;
+  }
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  double warmupSeconds = intArg(argc, argv, 1, 5);
+  double seconds = intArg(argc, argv, 2, 3);
+  int numRooms = intArg(argc, argv, 3, 10);
+  int playersPerRoom = intArg(argc, argv, 4, 8);
+
+  std::cout << numRooms << " rooms of " << playersPerRoom << " moving players and " << numRooms
+            << " rooms of one firing player, " << warmupSeconds << " s of warm-up, " << seconds << " s counted\n";
+  bool ok = true;
+  for (WorldSize world : {DEFAULT_WORLD_SIZE, WorldSize{3000, 3000}}) {
+    Result r = run(world, numRooms, playersPerRoom, warmupSeconds, seconds);
+    std::cout << "world " << world.width << " x " << world.height << ": " << r.allocations << " allocations in "
+              << r.roomTicks << " room ticks\n";
+    ok = ok && r.ok && r.allocations == 0 && r.roomTicks > 0;
+  }
+  if (!ok) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,126 @@
+// Jitter and drift of a loop ticking at a fixed rate under load, as a room does. Each tick
+// spins for a while, usually a fifth of the time between two ticks and one tick in twenty for
+// one and a half times it, so that some ticks overrun; meanwhile other threads spin all the
+// time and compete for the cores. The loop is run three ways:
+//   sleep    the room's loop before TickScheduler: tick, then wait the time between two ticks.
+//   catchup  a TickScheduler that runs the ticks it missed back to back.
+//   skip     a TickScheduler that skips them.
+// Each waits on a condition variable, as a room does. Reported are the ticks run and skipped
+// against those due in the time taken, the rate achieved, and how late the ticks started after
+// they were due. A scheduler must neither gain nor lose ticks: the ticks run and skipped must
+// be those due, within the most a loop may be behind when the time is up.
+// Usage: tick_jitter_bench [seconds per loop] [ticks per second] [load threads]
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Bench.hpp"
+#include "Stats.hpp"
+#include "TickScheduler.hpp"
+
+using Clock = TickScheduler::Clock;
+
+enum class Loop { Sleep, CatchUp, Skip };
+
+struct Result {
+  uint64_t ticks = 0;
+  uint64_t skipped = 0;
+  double seconds = 0;
+  std::unique_ptr<LatencyHistogram> lateNs = std::make_unique<LatencyHistogram>();
+};
+
+// Keep the thread busy for the given time.
+void spin(Clock::duration d) {
+  auto end = Clock::now() + d;
+  while (Clock::now() < end) {
+  }
+}
+
+Result run(Loop loop, uint32_t ticksPerSecond, double seconds) {
+  TickRate rate = {ticksPerSecond, loop == Loop::Skip ? OverrunPolicy::Skip : OverrunPolicy::CatchUp};
+  auto start = Clock::now();
+  TickScheduler scheduler(rate, start);
+  Clock::duration period = scheduler.period();
+  auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+  std::mt19937 rng(5);
+  std::uniform_int_distribution<int> slowTick(0, 19);
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stop = false;
+  Result result;
+  // When the tick about to run was due.
+  Clock::time_point due = start;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (loop == Loop::Sleep)
+        wake.wait_for(lock, period, [&]() { return stop; });
+      else
+        wake.wait_until(lock, due, [&]() { return stop; });
+    }
+    auto now = Clock::now();
+    if (now >= end)
+      break;
+    result.lateNs->record(now > due ? std::chrono::duration_cast<std::chrono::nanoseconds>(now - due).count() : 0);
+    spin(slowTick(rng) == 0 ? period * 3 / 2 : period / 5);
+    result.ticks++;
+    if (loop == Loop::Sleep) {
+      // Without a schedule, a tick is due when the wait after the previous one is over.
+      due = Clock::now() + period;
+    } else {
+      result.skipped += scheduler.next(Clock::now());
+      due = scheduler.deadline();
+    }
+  }
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  double seconds = intArg(argc, argv, 1, 3);
+  uint32_t ticksPerSecond = std::max(1, intArg(argc, argv, 2, FRAMES_PER_SECOND));
+  int numLoadThreads = intArg(argc, argv, 3, 1);
+
+  std::atomic<bool> done{false};
+  std::vector<std::thread> load;
+  for (int i = 0; i < numLoadThreads; i++) {
+    load.emplace_back([&]() {
+        while (!done) {
+        }
+      });
+  }
+
+  std::cout << ticksPerSecond << " ticks per second for " << seconds << " s each, " << numLoadThreads
+            << " load threads; one tick in 20 takes 1.5 ticks\n";
+  bool ok = true;
+  const std::pair<Loop, const char*> loops[] = {{Loop::Sleep, "sleep"}, {Loop::CatchUp, "catchup"}, {Loop::Skip, "skip"}};
+  for (auto [loop, name] : loops) {
+    Result result = run(loop, ticksPerSecond, seconds);
+    // Ticks due from the start to the end, the first at the start.
+    double due = result.seconds * ticksPerSecond;
+    double drift = result.ticks + result.skipped - due;
+    std::cout << name << ": " << result.ticks << " ticks, " << result.skipped << " skipped, " << due << " due ("
+              << drift << "), " << result.ticks / result.seconds << " ticks/s\n";
+    printHistogram(std::cout, "  late us", *result.lateNs, 1000);
+    if (loop != Loop::Sleep && (drift < -1.0 * MAX_CATCH_UP_TICKS - 2 || drift > 2)) {
+      std::cout << "  the ticks run and skipped are not those due\n";
+      ok = false;
+    }
+  }
+  done = true;
+  for (std::thread& thread : load)
+    thread.join();
+
+  if (!ok) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+  return 0;
+}
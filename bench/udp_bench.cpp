@@ -0,0 +1,242 @@
+// The UDP transport over loopback with simulated packet loss, delay and jitter in both
+// directions (LinkConditions), with TCP without loss for reference. A server sends a snapshot
+// to every client each tick and clients send an input each tick, like the game does.
+// Reported per run: the share of snapshots received, freezes (no new snapshot for more than
+// FREEZE_MS), the longest time without a new snapshot, and how long inputs take to arrive.
+// Every run checks that each client is welcomed and that every input arrives once and in
+// order, also under loss; the benchmark fails if not.
+// Usage: udp_bench [clients] [seconds per run]
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Bench.hpp"
+#include "Client.hpp"
+#include "ClientMessage.hpp"
+#include "GameMessage.hpp"
+#include "IoThreadPool.hpp"
+#include "Server.hpp"
+#include "UdpClient.hpp"
+#include "UdpServer.hpp"
+
+// A gap between new snapshots longer than this is seen as a freeze.
+const double FREEZE_MS = 100;
+
+// Body of the inputs and snapshots: a sequence number and when it was sent.
+struct Stamp {
+  uint32_t seq = 0;
+  uint64_t sentUs = 0;
+
+  template <typename Archive>
+  void serialize(Archive& ar, const unsigned int /* version */) {
+    ar & seq;
+    ar & sentUs;
+  }
+};
+
+uint64_t nowUs() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+double percentile(std::vector<double> values, double fraction) {
+  if (values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, static_cast<std::size_t>(fraction * values.size()))];
+}
+
+struct Result {
+  bool ok = false;
+  double snapshotsReceived = 0; // Share of the snapshots sent that were received.
+  double freezesPerMinute = 0;
+  double maxGapMs = 0;
+  double inputP50Ms = 0;
+  double inputP99Ms = 0;
+};
+
+// What a client has received.
+template <typename GameClient>
+struct BenchClient {
+  std::unique_ptr<GameClient> client;
+  bool welcomed = false;
+  uint32_t latestSnapshot = 0;
+  uint64_t numSnapshots = 0;
+  uint64_t lastNewSnapshotUs = 0;
+  uint32_t inputSeq = 0;
+};
+
+template <typename GameServer, typename GameClient, typename Resolver>
+Result run(int numClients, double seconds, const LinkConditions& conditions, unsigned short port) {
+  Result result;
+  asio::io_context serverContext;
+  GameServer server(serverContext, port);
+  asio::io_context clientContext;
+  Resolver resolver(clientContext);
+  auto endpoints = resolver.resolve("127.0.0.1", std::to_string(port));
+  std::vector<BenchClient<GameClient>> clients(numClients);
+  for (auto& c : clients)
+    c.client = std::make_unique<GameClient>(clientContext, endpoints);
+  if constexpr (std::is_same_v<GameServer, UdpServer<ClientMessage, GameMessage>>) {
+    server.setLinkConditions(conditions);
+    for (auto& c : clients)
+      c.client->setLinkConditions(conditions);
+  }
+  IoThreadPool serverThreads(serverContext, 1);
+  IoThreadPool clientThreads(clientContext, 1);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (server.numConnections() < numClients) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      std::cout << "only " << server.numConnections() << " of " << numClients << " clients connected\n";
+      return result;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // The server's game loop: welcome new clients and send a snapshot every tick, and check the
+  // inputs every millisecond so that the time they take to arrive is measured closely.
+  std::atomic<bool> stop{false};
+  std::atomic<bool> inputsInOrder{true};
+  std::map<uint32_t, uint32_t> lastInput;
+  std::vector<double> inputLatenciesMs;
+  std::atomic<uint32_t> snapshotsSent{0};
+  auto tickDuration = std::chrono::microseconds(1000000 / FRAMES_PER_SECOND);
+  std::thread gameLoop([&]() {
+      auto nextTick = std::chrono::steady_clock::now();
+      while (!stop) {
+        for (uint32_t id : server.getIDs()) {
+          if (lastInput.count(id) == 0) {
+            lastInput[id] = 0;
+            Message<GameMessage> welcome;
+            welcome.header.messageId = GameMessage::Welcome;
+            welcome.setData(WelcomeInfo{id, FRAMES_PER_SECOND});
+            server.writeTo(id, welcome);
+          }
+        }
+        server.getIncomingMsgs().drain([&](OwnedMessage<ClientMessage>&& ownedMsg) {
+            Stamp input;
+            if (ownedMsg.msg.header.messageId != ClientMessage::Input || !ownedMsg.msg.getData(input))
+              return;
+            if (input.seq != lastInput[ownedMsg.id] + 1)
+              inputsInOrder = false;
+            lastInput[ownedMsg.id] = input.seq;
+            inputLatenciesMs.push_back((nowUs() - input.sentUs) / 1000.0);
+          });
+        if (std::chrono::steady_clock::now() >= nextTick) {
+          Message<GameMessage> snapshot;
+          snapshot.header.messageId = GameMessage::GameState;
+          snapshot.setData(Stamp{++snapshotsSent, nowUs()});
+          server.writeToAll(snapshot);
+          nextTick += tickDuration;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+
+  // The clients: an input every tick, and the snapshots taken every millisecond.
+  uint64_t freezes = 0;
+  double maxGapMs = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::duration<double>(seconds);
+  auto nextTick = start;
+  for (auto& c : clients)
+    c.lastNewSnapshotUs = nowUs();
+  while (std::chrono::steady_clock::now() < end) {
+    for (auto& c : clients) {
+      c.client->getIncomingMsgs().drain([&](OwnedMessage<GameMessage>&& ownedMsg) {
+          Stamp snapshot;
+          if (ownedMsg.msg.header.messageId == GameMessage::Welcome) {
+            c.welcomed = true;
+          } else if (ownedMsg.msg.getData(snapshot) && snapshot.seq > c.latestSnapshot) {
+            uint64_t now = nowUs();
+            double gapMs = (now - c.lastNewSnapshotUs) / 1000.0;
+            freezes += gapMs > FREEZE_MS;
+            maxGapMs = std::max(maxGapMs, gapMs);
+            c.latestSnapshot = snapshot.seq;
+            c.lastNewSnapshotUs = now;
+            c.numSnapshots++;
+          }
+        });
+    }
+    if (std::chrono::steady_clock::now() >= nextTick) {
+      for (auto& c : clients) {
+        Message<ClientMessage> input;
+        input.header.messageId = ClientMessage::Input;
+        input.setData(Stamp{++c.inputSeq, nowUs()});
+        c.client->send(input);
+      }
+      nextTick += tickDuration;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  uint32_t snapshotsSentInTime = snapshotsSent;
+  // Give the last inputs time to arrive, resent if they were lost.
+  std::this_thread::sleep_for(std::chrono::milliseconds(conditions.delayMs + conditions.jitterMs + 4 * UDP_RESEND_MS));
+  stop = true;
+  gameLoop.join();
+
+  result.ok = inputsInOrder;
+  uint64_t snapshotsReceived = 0;
+  for (auto& c : clients) {
+    snapshotsReceived += c.numSnapshots;
+    if (!c.welcomed || !c.client->isConnected()) {
+      std::cout << "a client was not welcomed or lost its connection\n";
+      result.ok = false;
+    }
+  }
+  for (auto& [id, seq] : lastInput) {
+    if (seq != clients.front().inputSeq) {
+      std::cout << "client " << id << ": " << seq << " of " << clients.front().inputSeq << " inputs arrived\n";
+      result.ok = false;
+    }
+  }
+  for (auto& c : clients)
+    c.client->disconnect();
+
+  result.snapshotsReceived = static_cast<double>(snapshotsReceived) / (static_cast<double>(snapshotsSentInTime) * numClients);
+  result.freezesPerMinute = freezes * 60.0 / seconds / numClients;
+  result.maxGapMs = maxGapMs;
+  result.inputP50Ms = percentile(inputLatenciesMs, 0.5);
+  result.inputP99Ms = percentile(inputLatenciesMs, 0.99);
+  return result;
+}
+
+void print(const char* transport, const LinkConditions& conditions, const Result& r) {
+  std::cout << transport << "  " << conditions.loss * 100 << "%  " << conditions.delayMs << "+"
+            << conditions.jitterMs << "  | " << r.snapshotsReceived * 100 << "%  " << r.freezesPerMinute
+            << "  " << r.maxGapMs << "  | " << r.inputP50Ms << "  " << r.inputP99Ms << "\n";
+}
+
+int main(int argc, char* argv[]) {
+  int numClients = intArg(argc, argv, 1, 10);
+  double seconds = intArg(argc, argv, 2, 5);
+
+  std::cout << numClients << " clients, " << FRAMES_PER_SECOND << " snapshots and inputs per second\n";
+  std::cout << "transport  loss  delay ms  | snapshots received  freezes/min  max gap ms"
+            << "  | input latency ms p50  p99\n";
+  unsigned short port = 60200;
+  Result tcp = run<Server<ClientMessage, GameMessage>, Client<GameMessage, ClientMessage>, asio::ip::tcp::resolver>(
+    numClients, seconds, LinkConditions{}, port++);
+  if (!tcp.ok) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+  print("tcp", LinkConditions{}, tcp);
+  for (LinkConditions conditions : {LinkConditions{0, 0, 0}, LinkConditions{0.02, 20, 10},
+                                    LinkConditions{0.1, 20, 10}, LinkConditions{0.3, 20, 10}}) {
+    Result udp = run<UdpServer<ClientMessage, GameMessage>, UdpClient<GameMessage, ClientMessage>, asio::ip::udp::resolver>(
+      numClients, seconds, conditions, port++);
+    if (!udp.ok) {
+      std::cout << "FAILED: inputs lost or out of order\n";
+      return 1;
+    }
+    print("udp", conditions, udp);
+  }
+  return 0;
+}
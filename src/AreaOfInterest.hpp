@@ -0,0 +1,141 @@
+#ifndef AREA_OF_INTEREST_H
+#define AREA_OF_INTEREST_H
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "Camera.hpp"
+#include "Game.hpp"
+#include "SpatialGrid.hpp"
+#include "Utils.hpp"
+
+// Room around a client's view in which players and bullets are sent too, so that they are
+// known before they come into view, also when the client draws the game a little in the past.
+const int INTEREST_MARGIN = 200;
+// Side of the cells of the grid used for finding what is in an area of interest.
+const int INTEREST_CELL_SIZE = 256;
+
+// Server side area of interest management. Each client is only sent the players and bullets in
+// its area of interest: what its camera shows (see cameraView()) plus a margin. A grid of the
+// players and bullets is built once per snapshot and each client's area is looked up in it, so
+// making a client's view costs time in proportion to how crowded its area is, not to the number
+// of players in the world. A client whose player is dead keeps the area where the player was last.
+class AreaOfInterest {
+  WorldSize world_;
+  SpatialGrid grid_;
+  // The game the grid was built from. Its players come first in the grid, followed by its bullets.
+  const Game* game_ = nullptr;
+  std::vector<const Player*> players_;
+  const BulletPool* bullets_ = nullptr;
+  // IDs of those bullets, sorted.
+  std::vector<uint32_t> bulletIds_;
+  // Where each client's player was last, by ID.
+  std::map<uint32_t, Point> lastPos_;
+  // Map nodes of the players of earlier views, used again for the next views so that making
+  // a view does not allocate. It has room for all numNodes_ nodes made, so it never grows.
+  std::vector<std::map<uint32_t, Player>::node_type> spareNodes_;
+  std::size_t numNodes_ = 0;
+  // Most bullets in a view so far, which every view is given room for, so that the bullets of
+  // a view only allocate when a view holds more of them than any before.
+  std::size_t largestView_ = 0;
+
+public:
+  explicit AreaOfInterest(const WorldSize& world)
+    : world_(world), grid_(world.width, world.height, INTEREST_CELL_SIZE) {
+    // Bullets are smaller than a cell, so each is in four cells at most.
+    grid_.reserve(BULLET_POOL_CAPACITY, 4);
+    bulletIds_.reserve(BULLET_POOL_CAPACITY);
+  }
+
+  // Put the players and bullets of a game in the grid. The game must not change while views of it are made.
+  void build(const Game& game) {
+    game_ = &game;
+    players_.clear();
+    for (auto& [id, player] : game.players_)
+      players_.push_back(&player);
+    bullets_ = &game.bullets_;
+    grid_.build(players_.size() + bullets_->size(), [this](uint32_t i) { return rectOf(i); });
+    bulletIds_.assign(bullets_->ids(), bullets_->ids() + bullets_->size());
+    std::sort(bulletIds_.begin(), bulletIds_.end());
+  }
+
+  // The game given to build(), of which views are made.
+  const Game& game() const { return *game_; }
+
+  // Whether the game given to build() has the bullet with the given ID, whether or not it is
+  // in a client's view.
+  bool hasBullet(uint32_t id) const { return std::binary_search(bulletIds_.begin(), bulletIds_.end(), id); }
+
+  // The area of interest of the client with the given ID in the game given to build().
+  Rect areaOf(uint32_t id, const Game& game) {
+    auto found = game.players_.find(id);
+    if (found != game.players_.end())
+      lastPos_[id] = found->second.getPos();
+    auto last = lastPos_.find(id);
+    Point pos = last != lastPos_.end() ? last->second : Point{world_.width / 2, world_.height / 2};
+    Rect view = cameraView(pos, world_);
+    return {view.x - INTEREST_MARGIN, view.y - INTEREST_MARGIN,
+            view.w + 2 * INTEREST_MARGIN, view.h + 2 * INTEREST_MARGIN};
+  }
+
+  // Make out the part of the game given to build() that the client with the given ID is sent.
+  // out is a new game or an earlier view, whose storage is used again.
+  void view(const Game& game, uint32_t id, Game& out) {
+    Rect area = areaOf(id, game);
+    while (!out.players_.empty())
+      spareNodes_.push_back(out.players_.extract(out.players_.begin()));
+    out.bullets_.clear();
+    out.bullets_.reserve(largestView_);
+    out.world_ = world_;
+    out.tick_ = game.tick_;
+    out.ticksPerSecond_ = game.ticksPerSecond_;
+    grid_.query(area, [&](uint32_t i) {
+        if (!collidesRect(rectOf(i), area))
+          return;
+        if (i < players_.size()) {
+          addPlayer(out, *players_[i]);
+        } else {
+          std::size_t b = i - players_.size();
+          out.bullets_.add(bullets_->get(b), bullets_->spawn(b));
+        }
+      });
+    largestView_ = std::max(largestView_, out.bullets_.size());
+  }
+
+  // Forget the clients that are no longer connected.
+  void retain(const std::vector<uint32_t>& ids) {
+    for (auto it = lastPos_.begin(); it != lastPos_.end();) {
+      if (std::find(ids.begin(), ids.end(), it->first) == ids.end())
+        it = lastPos_.erase(it);
+      else
+        ++it;
+    }
+  }
+
+private:
+  void addPlayer(Game& out, const Player& player) {
+    if (spareNodes_.empty()) {
+      out.players_.insert({player.getID(), player});
+      spareNodes_.reserve(++numNodes_);
+      return;
+    }
+    std::map<uint32_t, Player>::node_type node = std::move(spareNodes_.back());
+    spareNodes_.pop_back();
+    node.key() = player.getID();
+    node.mapped() = player;
+    out.players_.insert(std::move(node));
+  }
+
+  // Rectangle of player i, or of bullet i minus the number of players, as drawn.
+  Rect rectOf(uint32_t i) const {
+    if (i < players_.size()) {
+      Point pos = players_[i]->getPos();
+      return {pos.x, pos.y, PLAYER_SIDE, PLAYER_SIDE};
+    }
+    std::size_t b = i - players_.size();
+    return {bullets_->xs()[b], bullets_->ys()[b], 2 * BULLET_SIDE, BULLET_SIDE};
+  }
+};
+
+#endif
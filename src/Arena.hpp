@@ -0,0 +1,71 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Size of the first block of an arena. Later blocks are at least as large as the one before.
+const std::size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+// Memory for short-lived temporaries, like those made while encoding a snapshot. Allocating
+// moves a pointer through the current block and freeing does nothing; reset() makes all of it
+// free again at once. The blocks are kept across resets, so once an arena has grown to the
+// most memory used between two resets it never allocates from the heap again.
+// Used through std::pmr containers. Not thread-safe; each thread uses its own arena.
+class TickArena : public std::pmr::memory_resource {
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    std::size_t size;
+  };
+
+  std::vector<Block> blocks_;
+  // Block allocated from, and how much of it is used.
+  std::size_t current_ = 0;
+  std::size_t used_ = 0;
+
+public:
+  TickArena() = default;
+  TickArena(const TickArena&) = delete;
+  TickArena& operator=(const TickArena&) = delete;
+
+  // Free everything allocated from the arena. Containers using it must be gone.
+  void reset() {
+    current_ = 0;
+    used_ = 0;
+  }
+
+  // Total size of the blocks, the most memory used between two resets so far, roughly.
+  std::size_t capacity() const {
+    std::size_t total = 0;
+    for (const Block& block : blocks_)
+      total += block.size;
+    return total;
+  }
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    while (current_ < blocks_.size()) {
+      Block& block = blocks_[current_];
+      void* p = block.data.get() + used_;
+      std::size_t space = block.size - used_;
+      if (std::align(alignment, bytes, p, space)) {
+        used_ = block.size - space + bytes;
+        return p;
+      }
+      current_++;
+      used_ = 0;
+    }
+    std::size_t size = std::max({ARENA_BLOCK_SIZE, blocks_.empty() ? 0 : blocks_.back().size, bytes + alignment});
+    blocks_.push_back({std::make_unique<std::byte[]>(size), size});
+    return do_allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* /* p */, std::size_t /* bytes */, std::size_t /* alignment */) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef BIT_PACKING_H
+#define BIT_PACKING_H
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+
+#include "Codec.hpp"
+
+// Bit streams for the parts of the wire format where fields are smaller than a byte, like the
+// entities in snapshots (see SnapshotCodec). Values are written with as many bits as they are
+// given, least significant bit first, and the stream is padded with zeroes to a whole byte
+// when it is flushed. Counts and IDs, which are usually small, are written as variable-length
+// integers: groups of seven bits, each followed by a bit that says whether another group follows.
+
+// Number of bits needed for every value from 0 to maxValue.
+int bitsFor(uint32_t maxValue) {
+  int bits = 0;
+  while (bits < 32 && (maxValue >> bits) != 0)
+    bits++;
+  return bits;
+}
+
+// Map signed integers to unsigned ones so that values near zero stay small: 0, -1, 1, -2, ...
+// become 0, 1, 2, 3, ...
+uint32_t zigzag(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+int32_t unzigzag(uint32_t value) {
+  return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+// Appends bits to a buffer, which is not cleared, like BinaryWriter's. A BitWriter made from a
+// BinaryWriter continues its buffer and shares its scratch memory.
+class BitWriter {
+  std::string& buffer_;
+  std::pmr::memory_resource* scratch_;
+  uint64_t pending_ = 0;
+  int numPending_ = 0;
+
+public:
+  explicit BitWriter(std::string& buffer, std::pmr::memory_resource* scratch = std::pmr::new_delete_resource())
+    : buffer_(buffer), scratch_(scratch) {}
+
+  explicit BitWriter(BinaryWriter& writer) : BitWriter(writer.buffer(), writer.scratch()) {}
+
+  ~BitWriter() { flush(); }
+
+  std::pmr::memory_resource* scratch() const { return scratch_; }
+
+  // Write the low bits of value.
+  void write(uint32_t value, int bits) {
+    if (bits < 32)
+      value &= (1u << bits) - 1;
+    pending_ |= static_cast<uint64_t>(value) << numPending_;
+    numPending_ += bits;
+    while (numPending_ >= 8) {
+      buffer_.push_back(static_cast<char>(pending_ & 0xff));
+      pending_ >>= 8;
+      numPending_ -= 8;
+    }
+  }
+
+  void writeBool(bool value) { write(value, 1); }
+
+  void writeVarint(uint32_t value) {
+    while (value >= 0x80) {
+      write((value & 0x7f) | 0x80, 8);
+      value >>= 7;
+    }
+    write(value, 8);
+  }
+
+  void writeSigned(int32_t value) { writeVarint(zigzag(value)); }
+
+  // Pad the bits written so far to a whole byte and append them to the buffer.
+  void flush() {
+    if (numPending_ > 0)
+      write(0, 8 - numPending_);
+  }
+
+  // Number of bits written.
+  std::size_t bits() const { return buffer_.size() * 8 + numPending_; }
+};
+
+// Reads the bits written by a BitWriter from a buffer without copying it. Reading past the end
+// of the buffer marks the reader as failed; later reads then yield zeroes.
+class BitReader {
+  const uint8_t* pos_;
+  const uint8_t* end_;
+  uint64_t pending_ = 0;
+  int numPending_ = 0;
+  bool ok_ = true;
+
+public:
+  BitReader(const void* data, std::size_t size)
+    : pos_(static_cast<const uint8_t*>(data)), end_(pos_ + size) {}
+
+  // A reader of what is left of a BinaryReader's buffer.
+  explicit BitReader(const BinaryReader& reader) : BitReader(reader.position(), reader.remaining()) {}
+
+  uint32_t read(int bits) {
+    while (numPending_ < bits) {
+      if (pos_ == end_) {
+        ok_ = false;
+        return 0;
+      }
+      pending_ |= static_cast<uint64_t>(*pos_++) << numPending_;
+      numPending_ += 8;
+    }
+    if (!ok_)
+      return 0;
+    uint32_t value = static_cast<uint32_t>(pending_ & ((uint64_t(1) << bits) - 1));
+    pending_ >>= bits;
+    numPending_ -= bits;
+    return value;
+  }
+
+  bool readBool() { return read(1) != 0; }
+
+  uint32_t readVarint() {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint32_t group = read(8);
+      value |= (group & 0x7f) << shift;
+      if ((group & 0x80) == 0)
+        return value;
+    }
+    ok_ = false; // More groups than a 32-bit value has.
+    return 0;
+  }
+
+  int32_t readSigned() { return unzigzag(readVarint()); }
+
+  // A count of elements that take at least one bit each. Larger counts than the bits left can
+  // only come from a corrupt message.
+  uint32_t readCount() {
+    uint32_t count = readVarint();
+    if (count > remainingBits()) {
+      ok_ = false;
+      return 0;
+    }
+    return count;
+  }
+
+  // True if every read so far was within the buffer.
+  bool ok() const { return ok_; }
+
+  std::size_t remainingBits() const { return (end_ - pos_) * 8 + numPending_; }
+};
+
+#endif
@@ -8,37 +8,61 @@
 #include <cmath>
 #include "Utils.hpp"
 #include <iostream>
-  
+
+// How fast bullets fly, in pixels a second.
+const int BULLET_SPEED = 360;
+
+// How far, to the nearest pixel, a bullet going the given number of pixels a second along one
+// axis goes in the given number of ticks, which may be a fraction, of a game ticking
+// ticksPerSecond times a second.
+int bulletTravel(int speed, double ticks, uint32_t ticksPerSecond) {
+  return static_cast<int>(std::lround(speed * ticks / ticksPerSecond));
+}
+
 class Bullet {
+  // Unique within a game, so that bullets can be matched between snapshots.
+  uint32_t id_ = 0;
   Point pos_;
+  // Pixels a second.
   Velocity vel_;
   double angle_;
 
+  friend class GameDelta;
+  friend class SnapshotInterpolator;
+
 public:
 
   template<class Archive>
   void serialize(Archive& ar, const unsigned int version)
   {
+    ar & id_;
     ar & pos_;
+    ar & vel_;
     ar & angle_;
   }
 
   Bullet() {}
   
-  Bullet(int x, int y, int dx, int dy) {
-    
+  Bullet(int x, int y, int dx, int dy, double angle, uint32_t id) {
+    id_ = id;
+    angle_ = angle;
     pos_ = {x, y};
     vel_ = {dx, dy};
   }
 
-  Bullet(int x, int y, double angle) {
+  Bullet(int x, int y, double angle, uint32_t id = 0) {
+    id_ = id;
     angle_ = angle;
     pos_ = {x, y};
-    int dx = static_cast<int>(std::round(6 * cos(angle * DEG_TO_RAD)));
-    int dy = static_cast<int>(std::round(6 * sin(angle * DEG_TO_RAD)));
+    int dx = static_cast<int>(std::round(BULLET_SPEED * cos(angle * DEG_TO_RAD)));
+    int dy = static_cast<int>(std::round(BULLET_SPEED * sin(angle * DEG_TO_RAD)));
     vel_ = {dx, dy};
   }
 
+  uint32_t getID() const {
+    return id_;
+  }
+
   Point getPos() const {
     return pos_;
   }
@@ -47,19 +71,57 @@ public:
     return vel_;
   }
 
-  double getAngle() {
+  double getAngle() const {
     return angle_;
   }
-  
-  void move() {
-    pos_.x = pos_.x + vel_.dx;
-    pos_.y = pos_.y + vel_.dy;
+
+};
+
+// A bullet as it was fired. Bullets fly in a straight line at a fixed speed, so this is all it
+// takes to know where a bullet is at any tick; snapshots send each bullet this way, once.
+struct BulletSpawn {
+  uint32_t id = 0;
+  // ID of the player who fired the bullet.
+  uint32_t owner = 0;
+  Point origin = {0, 0};
+  double angle = 0;
+  // Tick of the game the bullet was fired at, when it was at its origin.
+  uint32_t tick = 0;
+
+  template<class Archive>
+  void serialize(Archive& ar, const unsigned int version)
+  {
+    ar & id;
+    ar & owner;
+    ar & origin;
+    ar & angle;
+    ar & tick;
   }
 
-  bool operator==(const Bullet& other) {
-    return pos_.x == other.getPos().x && pos_.y == other.getPos().y;
+  // The bullet as it is at the given tick, which may lie between two ticks, of a game ticking
+  // ticksPerSecond times a second.
+  Bullet at(double t, uint32_t ticksPerSecond) const {
+    Bullet fired(origin.x, origin.y, angle, id);
+    Velocity vel = fired.getVel();
+    double ticks = t - tick;
+    return Bullet(origin.x + bulletTravel(vel.dx, ticks, ticksPerSecond),
+                  origin.y + bulletTravel(vel.dy, ticks, ticksPerSecond), vel.dx, vel.dy, angle, id);
   }
+};
+
+// Why a bullet a client was sent is not in its snapshots anymore.
+enum class DespawnReason : uint8_t { HitPlayer, LeftWorld, OwnerGone, LeftView };
 
+struct BulletDespawn {
+  uint32_t id = 0;
+  DespawnReason reason = DespawnReason::HitPlayer;
+
+  template<class Archive>
+  void serialize(Archive& ar, const unsigned int version)
+  {
+    ar & id;
+    ar & reason;
+  }
 };
 
 #endif
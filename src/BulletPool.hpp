@@ -0,0 +1,214 @@
+#ifndef BULLET_POOL_H
+#define BULLET_POOL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <numeric>
+#include <vector>
+
+#include "Bullet.hpp"
+#include "Codec.hpp"
+
+// Maximum number of bullets in flight in a game. Bullets fired while the pool is full are dropped.
+const std::size_t BULLET_POOL_CAPACITY = 4096;
+
+// All bullets of a game, stored as struct-of-arrays so that moving and testing them are
+// tight loops over contiguous memory. Bullet i is made up of element i of every array.
+// The arrays grow as needed up to the capacity and keep their storage when bullets are removed.
+// Removal swaps the last bullet into the hole, so the order of the bullets is not stable;
+// use IDs, not indices, to refer to a bullet across changes to the pool.
+class BulletPool {
+  std::vector<int32_t> x_;
+  std::vector<int32_t> y_;
+  std::vector<int32_t> dx_;
+  std::vector<int32_t> dy_;
+  std::vector<double> angle_;
+  // ID of the player who fired the bullet.
+  std::vector<uint32_t> owner_;
+  std::vector<uint32_t> id_;
+  // Where and at which tick the bullet was fired.
+  std::vector<int32_t> originX_;
+  std::vector<int32_t> originY_;
+  std::vector<uint32_t> spawnTick_;
+
+public:
+  // For (de)serialization, as the spawn of each bullet; tick and ticksPerSecond are those of the
+  // game the pool belongs to, by which loaded bullets are placed. Bullets are written grouped by owner and
+  // in order of ID within each owner, so the encoding of a pool does not depend on the order
+  // of removals.
+  template<class Archive>
+  void serializeSpawns(Archive& ar, uint32_t tick, uint32_t ticksPerSecond) {
+    if constexpr (Archive::is_saving::value) {
+      std::pmr::vector<uint32_t> order = byOwner(scratchOf(ar));
+      uint32_t count = order.size();
+      ar & count;
+      for (uint32_t i : order) {
+        BulletSpawn s = spawn(i);
+        ar & s;
+      }
+    } else {
+      clear();
+      uint32_t count = 0;
+      ar & count;
+      for (uint32_t i = 0; i < count; i++) {
+        BulletSpawn s;
+        ar & s;
+        add(s, tick, ticksPerSecond);
+      }
+    }
+  }
+
+  std::size_t size() const { return id_.size(); }
+
+  bool full() const { return size() >= BULLET_POOL_CAPACITY; }
+
+  // Number of bullets the pool has room for without allocating.
+  std::size_t capacity() const { return id_.capacity(); }
+
+  void reserve(std::size_t capacity) {
+    forEachArray([capacity](auto& array) { array.reserve(capacity); });
+  }
+
+  // Add bullet b, fired as given by its spawn. Returns false if the pool is full.
+  bool add(const Bullet& b, const BulletSpawn& spawn) {
+    if (full())
+      return false;
+    x_.push_back(b.getPos().x);
+    y_.push_back(b.getPos().y);
+    dx_.push_back(b.getVel().dx);
+    dy_.push_back(b.getVel().dy);
+    angle_.push_back(b.getAngle());
+    owner_.push_back(spawn.owner);
+    id_.push_back(b.getID());
+    originX_.push_back(spawn.origin.x);
+    originY_.push_back(spawn.origin.y);
+    spawnTick_.push_back(spawn.tick);
+    return true;
+  }
+
+  // Add the bullet of the given spawn where it is at the given tick of a game ticking
+  // ticksPerSecond times a second.
+  bool add(const BulletSpawn& spawn, uint32_t tick, uint32_t ticksPerSecond) {
+    return add(spawn.at(tick, ticksPerSecond), spawn);
+  }
+
+  // Remove bullet i by moving the last bullet into its place.
+  void remove(std::size_t i) {
+    forEachArray([i](auto& array) {
+      array[i] = array.back();
+      array.pop_back();
+    });
+  }
+
+  // Remove every bullet for which pred(i) is true.
+  template <typename Pred>
+  void removeIf(Pred pred) {
+    std::size_t i = 0;
+    while (i < size()) {
+      if (pred(i))
+        remove(i); // The last bullet is now at i and has to be tested too.
+      else
+        i++;
+    }
+  }
+
+  void removeOwnedBy(uint32_t owner) {
+    removeIf([&](std::size_t i) { return owner_[i] == owner; });
+  }
+
+  void clear() {
+    forEachArray([](auto& array) { array.clear(); });
+  }
+
+  // Make this pool a copy of another. The arrays are first given as much room as the other
+  // pool's, which have room for the most bullets it has held, so a pool kept as a copy of
+  // another allocates no more once the other has, whatever the number of bullets at the time.
+  void copyFrom(const BulletPool& other) {
+    reserve(other.capacity());
+    x_.assign(other.x_.begin(), other.x_.end());
+    y_.assign(other.y_.begin(), other.y_.end());
+    dx_.assign(other.dx_.begin(), other.dx_.end());
+    dy_.assign(other.dy_.begin(), other.dy_.end());
+    angle_.assign(other.angle_.begin(), other.angle_.end());
+    owner_.assign(other.owner_.begin(), other.owner_.end());
+    id_.assign(other.id_.begin(), other.id_.end());
+    originX_.assign(other.originX_.begin(), other.originX_.end());
+    originY_.assign(other.originY_.begin(), other.originY_.end());
+    spawnTick_.assign(other.spawnTick_.begin(), other.spawnTick_.end());
+  }
+
+  // Move every bullet to where it is at the given tick of a game ticking ticksPerSecond times a
+  // second. Bullets are placed from where and when they were fired rather than moved by a step
+  // each tick, since at most rates they do not go a whole number of pixels a tick; a bullet is
+  // then on the same pixel at a tick whichever ticks it was moved at before, as BulletSpawn::at()
+  // places it.
+  void moveTo(uint32_t tick, uint32_t ticksPerSecond) {
+    std::size_t n = size();
+    int32_t* x = x_.data();
+    int32_t* y = y_.data();
+    const int32_t* dx = dx_.data();
+    const int32_t* dy = dy_.data();
+    const int32_t* originX = originX_.data();
+    const int32_t* originY = originY_.data();
+    const uint32_t* spawnTick = spawnTick_.data();
+    for (std::size_t i = 0; i < n; i++) {
+      double ticks = static_cast<double>(tick) - spawnTick[i];
+      x[i] = originX[i] + bulletTravel(dx[i], ticks, ticksPerSecond);
+      y[i] = originY[i] + bulletTravel(dy[i], ticks, ticksPerSecond);
+    }
+  }
+
+  // Indices of the bullets sorted by owner, and by ID for each owner, allocated from memory.
+  std::pmr::vector<uint32_t> byOwner(std::pmr::memory_resource* memory = std::pmr::get_default_resource()) const {
+    std::pmr::vector<uint32_t> order(size(), memory);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+      return owner_[a] != owner_[b] ? owner_[a] < owner_[b] : id_[a] < id_[b];
+    });
+    return order;
+  }
+
+  // Indices of the bullets sorted by ID, allocated from memory.
+  std::pmr::vector<uint32_t> byID(std::pmr::memory_resource* memory = std::pmr::get_default_resource()) const {
+    std::pmr::vector<uint32_t> order(size(), memory);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return id_[a] < id_[b]; });
+    return order;
+  }
+
+  // Bullet i as an object.
+  Bullet get(std::size_t i) const {
+    return Bullet(x_[i], y_[i], dx_[i], dy_[i], angle_[i], id_[i]);
+  }
+
+  // How bullet i was fired.
+  BulletSpawn spawn(std::size_t i) const {
+    return {id_[i], owner_[i], {originX_[i], originY_[i]}, angle_[i], spawnTick_[i]};
+  }
+
+  const int32_t* xs() const { return x_.data(); }
+  const int32_t* ys() const { return y_.data(); }
+  int32_t* xs() { return x_.data(); }
+  int32_t* ys() { return y_.data(); }
+  const double* angles() const { return angle_.data(); }
+  const uint32_t* owners() const { return owner_.data(); }
+  const uint32_t* ids() const { return id_.data(); }
+
+private:
+  template <typename F>
+  void forEachArray(F f) {
+    f(x_);
+    f(y_);
+    f(dx_);
+    f(dy_);
+    f(angle_);
+    f(owner_);
+    f(id_);
+    f(originX_);
+    f(originY_);
+    f(spawnTick_);
+  }
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <algorithm>
+
+#include "Player.hpp"
+#include "Utils.hpp"
+
+// The part of the world shown in the window when following a player: a window-sized area
+// centred on the player, moved as little as needed to keep it within the world, so that no
+// space outside the world is shown. A world narrower or lower than the window is shown from its
+// left or top edge. The server uses this too, to know what each client can see.
+Rect cameraView(Point playerPos, const WorldSize& world) {
+  int x = playerPos.x + PLAYER_SIDE / 2 - SCREEN_WIDTH / 2;
+  int y = playerPos.y + PLAYER_SIDE / 2 - SCREEN_HEIGHT / 2;
+  x = std::clamp(x, 0, std::max(0, world.width - SCREEN_WIDTH));
+  y = std::clamp(y, 0, std::max(0, world.height - SCREEN_HEIGHT));
+  return {x, y, SCREEN_WIDTH, SCREEN_HEIGHT};
+}
+
+// Whether the camera shows the whole world wherever the player is.
+bool cameraShowsWorld(const WorldSize& world) {
+  return world.width <= SCREEN_WIDTH && world.height <= SCREEN_HEIGHT;
+}
+
+#endif
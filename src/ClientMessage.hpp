@@ -0,0 +1,15 @@
+#ifndef CLIENT_MESSAGE_H
+#define CLIENT_MESSAGE_H
+
+// Messages sent from clients to the server.
+// Input carries a PlayerInput in its body and is sent once per client tick; SnapshotAck carries
+// the sequence number of the latest snapshot the client has received. Join carries the u32 ID of
+// the room the client wants to play in, and is sent once the client has been welcomed.
+enum class ClientMessage : uint8_t { Input, SnapshotAck, Join };
+
+// Whether a message must arrive, over transports that can lose messages. Every input is applied
+// by the server and a client is only in a room once it has joined, while a lost acknowledgement
+// is made up for by the next one.
+bool isReliable(ClientMessage id) { return id == ClientMessage::Input || id == ClientMessage::Join; }
+
+#endif
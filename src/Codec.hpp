@@ -0,0 +1,211 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Compact little-endian binary archives used for the wire format.
+// They plug into the same serialize(Archive&, version) functions as the Boost archives,
+// so every class describes its layout in one place. Integers and enums are written with
+// their exact width, doubles as their IEEE-754 bit pattern and containers as a 32-bit count
+// followed by their elements. There are no archive headers or version tags.
+
+// Store an unsigned integer in little-endian byte order.
+template <typename UInt>
+void storeLE(uint8_t* out, UInt value) {
+  for (std::size_t i = 0; i < sizeof(UInt); i++) {
+    out[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+// Load an unsigned integer stored in little-endian byte order.
+template <typename UInt>
+UInt loadLE(const uint8_t* in) {
+  UInt value = 0;
+  for (std::size_t i = 0; i < sizeof(UInt); i++) {
+    value |= static_cast<UInt>(in[i]) << (8 * i);
+  }
+  return value;
+}
+
+// Unsigned integer type with the same width as T. Used for reinterpreting signed integers,
+// enums and floating point values as raw bits.
+template <std::size_t Size> struct UIntOfSize;
+template <> struct UIntOfSize<1> { using type = uint8_t; };
+template <> struct UIntOfSize<2> { using type = uint16_t; };
+template <> struct UIntOfSize<4> { using type = uint32_t; };
+template <> struct UIntOfSize<8> { using type = uint64_t; };
+
+template <typename T>
+using RawBits = typename UIntOfSize<sizeof(T)>::type;
+
+template <typename T> struct IsVector : std::false_type {};
+template <typename T, typename A> struct IsVector<std::vector<T, A>> : std::true_type {};
+
+template <typename T> struct IsMap : std::false_type {};
+template <typename K, typename V, typename C, typename A> struct IsMap<std::map<K, V, C, A>> : std::true_type {};
+
+// Archive that appends the encoding of objects to a buffer.
+// The buffer is not cleared, so it can be reused between messages to avoid reallocations.
+// Objects that need temporaries to encode themselves allocate them from the writer's scratch
+// memory, which is the heap unless another memory resource, like a TickArena, is given.
+class BinaryWriter {
+  std::string& buffer_;
+  std::pmr::memory_resource* scratch_;
+
+public:
+  using is_saving = std::true_type;
+  using is_loading = std::false_type;
+
+  explicit BinaryWriter(std::string& buffer, std::pmr::memory_resource* scratch = std::pmr::new_delete_resource())
+    : buffer_(buffer), scratch_(scratch) {}
+
+  std::pmr::memory_resource* scratch() const { return scratch_; }
+
+  // The buffer written to, for continuing it in another format, like a BitWriter.
+  std::string& buffer() const { return buffer_; }
+
+  template <typename T>
+  BinaryWriter& operator&(const T& value) {
+    write(value);
+    return *this;
+  }
+
+  template <typename T>
+  BinaryWriter& operator<<(const T& value) {
+    write(value);
+    return *this;
+  }
+
+  std::size_t size() const { return buffer_.size(); }
+
+private:
+  template <typename T>
+  void write(const T& value) {
+    if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+      RawBits<T> bits;
+      std::memcpy(&bits, &value, sizeof(T));
+      uint8_t bytes[sizeof(T)];
+      storeLE(bytes, bits);
+      buffer_.append(reinterpret_cast<const char*>(bytes), sizeof(T));
+    } else if constexpr (IsVector<T>::value) {
+      write(static_cast<uint32_t>(value.size()));
+      for (const auto& element : value)
+        write(element);
+    } else if constexpr (IsMap<T>::value) {
+      write(static_cast<uint32_t>(value.size()));
+      for (const auto& [key, mapped] : value) {
+        write(key);
+        write(mapped);
+      }
+    } else {
+      // serialize() is shared with loading and therefore not const, like in Boost.
+      const_cast<T&>(value).serialize(*this, 0);
+    }
+  }
+};
+
+// Scratch memory of an archive: the writer's own, or the heap for other archives, like Boost's.
+template <typename Archive>
+std::pmr::memory_resource* scratchOf(const Archive& ar) {
+  if constexpr (std::is_same_v<Archive, BinaryWriter>)
+    return ar.scratch();
+  else
+    return std::pmr::get_default_resource();
+}
+
+// Archive that decodes objects from a buffer without copying it.
+// Reading past the end of the buffer or a container count that cannot fit in the remaining
+// bytes marks the reader as failed; later reads then yield zeroes.
+class BinaryReader {
+  const uint8_t* pos_;
+  const uint8_t* end_;
+  bool ok_ = true;
+
+public:
+  using is_saving = std::false_type;
+  using is_loading = std::true_type;
+
+  BinaryReader(const void* data, std::size_t size)
+    : pos_(static_cast<const uint8_t*>(data)), end_(pos_ + size) {}
+
+  template <typename T>
+  BinaryReader& operator&(T& value) {
+    read(value);
+    return *this;
+  }
+
+  template <typename T>
+  BinaryReader& operator>>(T& value) {
+    read(value);
+    return *this;
+  }
+
+  // True if every read so far was within the buffer.
+  bool ok() const { return ok_; }
+
+  std::size_t remaining() const { return end_ - pos_; }
+
+  // Where the next read starts, for reading the rest of the buffer in another format.
+  const uint8_t* position() const { return pos_; }
+
+private:
+  bool take(std::size_t n) {
+    if (!ok_ || remaining() < n) {
+      ok_ = false;
+      return false;
+    }
+    return true;
+  }
+
+  uint32_t readCount() {
+    uint32_t count = 0;
+    read(count);
+    // Every element takes at least one byte, so larger counts can only come from a corrupt message.
+    if (count > remaining()) {
+      ok_ = false;
+      return 0;
+    }
+    return count;
+  }
+
+  template <typename T>
+  void read(T& value) {
+    if constexpr (std::is_same_v<T, bool>) {
+      uint8_t byte = 0;
+      read(byte);
+      value = byte != 0;
+    } else if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+      RawBits<T> bits = 0;
+      if (take(sizeof(T))) {
+        bits = loadLE<RawBits<T>>(pos_);
+        pos_ += sizeof(T);
+      }
+      std::memcpy(&value, &bits, sizeof(T));
+    } else if constexpr (IsVector<T>::value) {
+      uint32_t count = readCount();
+      value.resize(count);
+      for (auto& element : value)
+        read(element);
+    } else if constexpr (IsMap<T>::value) {
+      uint32_t count = readCount();
+      value.clear();
+      for (uint32_t i = 0; i < count && ok_; i++) {
+        typename T::key_type key;
+        typename T::mapped_type mapped;
+        read(key);
+        read(mapped);
+        value.insert_or_assign(std::move(key), std::move(mapped));
+      }
+    } else {
+      value.serialize(*this, 0);
+    }
+  }
+};
+
+#endif
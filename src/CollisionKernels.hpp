@@ -0,0 +1,215 @@
+#ifndef COLLISION_KERNELS_H
+#define COLLISION_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Utils.hpp"
+
+#if defined(__x86_64__)
+#define SHOOTY_X86 1
+#include <immintrin.h>
+#endif
+
+// Batch versions of the collision tests, working on a block of bullet positions stored as
+// separate x and y arrays. Each kernel writes 1 to out[i] if bullet i passes the test and 0
+// otherwise. There is a scalar, an SSE2 and an AVX2 version of each kernel; the fastest one
+// supported by the CPU is picked at runtime. All versions give exactly the same results as
+// collidesRect() and as testing x < 0 || x > width || y < 0 || y > height against the world's
+// width and height.
+
+// Bullets of size w x h at (xs[i], ys[i]) that overlap rect.
+using HitMaskKernel = void (*)(Rect rect, int w, int h, const int32_t* xs, const int32_t* ys,
+                               std::size_t n, uint8_t* out);
+// Bullets at (xs[i], ys[i]) outside the area from (0, 0) to (width, height), edges included.
+using OutsideMaskKernel = void (*)(int width, int height, const int32_t* xs, const int32_t* ys,
+                                   std::size_t n, uint8_t* out);
+
+void hitMaskScalar(Rect rect, int w, int h, const int32_t* xs, const int32_t* ys,
+                   std::size_t n, uint8_t* out) {
+  for (std::size_t i = 0; i < n; i++)
+    out[i] = collidesRect({xs[i], ys[i], w, h}, rect);
+}
+
+void outsideMaskScalar(int width, int height, const int32_t* xs, const int32_t* ys,
+                       std::size_t n, uint8_t* out) {
+  for (std::size_t i = 0; i < n; i++)
+    out[i] = xs[i] < 0 || xs[i] > width || ys[i] < 0 || ys[i] > height;
+}
+
+#ifdef SHOOTY_X86
+
+// Write the low `count` bits of bits to out as bytes.
+void storeMaskBits(int bits, std::size_t count, uint8_t* out) {
+  for (std::size_t k = 0; k < count; k++)
+    out[k] = (bits >> k) & 1;
+}
+
+// Narrow four vectors of 32-bit lane masks (all ones or all zeros) to 16 bytes of 0 or 1.
+void storeMask16SSE2(__m128i m0, __m128i m1, __m128i m2, __m128i m3, uint8_t* out) {
+  __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(m0, m1), _mm_packs_epi32(m2, m3));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_and_si128(bytes, _mm_set1_epi8(1)));
+}
+
+// Same comparisons as collidesRect() with the bullet as r1 and rect as r2, negated:
+// overlap if right_r1 > left_r2, right_r2 > left_r1, bottom_r1 > top_r2 and bottom_r2 > top_r1.
+struct HitTestSSE2 {
+  __m128i left2, right2, top2, bottom2, w, h;
+
+  HitTestSSE2(Rect rect, int bulletW, int bulletH)
+    : left2(_mm_set1_epi32(rect.x)), right2(_mm_set1_epi32(rect.x + rect.w)),
+      top2(_mm_set1_epi32(rect.y)), bottom2(_mm_set1_epi32(rect.y + rect.h)),
+      w(_mm_set1_epi32(bulletW)), h(_mm_set1_epi32(bulletH)) {}
+
+  __m128i operator()(const int32_t* xs, const int32_t* ys) const {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(xs));
+    __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ys));
+    return _mm_and_si128(
+        _mm_and_si128(_mm_cmpgt_epi32(_mm_add_epi32(x, w), left2), _mm_cmpgt_epi32(right2, x)),
+        _mm_and_si128(_mm_cmpgt_epi32(_mm_add_epi32(y, h), top2), _mm_cmpgt_epi32(bottom2, y)));
+  }
+};
+
+struct OutsideTestSSE2 {
+  __m128i zero, width, height;
+
+  OutsideTestSSE2(int w, int h)
+    : zero(_mm_setzero_si128()), width(_mm_set1_epi32(w)), height(_mm_set1_epi32(h)) {}
+
+  __m128i operator()(const int32_t* xs, const int32_t* ys) const {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(xs));
+    __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ys));
+    return _mm_or_si128(
+        _mm_or_si128(_mm_cmplt_epi32(x, zero), _mm_cmpgt_epi32(x, width)),
+        _mm_or_si128(_mm_cmplt_epi32(y, zero), _mm_cmpgt_epi32(y, height)));
+  }
+};
+
+// Run a four lane test over a block, 16 bullets at a time while possible.
+// Returns the number of bullets done; the rest is left to the caller.
+template <typename Test>
+std::size_t runSSE2(const Test& test, const int32_t* xs, const int32_t* ys, std::size_t n, uint8_t* out) {
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    storeMask16SSE2(test(xs + i, ys + i), test(xs + i + 4, ys + i + 4),
+                    test(xs + i + 8, ys + i + 8), test(xs + i + 12, ys + i + 12), out + i);
+  }
+  for (; i + 4 <= n; i += 4)
+    storeMaskBits(_mm_movemask_ps(_mm_castsi128_ps(test(xs + i, ys + i))), 4, out + i);
+  return i;
+}
+
+void hitMaskSSE2(Rect rect, int w, int h, const int32_t* xs, const int32_t* ys,
+                 std::size_t n, uint8_t* out) {
+  std::size_t i = runSSE2(HitTestSSE2(rect, w, h), xs, ys, n, out);
+  hitMaskScalar(rect, w, h, xs + i, ys + i, n - i, out + i);
+}
+
+void outsideMaskSSE2(int width, int height, const int32_t* xs, const int32_t* ys,
+                     std::size_t n, uint8_t* out) {
+  std::size_t i = runSSE2(OutsideTestSSE2(width, height), xs, ys, n, out);
+  outsideMaskScalar(width, height, xs + i, ys + i, n - i, out + i);
+}
+
+// The AVX2 versions test eight bullets per vector, 32 per iteration. Everything that uses AVX2
+// instructions is marked with the avx2 target so the rest of the program can run on any x86-64 CPU.
+__attribute__((target("avx2")))
+void storeMask32AVX2(__m256i m0, __m256i m1, __m256i m2, __m256i m3, uint8_t* out) {
+  // The packs work within 128-bit lanes, which leaves the bytes in the order
+  // 0-3, 8-11, 16-19, 24-27, 4-7, 12-15, 20-23, 28-31 in units of four; the permutation restores it.
+  __m256i bytes = _mm256_packs_epi16(_mm256_packs_epi32(m0, m1), _mm256_packs_epi32(m2, m3));
+  bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_and_si256(bytes, _mm256_set1_epi8(1)));
+}
+
+struct HitTestAVX2 {
+  __m256i left2, right2, top2, bottom2, w, h;
+
+  __attribute__((target("avx2")))
+  HitTestAVX2(Rect rect, int bulletW, int bulletH)
+    : left2(_mm256_set1_epi32(rect.x)), right2(_mm256_set1_epi32(rect.x + rect.w)),
+      top2(_mm256_set1_epi32(rect.y)), bottom2(_mm256_set1_epi32(rect.y + rect.h)),
+      w(_mm256_set1_epi32(bulletW)), h(_mm256_set1_epi32(bulletH)) {}
+
+  __attribute__((target("avx2")))
+  __m256i operator()(const int32_t* xs, const int32_t* ys) const {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ys));
+    return _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_add_epi32(x, w), left2), _mm256_cmpgt_epi32(right2, x)),
+        _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_add_epi32(y, h), top2), _mm256_cmpgt_epi32(bottom2, y)));
+  }
+};
+
+struct OutsideTestAVX2 {
+  __m256i zero, width, height;
+
+  __attribute__((target("avx2")))
+  OutsideTestAVX2(int w, int h)
+    : zero(_mm256_setzero_si256()), width(_mm256_set1_epi32(w)), height(_mm256_set1_epi32(h)) {}
+
+  __attribute__((target("avx2")))
+  __m256i operator()(const int32_t* xs, const int32_t* ys) const {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs));
+    __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ys));
+    return _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpgt_epi32(zero, x), _mm256_cmpgt_epi32(x, width)),
+        _mm256_or_si256(_mm256_cmpgt_epi32(zero, y), _mm256_cmpgt_epi32(y, height)));
+  }
+};
+
+template <typename Test>
+__attribute__((target("avx2")))
+std::size_t runAVX2(const Test& test, const int32_t* xs, const int32_t* ys, std::size_t n, uint8_t* out) {
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    storeMask32AVX2(test(xs + i, ys + i), test(xs + i + 8, ys + i + 8),
+                    test(xs + i + 16, ys + i + 16), test(xs + i + 24, ys + i + 24), out + i);
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+void hitMaskAVX2(Rect rect, int w, int h, const int32_t* xs, const int32_t* ys,
+                 std::size_t n, uint8_t* out) {
+  std::size_t i = runAVX2(HitTestAVX2(rect, w, h), xs, ys, n, out);
+  hitMaskSSE2(rect, w, h, xs + i, ys + i, n - i, out + i);
+}
+
+__attribute__((target("avx2")))
+void outsideMaskAVX2(int width, int height, const int32_t* xs, const int32_t* ys,
+                     std::size_t n, uint8_t* out) {
+  std::size_t i = runAVX2(OutsideTestAVX2(width, height), xs, ys, n, out);
+  outsideMaskSSE2(width, height, xs + i, ys + i, n - i, out + i);
+}
+
+#endif
+
+// The kernels used by the game, chosen once for the CPU the program runs on.
+struct CollisionKernels {
+  HitMaskKernel hitMask = hitMaskScalar;
+  OutsideMaskKernel outsideMask = outsideMaskScalar;
+  const char* name = "scalar";
+
+  CollisionKernels() {
+#ifdef SHOOTY_X86
+    // SSE2 is part of x86-64, so only AVX2 has to be checked for.
+    hitMask = hitMaskSSE2;
+    outsideMask = outsideMaskSSE2;
+    name = "sse2";
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      hitMask = hitMaskAVX2;
+      outsideMask = outsideMaskAVX2;
+      name = "avx2";
+    }
+#endif
+  }
+};
+
+const CollisionKernels& collisionKernels() {
+  static const CollisionKernels kernels;
+  return kernels;
+}
+
+#endif
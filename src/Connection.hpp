@@ -3,40 +3,75 @@
 
 #include "asio.hpp"
 #include <iostream>
-#include <queue>
+#include <atomic>
+#include <deque>
+#include <array>
 #include "Game.hpp"
 #include "Message.hpp"
 #include "OwnedMessage.hpp"
 #include "ConnectionOwner.hpp"
-#include "TSQueue.hpp"
+#include "MPSCQueue.hpp"
+#include "ClientMessage.hpp"
+#include "GameMessage.hpp"
+#include "Stats.hpp"
+#include "WakeSignal.hpp"
+
+// Most frames a connection holds waiting to be sent. Messages that need not arrive, like
+// snapshots, replace each other while they wait (see Connection::write()), so only the
+// messages that must arrive can pile up; a peer that lets this many wait is disconnected.
+const std::size_t SEND_QUEUE_LIMIT = 64;
 
 // Class representing a connection between two peers.
 // The type of respectively incoming and outgoing messages are allowed to be different.
+// The io context may be run by several threads. All of a connection's handlers run on its
+// strand, so they never run concurrently and the members below need no locking.
 template <typename InMsgType, typename OutMsgType>
 class Connection : public std::enable_shared_from_this<Connection<InMsgType, OutMsgType>> {
-  asio::io_context& ioContext_;
+  asio::strand<asio::io_context::executor_type> strand_;
+  // The socket's handlers run on the strand by default.
   asio::ip::tcp::socket socket_;
+  // False once the connection is closed. Read by other threads than the strand's.
+  std::atomic<bool> open_{false};
 
   ConnectionOwner owner_;
   uint32_t id_;
-  TSQueue<OwnedMessage<InMsgType>>& incomingMsgs_;
-  TSQueue<Message<OutMsgType>> outgoingMsgs_;
+  MPSCQueue<OwnedMessage<InMsgType>>& incomingMsgs_;
+  // Frames waiting to be sent, oldest first. Only used on the strand.
+  std::deque<FramePtr<OutMsgType>> outgoingMsgs_;
+  // Counters of the queue, written on the strand and read by other threads.
+  std::atomic<std::size_t> depth_{0};
+  std::atomic<std::size_t> maxDepth_{0};
+  std::atomic<std::size_t> queuedBytes_{0};
+  std::atomic<uint64_t> sent_{0};
+  std::atomic<uint64_t> replaced_{0};
+  // Traffic of the server the connection belongs to, if counted.
+  TrafficCounters* traffic_;
+  // Notified after each message added to incomingMsgs_, if given.
+  WakeSignal* received_;
   Message<InMsgType> tempInMsg_;
+  // Wire encoding of the header being read.
+  std::array<uint8_t, Header<InMsgType>::wireSize> tempInHeader_;
 
 public:
-  // A connection needs a context to work in, an incoming message queue and an owner.
+  // A connection needs a context to work in, an incoming message queue and an owner, and may
+  // add the bytes and messages it reads and writes to the given counters and wake the thread
+  // that takes the messages out of the queue.
   Connection(asio::io_context& ioContext,
-             TSQueue<OwnedMessage<InMsgType>>& incomingMsgs, ConnectionOwner owner)
-    : ioContext_(ioContext),
-      socket_(ioContext),
+             MPSCQueue<OwnedMessage<InMsgType>>& incomingMsgs, ConnectionOwner owner,
+             TrafficCounters* traffic = nullptr, WakeSignal* received = nullptr)
+    : strand_(asio::make_strand(ioContext)),
+      socket_(strand_),
       incomingMsgs_(incomingMsgs),
-      owner_(owner)
+      owner_(owner),
+      traffic_(traffic),
+      received_(received)
     {}
 
   // Connects a client to the server.
   void connectToServer(const asio::ip::tcp::resolver::results_type& endpoints)
   {
     if (owner_ == ConnectionOwner::Client) {
+      open_ = true;
       asio::async_connect(socket_, endpoints,
                           [this] (const asio::error_code& ec, asio::ip::tcp::endpoint /* endpoint */)
                           {
@@ -57,6 +92,7 @@ public:
   void connectToClient(uint32_t id) {
     if (owner_ == ConnectionOwner::Server) {
       id_ = id;
+      open_ = true;
       readHeader();
     }
   }
@@ -68,24 +104,43 @@ public:
 
   // Write a message to the other peer.
   void write(Message<OutMsgType> msg) {
+    write(makeFrame(std::move(msg)));
+  }
+
+  // Write an encoded message to the other peer. Only the pointer is copied, so the same frame
+  // can be written to many connections.
+  // A message that need not arrive (see isReliable()) replaces the one of the same kind that
+  // is still waiting to be sent, if any, so a peer that reads slower than it is written to
+  // gets the latest snapshot when it catches up rather than every snapshot it missed, and its
+  // queue does not grow. Messages that must arrive are all kept, up to SEND_QUEUE_LIMIT.
+  void write(FramePtr<OutMsgType> frame) {
     auto self(this->shared_from_this());
-  asio::post(ioContext_, [this, self, msg]() {
-                              bool writeInProgress = !outgoingMsgs_.empty();
-                              outgoingMsgs_.push(msg);
-                              if (!writeInProgress)
-                                writeHeader();
+    asio::post(strand_, [this, self, frame = std::move(frame)]() mutable {
+                              enqueue(std::move(frame));
                             });
   }
 
   uint32_t getID() { return id_; }
 
-  bool isConnected() { return socket_.is_open(); }
+  // Counters of the send queue. May be called from any thread.
+  SendQueueStats sendQueueStats() const {
+    SendQueueStats stats;
+    stats.depth = depth_;
+    stats.maxDepth = maxDepth_;
+    stats.bytes = queuedBytes_;
+    stats.sent = sent_;
+    stats.replaced = replaced_;
+    return stats;
+  }
+
+  bool isConnected() { return open_; }
 
   // Close the connection.
   void disconnect() {
     std::cout << "Disconnecting connection with ID " << id_ << "\n";
+    open_ = false;
     auto self(this->shared_from_this());
-    asio::post(ioContext_, [this, self]() { socket_.close(); });
+    asio::post(strand_, [this, self]() { socket_.close(); });
   }
 
 private:
@@ -96,9 +151,10 @@ private:
     // after the callback handler is called but before it is finished.
     auto self(this->shared_from_this());
     asio::async_read(socket_,
-                     asio::buffer(&tempInMsg_.header, sizeof(Header<InMsgType>)),
+                     asio::buffer(tempInHeader_),
                      [this, self](const asio::error_code & ec, std::size_t /* bytes_transferred */ ) {
                                      if (!ec) {
+                                       tempInMsg_.header.decode(tempInHeader_.data());
                                        tempInMsg_.body.resize(tempInMsg_.header.size);
                                        readBody();
                                      } else {
@@ -115,6 +171,10 @@ private:
                      socket_, asio::buffer(tempInMsg_.body.data(), tempInMsg_.header.size),
                      [this, self](const asio::error_code& ec, std::size_t bytes_transferred) {
                        if (!ec) {
+                         if (traffic_) {
+                           traffic_->bytesIn.add(tempInHeader_.size() + bytes_transferred);
+                           traffic_->messagesIn.add();
+                         }
                          addToIncomingMsgs(tempInMsg_);
                          // Start another asynchronous read.
                          readHeader();
@@ -126,44 +186,77 @@ private:
   }
 
   // Add a read message to the incoming message queue.
+  // If the queue is full the message is dropped rather than stalling the io thread;
+  // the queue counts how many messages were dropped.
   void addToIncomingMsgs(Message<InMsgType> msg) {
     if (owner_ == ConnectionOwner::Server) {
-      incomingMsgs_.push({id_, msg});
+      incomingMsgs_.push({id_, std::move(msg)});
     } else {
-      incomingMsgs_.push({0, msg});
+      incomingMsgs_.push({0, std::move(msg)});
     }
+    if (received_ != nullptr)
+      received_->notify();
   }
 
-  // Send a message, starting with the header.
-  void writeHeader() {
-    auto self(this->shared_from_this());
-    asio::async_write(
-                      socket_, asio::buffer(&outgoingMsgs_.front().header,
-                                            sizeof(Header<InMsgType>)),
-                      [this, self](const asio::error_code& ec, std::size_t bytes_transferred) {
-                        if (!ec) {
-                          writeBody();
-                        } else {
-                          std::cout << "writeHeader(): " << ec.message() << "\n";
-                          disconnect();
-                        }
-                      });
+  // Add a frame to the queue, on the strand, and start writing it if nothing is being written.
+  // Frames written to a closed connection are dropped.
+  void enqueue(FramePtr<OutMsgType> frame) {
+    if (!open_)
+      return;
+    bool writeInProgress = !outgoingMsgs_.empty();
+    if (!isReliable(frame->header().messageId)) {
+      // The frame at the front is being written, so it has to be sent whole. Behind it, there
+      // is at most one frame that need not arrive, since each replaces the one before.
+      for (auto it = outgoingMsgs_.begin() + (writeInProgress ? 1 : 0); it != outgoingMsgs_.end(); ++it) {
+        if (!isReliable((*it)->header().messageId)) {
+          queuedBytes_ -= wireSize(**it);
+          outgoingMsgs_.erase(it);
+          replaced_++;
+          break;
+        }
+      }
+    }
+    if (outgoingMsgs_.size() >= SEND_QUEUE_LIMIT) {
+      std::cout << "Send queue of connection with ID " << id_ << " is full\n";
+      disconnect();
+      return;
+    }
+    queuedBytes_ += wireSize(*frame);
+    outgoingMsgs_.push_back(std::move(frame));
+    depth_ = outgoingMsgs_.size();
+    if (depth_ > maxDepth_)
+      maxDepth_ = depth_.load();
+    if (!writeInProgress)
+      writeFrame();
+  }
+
+  static std::size_t wireSize(const Frame<OutMsgType>& frame) {
+    return frame.wireHeader().size() + frame.body().size();
   }
 
-  // Send the message body.
-  void writeBody() {
+  // Send the frame at the front of the queue, header and body in one gathered write.
+  void writeFrame() {
     auto self(this->shared_from_this());
+    const Frame<OutMsgType>& frame = *outgoingMsgs_.front();
+    std::array<asio::const_buffer, 2> buffers = {asio::buffer(frame.wireHeader()),
+                                                 asio::buffer(frame.body())};
     asio::async_write(
-                      socket_, asio::buffer(outgoingMsgs_.front().body.data(),
-                                            outgoingMsgs_.front().header.size),
+                      socket_, buffers,
                       [this, self](const asio::error_code& ec, std::size_t bytes_transferred) {
                         if (!ec) {
-                          outgoingMsgs_.pop();
+                          if (traffic_) {
+                            traffic_->bytesOut.add(bytes_transferred);
+                            traffic_->messagesOut.add();
+                          }
+                          queuedBytes_ -= wireSize(*outgoingMsgs_.front());
+                          outgoingMsgs_.pop_front();
+                          depth_ = outgoingMsgs_.size();
+                          sent_++;
                           if (!outgoingMsgs_.empty()) {
-                            writeHeader();
+                            writeFrame();
                           }
                         } else {
-                          std::cout << "writeBody(): " << ec.message() << "\n";
+                          std::cout << "writeFrame(): " << ec.message() << "\n";
                           disconnect();
                         }
                       });
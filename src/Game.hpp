@@ -3,31 +3,110 @@
 
 #include <iostream>
 #include <vector>
+#include <algorithm>
 
 #include "Player.hpp"
+#include "PlayerInput.hpp"
 #include "Bullet.hpp"
+#include "BulletPool.hpp"
 #include "Utils.hpp"
-#include <chrono>
+#include "SpatialGrid.hpp"
+#include "CollisionKernels.hpp"
 #include <map>
 #include <boost/serialization/map.hpp>
 
-bool isOutsideScreen(Bullet bullet);
-bool collides(Bullet b, Player p);
+// Side of the cells of the grid used for finding which bullets may hit a player.
+const int COLLISION_CELL_SIZE = 64;
+
+// Time a player has to wait between two shots. It is counted in ticks of the game rather than
+// wall-clock time, so that a game fed the same inputs fires the same bullets however fast it
+// runs, as it does when replayed (see Replay.hpp).
+const uint32_t FIRE_COOLDOWN_MS = 250;
+
+// The cooldown in ticks of a game ticking ticksPerSecond times a second, rounded up.
+uint32_t fireCooldownTicks(uint32_t ticksPerSecond) {
+  return (FIRE_COOLDOWN_MS * ticksPerSecond + 999) / 1000;
+}
 
 // The Game class keeps track of the game state.
 class Game {
   std::map<uint32_t, Player> players_;
-  std::map<uint32_t, std::chrono::time_point<std::chrono::system_clock>> lastBulletTimes_;
+  // Bullets of all players.
+  BulletPool bullets_;
+  // Tick at which each player last fired.
+  std::map<uint32_t, uint32_t> lastFireTicks_;
+  // ID to give the next bullet fired.
+  uint32_t nextBulletId_ = 0;
+  // Number of times the game has been advanced.
+  uint32_t tick_ = 0;
+  WorldSize world_;
+  // Times the game is advanced a second, which tells how far things move each tick. It is not
+  // sent with the state; clients are told it when they connect.
+  uint32_t ticksPerSecond_;
+
+  // Broadphase for bullet collisions, rebuilt every tick from the bullets' rectangles.
+  // It is only made to the size of the world when the game is first advanced, since most
+  // copies of a game, like the snapshots, are never advanced.
+  SpatialGrid grid_{0, 0, COLLISION_CELL_SIZE};
+  // Indices and positions of the bullets that may hit the player being tested, packed for
+  // the batch collision kernels, and the kernels' results.
+  std::vector<uint32_t> candidates_;
+  std::vector<int32_t> candidateXs_;
+  std::vector<int32_t> candidateYs_;
+  std::vector<uint8_t> candidateHits_;
+  // Whether each bullet has hit a player or left the screen this tick.
+  std::vector<uint8_t> bulletHits_;
+  std::vector<uint8_t> bulletsOutside_;
+  // IDs of the players hit this tick.
+  std::vector<uint32_t> playersToDelete_;
+
+  friend class GameDelta;
+  friend class SnapshotInterpolator;
+  friend class AreaOfInterest;
+  friend class SnapshotCodec;
 public:
 
   // For (de)serialization.
   friend class boost::serialization::access;
   template<class Archive>
   void serialize(Archive& ar, const unsigned int version) {
+    ar & tick_;
+    ar & world_;
     ar & players_;
+    bullets_.serializeSpawns(ar, tick_, ticksPerSecond_);
   }
   
-  Game() { }
+  explicit Game(WorldSize world = DEFAULT_WORLD_SIZE, uint32_t ticksPerSecond = FRAMES_PER_SECOND)
+    : world_(world), ticksPerSecond_(ticksPerSecond) { }
+
+  // Make this game a copy of another without the working storage of advance(), for keeping
+  // snapshots. The storage this game already holds is reused, so a copy that has grown to the
+  // size of the game it is kept from does not allocate again.
+  void copyState(const Game& other) {
+    players_ = other.players_;
+    bullets_.copyFrom(other.bullets_);
+    lastFireTicks_ = other.lastFireTicks_;
+    nextBulletId_ = other.nextBulletId_;
+    tick_ = other.tick_;
+    world_ = other.world_;
+    ticksPerSecond_ = other.ticksPerSecond_;
+  }
+
+  uint32_t getTick() const {
+    return tick_;
+  }
+
+  const WorldSize& getWorldSize() const {
+    return world_;
+  }
+
+  uint32_t getTicksPerSecond() const {
+    return ticksPerSecond_;
+  }
+
+  void setTicksPerSecond(uint32_t ticksPerSecond) {
+    ticksPerSecond_ = ticksPerSecond;
+  }
 
   int getNumPlayers() {
     return players_.size();
@@ -36,146 +115,231 @@ public:
   // Synchronize players with connections if either a player has disconnected
   // or a player has connected. Dead players are handled in the advance() function.
   void syncPlayers(std::vector<uint32_t> ids) {
-    // If player has connected
-    if (players_.size() < ids.size()) {
-      addPlayer(ids[ids.size() - 1]); // Add a player with the connection's ID
-      // If player has disconnected
-    } else if (players_.size() > ids.size()) {
-      // Remove players with no corresponding active connection
-      for (auto& [id, _] : players_) {
-        if (std::find(ids.begin(), ids.end(), id) == ids.end()) {
-          removePlayer(id);
-          break;
-        }
-      }
+    // Add a player for each connection that has none
+    for (uint32_t id : ids) {
+      if (players_.find(id) == players_.end())
+        addPlayer(id);
+    }
+    // Remove players with no corresponding active connection
+    for (auto it = players_.begin(); it != players_.end();) {
+      uint32_t id = it->first;
+      ++it;
+      if (std::find(ids.begin(), ids.end(), id) == ids.end())
+        removePlayer(id);
     }
   }
 
   void addPlayer(uint32_t id) {
     //std::cout << "Adding player with ID " << id << "\n";
-    Player player(100, 100, id);
-    players_.insert({id, player});
+    addPlayer(Player(100, 100, id));
+  }
+
+  // Add a player, which joins the game at the current tick.
+  void addPlayer(const Player& player) {
+    auto [it, added] = players_.insert({player.getID(), player});
+    if (added)
+      it->second.joinTick_ = tick_;
   }
 
+  // Whether the player who fired a bullet at the given tick is still in the game.
+  bool hasShooter(uint32_t ownerId, uint32_t firedTick) const {
+    auto found = players_.find(ownerId);
+    return found != players_.end() && found->second.joinTick_ <= firedTick;
+  }
+
+  // Replace the player with the same ID. Returns false if there is no such player.
+  bool updatePlayer(const Player& player) {
+    auto found = players_.find(player.getID());
+    if (found == players_.end())
+      return false;
+    found->second = player;
+    return true;
+  }
+
+  // Remove a player along with the player's bullets and when the player last fired.
   void removePlayer(uint32_t id) {
     //std::cout << "Removing player with ID " << id << "\n";
     auto found = players_.find(id);
     if (found != players_.end()) {
         players_.erase(found);
+        lastFireTicks_.erase(id);
+        bullets_.removeOwnedBy(id);
       }
   }
 
-  const std::map<uint32_t, Player>& getPlayers() {
+  // Add a bullet fired by the player with the given ID at the current tick. Its angle is put on
+  // the grid angles are sent with, so that clients see it fly exactly as it does here. Returns
+  // false if there is no room for it.
+  bool addBullet(uint32_t ownerId, const Bullet& bullet) {
+    BulletSpawn spawn{bullet.getID(), ownerId, bullet.getPos(), quantizeAngle(bullet.getAngle()), tick_};
+    return bullets_.add(spawn, tick_, ticksPerSecond_);
+  }
+
+  const std::map<uint32_t, Player>& getPlayers() const {
     return players_;
   }
 
-  // Perform player action on player with matching ID
+  const BulletPool& getBullets() const {
+    return bullets_;
+  }
+
+  // Perform player action on player with matching ID, for the tick the game is about to be
+  // advanced to.
   bool performAction(uint32_t id, PlayerAction playerAction) {
     auto found = players_.find(id);
     if (found != players_.end()) {
       Player& p = found->second;
+      int distance = stepOnTick(PLAYER_SPEED, ticksPerSecond_, tick_ + 1);
+      int turn = stepOnTick(PLAYER_TURN_SPEED, ticksPerSecond_, tick_ + 1);
       switch (playerAction) {
       case PlayerAction::Up:
-        p.moveUp();
+        p.moveUp(distance);
         break;
 
       case PlayerAction::Down:
-        p.moveDown();
+        p.moveDown(distance, world_);
         break;
         
       case PlayerAction::Left:
-        p.moveLeft();        
+        p.moveLeft(distance);        
         break;
         
       case PlayerAction::Right:
-        p.moveRight();
+        p.moveRight(distance, world_);
         break;
         
       case PlayerAction::FireBullet:
         {
-          // Find time when last bullet was fired
-          auto foundTime = lastBulletTimes_.find(id);
-          if (foundTime != lastBulletTimes_.end()) { // If found
-            auto start = foundTime->second;
-            auto end = std::chrono::system_clock::now();
-            // Check if last bullet was fired at least 250 ms ago
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(end - start) >= std::chrono::milliseconds(250)) {
-              lastBulletTimes_.insert_or_assign(id, end);
-              p.fire();
-            }
-          } else { // First bullet fired, add time to map
-            lastBulletTimes_.insert({id, std::chrono::system_clock::now()});
-            p.fire();
+          // Fire if the player has not fired yet or fired at least FIRE_COOLDOWN_MS ago, and
+          // there is room for the bullet; a shot that is dropped does not start the cooldown.
+          auto foundTick = lastFireTicks_.find(id);
+          if ((foundTick == lastFireTicks_.end() ||
+               tick_ - foundTick->second >= fireCooldownTicks(ticksPerSecond_)) &&
+              !bullets_.full()) {
+            lastFireTicks_.insert_or_assign(id, tick_);
+            addBullet(id, p.fire(nextBulletId_++));
           }
         }
         break;
         
       case PlayerAction::RotateLeft:
-        p.rotateLeft();
+        p.rotateLeft(turn);
         break;
         
       case PlayerAction::RotateRight:
-        p.rotateRight();
+        p.rotateRight(turn);
         break;
       }
       return true;
     }
     return false;
   }
+
+  // Perform every action of a player's input for one tick. Returns false if there is no
+  // player with the given ID.
+  bool applyInput(uint32_t id, const PlayerInput& input) {
+    auto found = players_.find(id);
+    if (found == players_.end())
+      return false;
+    found->second.applyInput(input, world_, ticksPerSecond_);
+    if (input.has(PlayerAction::FireBullet))
+      performAction(id, PlayerAction::FireBullet);
+    return true;
+  }
   
-  // Advance to the next game state.
-  std::vector<uint32_t> advance() {
-    // Check each player's bullets to see if they collide with another player.
+  // Advance to the next game state. Returns the IDs of the players that were hit, which are
+  // valid until the game is advanced again.
+  const std::vector<uint32_t>& advance() {
+    // Check each bullet to see if it collides with a player other than the one who fired it.
     // If so, remove both the bullet and the player hit.
     // Move remaining bullets.
-    std::vector<uint32_t> playersToDelete;
-    for (auto& [_, player] : players_) {
-      std::vector<Bullet>& bullets = player.getBullets();
-      std::vector<Bullet> bulletsToDelete;
-      for (Bullet& b : bullets) {
-        bool bulletDeleted = false;
-        for (auto [_, p] : players_) {
-          // Check if current player's bullets collides with another player.
-          if (player.getID() != p.getID() && collides(b, p)) {
-            playersToDelete.push_back(p.getID());
-            bulletsToDelete.push_back(b);
-            bulletDeleted = true;
-          }
-          // Check if bullet is outside screen.
-          else if (isOutsideScreen(b)) {
-            bulletsToDelete.push_back(b);
-            bulletDeleted = true;
+    // Each player is only tested against the bullets sharing a grid cell with it, which are
+    // packed into contiguous arrays and tested in one batch.
+    const CollisionKernels& kernels = collisionKernels();
+    std::size_t numBullets = bullets_.size();
+    const int32_t* xs = bullets_.xs();
+    const int32_t* ys = bullets_.ys();
+    const uint32_t* owners = bullets_.owners();
+    // Bullets are put in the grid as points at their top left corner, so each is in exactly one
+    // cell. A bullet can then only hit a player if the corner is within the player's rectangle
+    // grown by the size of a bullet to the left and top.
+    // The working storage is made large enough for a full pool of bullets at the same time,
+    // so that advancing does not allocate however the number of bullets changes.
+    if (!grid_.covers(world_.width, world_.height)) {
+      grid_ = SpatialGrid(world_.width, world_.height, COLLISION_CELL_SIZE);
+      grid_.reserve(BULLET_POOL_CAPACITY);
+      candidates_.reserve(BULLET_POOL_CAPACITY);
+      candidateXs_.reserve(BULLET_POOL_CAPACITY);
+      candidateYs_.reserve(BULLET_POOL_CAPACITY);
+      candidateHits_.reserve(BULLET_POOL_CAPACITY);
+      bulletHits_.reserve(BULLET_POOL_CAPACITY);
+      bulletsOutside_.reserve(BULLET_POOL_CAPACITY);
+    }
+    grid_.build(numBullets, [&](uint32_t i) -> Rect { return {xs[i], ys[i], 1, 1}; });
+
+    playersToDelete_.clear();
+    bulletHits_.assign(numBullets, 0);
+    for (auto& [id, p] : players_) {
+      Rect playerRect = {p.getPos().x, p.getPos().y, PLAYER_SIDE, PLAYER_SIDE};
+      Rect reach = {playerRect.x - BULLET_SIDE + 1, playerRect.y - BULLET_SIDE + 1,
+                        PLAYER_SIDE + BULLET_SIDE - 1, PLAYER_SIDE + BULLET_SIDE - 1};
+      candidates_.clear();
+      candidateXs_.clear();
+      candidateYs_.clear();
+      grid_.query(reach, [&](uint32_t i) {
+          if (owners[i] != id) {
+            candidates_.push_back(i);
+            candidateXs_.push_back(xs[i]);
+            candidateYs_.push_back(ys[i]);
           }
+        });
+      candidateHits_.resize(candidates_.size());
+      kernels.hitMask(playerRect, BULLET_SIDE, BULLET_SIDE, candidateXs_.data(), candidateYs_.data(),
+                      candidates_.size(), candidateHits_.data());
+      bool hit = false;
+      for (std::size_t c = 0; c < candidates_.size(); c++) {
+        if (candidateHits_[c]) {
+          bulletHits_[candidates_[c]] = 1;
+          hit = true;
         }
-        if (!bulletDeleted)
-          b.move();
       }
-      // Remove bullets that have collided with players or are out of screen.
-      for (Bullet& b : bulletsToDelete) {
-        bullets.erase(std::remove(bullets.begin(), bullets.end(), b), bullets.end());
+      if (hit)
+        playersToDelete_.push_back(id);
+    }
+    // Mark bullets that are outside the world too, and those of players that were hit.
+    bulletsOutside_.resize(numBullets);
+    kernels.outsideMask(world_.width, world_.height, xs, ys, numBullets, bulletsOutside_.data());
+    for (std::size_t i = 0; i < numBullets; i++)
+      bulletHits_[i] |= bulletsOutside_[i];
+    if (!playersToDelete_.empty()) {
+      // Players are visited in order of ID, so playersToDelete_ is sorted.
+      for (std::size_t i = 0; i < numBullets; i++)
+        bulletHits_[i] |= std::binary_search(playersToDelete_.begin(), playersToDelete_.end(), owners[i]);
+    }
+    // Remove bullets that have collided with players or are out of the world.
+    // Removal moves the last bullet into the hole, so its flag has to follow it.
+    std::size_t i = 0;
+    while (i < bullets_.size()) {
+      if (bulletHits_[i]) {
+        bulletHits_[i] = bulletHits_[bullets_.size() - 1];
+        bullets_.remove(i);
+      } else {
+        i++;
       }
     }
-    // Remove players hit by a bullet.
-    for (int id : playersToDelete) {
-      removePlayer(id);
+    tick_++;
+    bullets_.moveTo(tick_, ticksPerSecond_);
+    // Remove players hit by a bullet. Their bullets are already gone.
+    for (uint32_t id : playersToDelete_) {
+      players_.erase(id);
+      lastFireTicks_.erase(id);
     }
     
-    return playersToDelete;
+    return playersToDelete_;
   }
   
 
 };
 
-bool isOutsideScreen(Bullet bullet) {
-  int x = bullet.getPos().x;
-  int y = bullet.getPos().y;
-  return x < 0 || x > SCREEN_WIDTH || y < 0 || y > SCREEN_HEIGHT;
-}
-
-bool collides(Bullet b, Player p) {
-  return collidesRect({b.getPos().x, b.getPos().y, BULLET_SIDE, BULLET_SIDE},
-                      {p.getPos().x, p.getPos().y, PLAYER_SIDE, PLAYER_SIDE});
-}
-
 
 #endif
@@ -3,12 +3,21 @@
 
 #include "GameDrawer.hpp"
 #include "Client.hpp"
+#include "UdpClient.hpp"
 #include "Game.hpp"
 #include "Utils.hpp"
 #include "GameMessage.hpp"
+#include "ClientMessage.hpp"
+#include "Snapshot.hpp"
+#include "SnapshotDecoder.hpp"
+#include "PlayerInput.hpp"
+#include "Prediction.hpp"
+#include "Interpolation.hpp"
+#include "TickScheduler.hpp"
+#include <chrono>
 #include<iostream>
 #include <map>
-#include "TSQueue.hpp"
+#include <optional>
 
 // Key bindings.
 auto const keyUp = SDLK_w;
@@ -21,45 +30,97 @@ auto const keyRotateRight = SDLK_RIGHT;
 
 PlayerAction keyCodeToPlayerAction(SDL_Keycode keyCode);
 
-// This class handles player input, reads incoming game states from the server and tells the game drawer to draw.
+// This class handles player input, takes the game states decoded from the server's snapshots and tells the game drawer to draw.
+// Frames are drawn FRAMES_PER_SECOND times a second, while inputs are sent at the tick rate the
+// server welcomes us with, one for every tick.
+// GameClient is the client of either transport, Client or UdpClient.
+template <typename GameClient>
 class GameController {
   // Map of which keycodes are pressed down or not.
   std::map<SDL_Keycode, bool> keyMap_ =
     {{keyUp, false}, {keyDown, false}, {keyLeft, false}, {keyRight, false},
      {keyFire, false}, {keyRotateLeft, false}, {keyRotateRight, false}};
   bool quit_ = false;
-  Client<GameMessage, PlayerAction> & client_;
+  GameClient& client_;
 
   GameDrawer gameDrawer_;
+  // Rebuilds game states from the keyframes and deltas sent by the server on a thread of its
+  // own, and joins the room to play in once the server has welcomed us.
+  SnapshotDecoder<GameClient> decoder_;
+  bool welcomed_ = false;
+  // Deadlines of the ticks to send inputs for, at the server's rate, once welcomed.
+  std::optional<TickScheduler> inputClock_;
+  // Number of ticks the controller has run, and sequence number of the last input sent.
+  uint32_t tick_ = 0;
+  uint32_t inputSeq_ = 0;
+  // The local player, moved as soon as keys are pressed.
+  PlayerPrediction prediction_;
+  // The states received, for drawing the other players and the bullets smoothly.
+  SnapshotInterpolator interpolator_;
+  // Where the camera follows, the local player's position while it is alive.
+  Point cameraPos_ = {0, 0};
   
 public:
-  GameController(Client<GameMessage, PlayerAction> & client): client_(client) {}
+  GameController(GameClient& client, uint32_t room = 0): client_(client), decoder_(client, room) {}
 
   // Start the controller.
   void start() {
-    TSQueue<OwnedMessage<GameMessage>>& incomingMsgs = client_.getIncomingMsgs();
+    decoder_.start();
     while (!quit_) {
         // Break out of loop if connection to server is lost.
       if (!client_.isConnected()) {
             break;
           }
         
-      while (!incomingMsgs.empty()) {
-            Game game;
-            OwnedMessage<GameMessage> ownedMsg = incomingMsgs.pop();
-            ownedMsg.msg.getData(game);
-            gameDrawer_.drawGame(game);
-          }
+      update();
         
         SDL_Delay(1000 / FRAMES_PER_SECOND);
         handleKeyEvents();
+        sendInputs();
+        draw();
       }
+    decoder_.stop();
     if (client_.isConnected())
       client_.disconnect();
     // Terminate SDL.
     gameDrawer_.close();
   }
 
+  // Take what the decoder has for us: the ID of our player and the tick rate once welcomed,
+  // and the newest game state if one was decoded since the last frame. Never waits for the
+  // decoder.
+  void update() {
+    WelcomeInfo welcome;
+    if (!welcomed_ && decoder_.welcome(welcome)) {
+      prediction_.setPlayerID(welcome.playerId);
+      inputClock_.emplace(TickRate{welcome.ticksPerSecond, OverrunPolicy::CatchUp});
+      welcomed_ = true;
+    }
+    if (decoder_.takeLatest()) {
+      const DecodedSnapshot& snapshot = decoder_.latest();
+      prediction_.reconcile(snapshot.game);
+      interpolator_.push(snapshot.game, snapshot.arrivalMs);
+    }
+  }
+
+  // Draw the game as interpolated from the states received, with the local player where it
+  // is predicted to be, and the camera following the local player.
+  void draw() {
+    if (interpolator_.empty())
+      return;
+    Game game;
+    interpolator_.sample(nowMs(), game);
+    prediction_.overlay(game);
+    if (prediction_.alive())
+      cameraPos_ = prediction_.predicted().getPos();
+    gameDrawer_.drawGame(game, cameraView(cameraPos_, game.getWorldSize()));
+  }
+
+  static double nowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+  }
+
   // Handle key input from player.
   void handleKeyEvents() {
     SDL_Event e;
@@ -84,18 +145,38 @@ public:
           }
 
       }
+  }
 
-    // Map down-registered keys to player actions and send them to the server.
+  // Send an input for every tick that is due. An input is sent every tick, also when no key
+  // is held.
+  void sendInputs() {
+    if (!inputClock_)
+      return;
+    TickScheduler::Clock::time_point now = TickScheduler::Clock::now();
+    while (inputClock_->deadline() <= now) {
+      sendInput();
+      inputClock_->next(now);
+    }
+  }
+
+  // Map down-registered keys to player actions and send them to the server as one input.
+  void sendInput() {
+    PlayerInput input;
+    input.seq = ++inputSeq_;
+    input.tick = tick_++;
     for (auto [keyCode, isDown] : keyMap_) {
       if (isDown) {
-            Message<PlayerAction> msg;
-            msg.header.messageId = keyCodeToPlayerAction(keyCode);
+            input.set(keyCodeToPlayerAction(keyCode));
             //std::cout << playerActionToStr(keyCodeToPlayerAction(keyCode)) << "\n";
-            client_.send(msg);
           }
       }
+    prediction_.applyLocal(input);
+    Message<ClientMessage> msg;
+    msg.header.messageId = ClientMessage::Input;
+    msg.setData(input);
+    client_.send(msg);
   }
-  
+
 
 };
 
@@ -1,20 +1,48 @@
 #ifndef GAMEDRAWER_H
 #define GAMEDRAWER_H
 
+#include <iostream>
+#include <string>
+
 #include "SDL.h"
 #include "SDL_image.h"
 
+#include "Camera.hpp"
 #include "Game.hpp"
+#include "SpriteBatch.hpp"
 #include "Utils.hpp"
 
+// Transparent pixels between the sprites in the atlas, so that filtering at the edge of one
+// does not pick up the next.
+const int ATLAS_PADDING = 2;
+
+// How sprites are drawn: all of them with one call to SDL_RenderGeometry, or one call to
+// SDL_RenderCopyEx each, as renderers that cannot draw geometry need.
+enum class DrawMode { Batched, PerSprite };
+
+// What the last frame drawn took.
+struct FrameStats {
+  std::size_t sprites = 0;
+  std::size_t drawCalls = 0;
+};
+
+// Draws the game in a window. The spaceship and bullet images are packed into one texture, an
+// atlas, so that every sprite of a frame can be drawn in one batch (see SpriteBatch.hpp).
+// Sprites outside the window are not drawn.
 class GameDrawer {
   SDL_Window* window_ = nullptr;
   SDL_Renderer* renderer_ = nullptr;
   bool isInitialized_ = false;
-  SDL_Texture* spaceshipTexture_ = NULL;
-  SDL_Texture* bulletTexture_ = NULL;
+  SDL_Texture* atlas_ = NULL;
+  // Where each sprite is in the atlas, in pixels and in texture coordinates.
+  SDL_Rect spaceshipSrc_ = {0, 0, 0, 0};
+  SDL_Rect bulletSrc_ = {0, 0, 0, 0};
+  SDL_FRect spaceshipUv_ = {0, 0, 0, 0};
+  SDL_FRect bulletUv_ = {0, 0, 0, 0};
+  DrawMode mode_ = DrawMode::Batched;
+  SpriteBatch batch_;
+  FrameStats lastFrame_;
 
-  
 public:
   GameDrawer() {
     init();
@@ -22,9 +50,17 @@ public:
   }
 
   void loadTextures() {
-    spaceshipTexture_ = loadTexture("spaceship.png");
-    bulletTexture_ = loadTexture("bullet.png");
-    if(!spaceshipTexture_ || !bulletTexture_) {
+    SDL_Surface* spaceship = IMG_Load("spaceship.png");
+    SDL_Surface* bullet = IMG_Load("bullet.png");
+    if (spaceship && bullet)
+      atlas_ = makeAtlas(spaceship, bullet);
+    else
+      std::cout << "Unable to load images. SDL_image Error: " << IMG_GetError() << "\n";
+    if (spaceship)
+      SDL_FreeSurface(spaceship);
+    if (bullet)
+      SDL_FreeSurface(bullet);
+    if(!atlas_) {
       std::cout << "Failed to load textures\n";
     }
   }
@@ -32,31 +68,43 @@ public:
   bool isInit() {
     return isInitialized_;
   }
+
+  void setDrawMode(DrawMode mode) {
+    mode_ = mode;
+  }
+
+  DrawMode drawMode() const {
+    return mode_;
+  }
+
+  const FrameStats& lastFrame() const {
+    return lastFrame_;
+  }
   
-  void drawGame(Game game_) {
+  // Draw the part of the game that the camera shows. view is in world coordinates.
+  void drawGame(const Game& game, Rect view) {
     //SDL_SetRenderDrawColor(renderer_, 0x00, 0x00, 0x00, 0x00);
     SDL_SetRenderDrawColor(renderer_, 0xFF, 0xFF, 0xFF, 0xFF);
     SDL_RenderClear(renderer_);
-    
-    for (auto [_, player] : game_.getPlayers()) {
-      Point playerPos = player.getPos();
-      SDL_Rect playerRect = { playerPos.x, playerPos.y, PLAYER_SIDE, PLAYER_SIDE };
-      //SDL_RenderFillRect(renderer_, &playerRect);
-      SDL_RenderCopyEx(renderer_, spaceshipTexture_, NULL, &playerRect, player.getAngle(), NULL, SDL_FLIP_NONE);
-      for (auto bullet : player.getBullets()) {
-        Point bulletPos = bullet.getPos();
-        SDL_Rect bulletRect = { bulletPos.x, bulletPos.y, 2 * BULLET_SIDE, BULLET_SIDE};
-        //SDL_RenderFillRect(renderer_, &bulletRect);
-        //std::cout << bullet.getAngle() << "\n";
-        SDL_RenderCopyEx(renderer_, bulletTexture_, NULL, &bulletRect, bullet.getAngle(), NULL, SDL_FLIP_NONE);
-      }
+    // Outline of the world, for worlds that do not fill the window.
+    const WorldSize& world = game.getWorldSize();
+    SDL_Rect worldRect = { -view.x, -view.y, world.width, world.height };
+    SDL_SetRenderDrawColor(renderer_, 0xC0, 0xC0, 0xC0, 0xFF);
+    SDL_RenderDrawRect(renderer_, &worldRect);
+
+    lastFrame_ = FrameStats();
+    if (mode_ == DrawMode::Batched && !drawBatched(game, view)) {
+      std::cout << "The renderer cannot draw geometry, drawing sprites one by one. SDL Error: " << SDL_GetError()
+                << "\n";
+      mode_ = DrawMode::PerSprite;
     }
+    if (mode_ == DrawMode::PerSprite)
+      drawPerSprite(game, view);
     SDL_RenderPresent(renderer_);
   }
 
   void close() {
-    SDL_DestroyTexture(spaceshipTexture_);
-    SDL_DestroyTexture(bulletTexture_);
+    SDL_DestroyTexture(atlas_);
     SDL_DestroyRenderer(renderer_);
     SDL_DestroyWindow(window_);
     
@@ -82,7 +130,10 @@ private:
       return;
     }
 
-  renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
+    renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
+    // Without a GPU, as with the dummy video driver, the software renderer draws.
+    if (!renderer_)
+      renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_SOFTWARE);
     if (!renderer_) {
       std::cout << "Renderer could not be created. SDL_Error: " << SDL_GetError() << "\n";
       return;
@@ -96,26 +147,90 @@ private:
     isInitialized_ = true;
   }
 
-  SDL_Texture* loadTexture( std::string path ) {
-    //std::cout << "loadTexture()\n";
-    SDL_Texture* texture = NULL;
+  // Add the sprites the view shows to the batch and draw them. Returns false if the renderer
+  // could not.
+  bool drawBatched(const Game& game, Rect view) {
+    batch_.clear();
+    forEachSprite(game, view, [&](const SDL_FRect& dest, const SDL_Rect& /* src */, const SDL_FRect& uv,
+                                  double angle) { batch_.add(dest, uv, angle); });
+    if (batch_.draw(renderer_, atlas_) != 0)
+      return false;
+    lastFrame_.sprites = batch_.size();
+    lastFrame_.drawCalls = batch_.size() > 0 ? 1 : 0;
+    return true;
+  }
+
+  void drawPerSprite(const Game& game, Rect view) {
+    forEachSprite(game, view, [&](const SDL_FRect& dest, const SDL_Rect& src, const SDL_FRect& /* uv */,
+                                  double angle) {
+        SDL_Rect rect = { static_cast<int>(dest.x), static_cast<int>(dest.y), static_cast<int>(dest.w),
+                          static_cast<int>(dest.h) };
+        SDL_RenderCopyEx(renderer_, atlas_, &src, &rect, angle, NULL, SDL_FLIP_NONE);
+        lastFrame_.sprites++;
+        lastFrame_.drawCalls++;
+      });
+  }
 
-    SDL_Surface* surface = IMG_Load(path.c_str());
-    if(!surface) {
-      std::cout << "Unable to load image " << path.c_str() << ". SDL_image Error: " << IMG_GetError() << "\n";
+  // Call f with where on the screen, where in the atlas and at which angle to draw each player
+  // and then each bullet the view shows.
+  template <typename F>
+  void forEachSprite(const Game& game, Rect view, F f) const {
+    for (auto& [_, player] : game.getPlayers()) {
+      Point playerPos = player.getPos();
+      SDL_FRect dest = { static_cast<float>(playerPos.x - view.x), static_cast<float>(playerPos.y - view.y),
+                         PLAYER_SIDE, PLAYER_SIDE };
+      if (onScreen(dest))
+        f(dest, spaceshipSrc_, spaceshipUv_, player.getAngle());
     }
-    else {
-      texture = SDL_CreateTextureFromSurface(renderer_, surface);
-      if(!texture) {
-        std::cout << "Unable to create texture from " << path.c_str() << ". SDL Error: " << SDL_GetError() << "\n";
-      }
-      SDL_FreeSurface(surface);
+    const BulletPool& bullets = game.getBullets();
+    for (std::size_t i = 0; i < bullets.size(); i++) {
+      SDL_FRect dest = { static_cast<float>(bullets.xs()[i] - view.x), static_cast<float>(bullets.ys()[i] - view.y),
+                         2 * BULLET_SIDE, BULLET_SIDE };
+      if (onScreen(dest))
+        f(dest, bulletSrc_, bulletUv_, bullets.angles()[i]);
     }
-    return texture;
   }
 
+  // Whether any of a sprite at dest, whichever way it is turned, is in the window.
+  static bool onScreen(const SDL_FRect& dest) {
+    // The most a corner moves out of the rectangle when the sprite turns.
+    float margin = std::max(dest.w, dest.h) / 2;
+    return dest.x + dest.w + margin >= 0 && dest.y + dest.h + margin >= 0 && dest.x - margin < SCREEN_WIDTH &&
+           dest.y - margin < SCREEN_HEIGHT;
+  }
 
+  // Copy the two images side by side into one texture and note where each is.
+  SDL_Texture* makeAtlas(SDL_Surface* spaceship, SDL_Surface* bullet) {
+    int width = spaceship->w + ATLAS_PADDING + bullet->w;
+    int height = std::max(spaceship->h, bullet->h);
+    // New surfaces are transparent.
+    SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+    if (!atlas) {
+      std::cout << "Unable to create the sprite atlas. SDL Error: " << SDL_GetError() << "\n";
+      return NULL;
+    }
+    spaceshipSrc_ = { 0, 0, spaceship->w, spaceship->h };
+    bulletSrc_ = { spaceship->w + ATLAS_PADDING, 0, bullet->w, bullet->h };
+    // Copy the pixels as they are, alpha included, instead of blending them onto the atlas.
+    SDL_SetSurfaceBlendMode(spaceship, SDL_BLENDMODE_NONE);
+    SDL_SetSurfaceBlendMode(bullet, SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(spaceship, NULL, atlas, &spaceshipSrc_);
+    SDL_BlitSurface(bullet, NULL, atlas, &bulletSrc_);
+    spaceshipUv_ = uvOf(spaceshipSrc_, width, height);
+    bulletUv_ = uvOf(bulletSrc_, width, height);
 
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer_, atlas);
+    if(!texture) {
+      std::cout << "Unable to create the sprite atlas texture. SDL Error: " << SDL_GetError() << "\n";
+    }
+    SDL_FreeSurface(atlas);
+    return texture;
+  }
+
+  static SDL_FRect uvOf(const SDL_Rect& src, int width, int height) {
+    return { static_cast<float>(src.x) / width, static_cast<float>(src.y) / height, static_cast<float>(src.w) / width,
+             static_cast<float>(src.h) / height };
+  }
 };
 
 #endif
@@ -1,5 +1,31 @@
 #ifndef GAME_MESSAGE_H
 #define GAME_MESSAGE_H
 
-enum class GameMessage : uint8_t { GameState };
+#include <cstdint>
+
+// Messages sent from the server to clients.
+// GameState carries a full snapshot (a keyframe), GameStateDelta the difference between
+// a snapshot the client has acknowledged and the current one. Welcome is sent once when a
+// client connects and carries a WelcomeInfo.
+enum class GameMessage : uint8_t { GameState, GameStateDelta, Welcome };
+
+// What a client is told when it connects.
+struct WelcomeInfo {
+  // ID of the client's player.
+  uint32_t playerId = 0;
+  // Times a second the rooms tick. The client sends an input every tick, and its prediction
+  // and interpolation go by the rate.
+  uint32_t ticksPerSecond = 0;
+
+  template<class Archive>
+  void serialize(Archive& ar, const unsigned int version) {
+    ar & playerId;
+    ar & ticksPerSecond;
+  }
+};
+
+// Whether a message must arrive, over transports that can lose messages. A lost snapshot is
+// replaced by the next one, so only Welcome is sent reliably.
+bool isReliable(GameMessage id) { return id == GameMessage::Welcome; }
+
 #endif
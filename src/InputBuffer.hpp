@@ -0,0 +1,79 @@
+#ifndef INPUT_BUFFER_H
+#define INPUT_BUFFER_H
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <vector>
+
+#include "PlayerInput.hpp"
+
+// Inputs waiting to be applied, at most this many per player. If a client gets further ahead
+// of the server than this, its oldest inputs are dropped.
+const std::size_t MAX_PENDING_INPUTS = 8;
+
+// Server side queues of the inputs received from each player. Each tick takes at most one
+// input per player, so a player moves at the server's tick rate however fast the client runs.
+// A player with no input queued does nothing that tick.
+class InputBuffer {
+  struct PlayerInputs {
+    // Ring of the inputs waiting, oldest at first. Fixed in size, so queueing never allocates.
+    std::array<PlayerInput, MAX_PENDING_INPUTS> pending;
+    std::size_t first = 0;
+    std::size_t count = 0;
+    // Sequence number of the latest input queued and of the latest input applied.
+    uint32_t lastQueuedSeq = 0;
+    uint32_t lastProcessedSeq = 0;
+  };
+
+  // By connection ID.
+  std::map<uint32_t, PlayerInputs> players_;
+
+public:
+  // Queue an input from the player with the given ID. Inputs that are not newer than the
+  // latest one queued are ignored.
+  void push(uint32_t id, const PlayerInput& input) {
+    PlayerInputs& player = players_[id];
+    if (input.seq <= player.lastQueuedSeq)
+      return;
+    player.lastQueuedSeq = input.seq;
+    if (player.count == MAX_PENDING_INPUTS) {
+      player.first = (player.first + 1) % MAX_PENDING_INPUTS;
+      player.count--;
+    }
+    player.pending[(player.first + player.count) % MAX_PENDING_INPUTS] = input;
+    player.count++;
+  }
+
+  // Take the next input of each player that has one and call apply(id, input) with it.
+  template <typename Apply>
+  void popEach(Apply apply) {
+    for (auto& [id, player] : players_) {
+      if (player.count == 0)
+        continue;
+      PlayerInput input = player.pending[player.first];
+      player.first = (player.first + 1) % MAX_PENDING_INPUTS;
+      player.count--;
+      player.lastProcessedSeq = input.seq;
+      apply(id, input);
+    }
+  }
+
+  // Sequence number of the latest input applied for the player with the given ID, or zero.
+  uint32_t lastProcessedSeq(uint32_t id) const {
+    auto found = players_.find(id);
+    return found != players_.end() ? found->second.lastProcessedSeq : 0;
+  }
+
+  // Forget the inputs of players that are no longer connected.
+  void retain(const std::vector<uint32_t>& ids) {
+    for (auto it = players_.begin(); it != players_.end();) {
+      if (std::find(ids.begin(), ids.end(), it->first) == ids.end())
+        it = players_.erase(it);
+      else
+        ++it;
+    }
+  }
+};
+
+#endif
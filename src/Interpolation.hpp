@@ -0,0 +1,176 @@
+#ifndef INTERPOLATION_H
+#define INTERPOLATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+#include "Game.hpp"
+#include "Utils.hpp"
+
+// How far behind the server the client draws by default. Snapshots arriving up to this much
+// later than the fastest ones are still in time to be interpolated.
+const double DEFAULT_PLAYOUT_DELAY_MS = 100;
+// How far past the newest snapshot the state is extrapolated when snapshots are late.
+// After that the state stays where it is until a snapshot arrives.
+const double DEFAULT_MAX_EXTRAPOLATION_MS = 100;
+// How fast the estimate of the server's clock is allowed to drift back when snapshots arrive
+// later than before, so that a lasting increase in delay is eventually taken into account.
+const double CLOCK_OFFSET_DECAY_MS = 0.1;
+// Number of snapshots kept.
+const std::size_t INTERPOLATION_BUFFER_SIZE = 64;
+
+// Client side buffer of the snapshots received, for drawing the game at a steady rate whatever
+// the rate and jitter of the snapshots. The client draws the game as it was playout delay
+// before the server's current time, which is estimated from the ticks and arrival times of the
+// snapshots. Players and bullets are interpolated between the snapshots on either side of that
+// time. If there is no later snapshot, they are extrapolated for a while: bullets along their
+// velocity, players along their latest movement.
+// Times are in milliseconds on any steady clock; the caller passes the current time.
+class SnapshotInterpolator {
+  struct Entry {
+    uint32_t tick;
+    Game game;
+  };
+
+  std::deque<Entry> snapshots_;
+  double playoutDelayMs_;
+  double maxExtrapolationMs_;
+  // Estimate of the server's time minus the local time, from the least delayed snapshots.
+  double clockOffsetMs_ = 0;
+  bool hasClockOffset_ = false;
+  // The tick last drawn. Drawing never goes back in time.
+  double lastRenderTick_ = 0;
+  // Duration of a server tick, from the tick rate of the snapshots.
+  double msPerTick_ = 1000.0 / FRAMES_PER_SECOND;
+
+public:
+  explicit SnapshotInterpolator(double playoutDelayMs = DEFAULT_PLAYOUT_DELAY_MS,
+                                double maxExtrapolationMs = DEFAULT_MAX_EXTRAPOLATION_MS)
+    : playoutDelayMs_(playoutDelayMs), maxExtrapolationMs_(maxExtrapolationMs) {}
+
+  // Add a snapshot that arrived at the given time. Snapshots older than the newest are ignored.
+  void push(const Game& game, double arrivalMs) {
+    uint32_t tick = game.getTick();
+    if (!snapshots_.empty() && tick <= snapshots_.back().tick)
+      return;
+    msPerTick_ = 1000.0 / game.getTicksPerSecond();
+    double offset = tick * msPerTick_ - arrivalMs;
+    if (!hasClockOffset_ || offset > clockOffsetMs_) {
+      clockOffsetMs_ = offset;
+      hasClockOffset_ = true;
+    } else {
+      clockOffsetMs_ -= CLOCK_OFFSET_DECAY_MS;
+    }
+    snapshots_.push_back({tick, game});
+    if (snapshots_.size() > INTERPOLATION_BUFFER_SIZE)
+      snapshots_.pop_front();
+  }
+
+  bool empty() const { return snapshots_.empty(); }
+
+  void setPlayoutDelay(double ms) { playoutDelayMs_ = ms; }
+
+  // The server tick to draw at the given time, possibly between two ticks.
+  double renderTick(double nowMs) const {
+    return (nowMs + clockOffsetMs_ - playoutDelayMs_) / msPerTick_;
+  }
+
+  // Make out the state to draw at the given time. Does nothing if no snapshot has arrived.
+  void sample(double nowMs, Game& out) {
+    if (snapshots_.empty())
+      return;
+    double t = std::max(renderTick(nowMs), lastRenderTick_);
+    lastRenderTick_ = t;
+    // Forget the snapshots that are no longer needed, keeping the last one before t and
+    // the one before that for extrapolating.
+    while (snapshots_.size() > 2 && snapshots_[1].tick <= t)
+      snapshots_.pop_front();
+
+    const Entry& first = snapshots_.front();
+    out = Game(first.game.getWorldSize(), first.game.getTicksPerSecond());
+    if (t <= first.tick) {
+      // Drawing before the oldest snapshot: show it as it is.
+      out.tick_ = first.tick;
+      out.players_ = first.game.players_;
+      out.bullets_ = first.game.bullets_;
+    } else if (snapshots_.size() > 1 && t < snapshots_[1].tick) {
+      const Entry& next = snapshots_[1];
+      out.tick_ = first.tick;
+      interpolate(first.game, next.game, (t - first.tick) / (next.tick - first.tick), out);
+    } else {
+      // No snapshot after t yet.
+      const Entry& latest = snapshots_.back();
+      const Game* previous = snapshots_.size() > 1 ? &snapshots_[snapshots_.size() - 2].game : nullptr;
+      double maxTicks = maxExtrapolationMs_ / msPerTick_;
+      out.tick_ = latest.tick;
+      extrapolate(latest.game, previous, std::min(t - latest.tick, maxTicks), out);
+    }
+  }
+
+private:
+  static double lerp(double a, double b, double alpha) { return a + (b - a) * alpha; }
+
+  // Angles within [0, 360) are put between each other the short way round, so a player turning
+  // past 0 does not spin the other way.
+  static double lerpAngle(double a, double b, double alpha) {
+    double turn = wrapAngle(b - a);
+    if (turn > 180)
+      turn -= 360;
+    return wrapAngle(a + turn * alpha);
+  }
+
+  static Point lerp(Point a, Point b, double alpha) {
+    return {static_cast<int>(std::lround(lerp(a.x, b.x, alpha))),
+            static_cast<int>(std::lround(lerp(a.y, b.y, alpha)))};
+  }
+
+  // Players in both states are put between them; those only in the earlier state are shown as
+  // they were, and those only in the later state are not shown yet. The bullets of the earlier
+  // state are placed where they are at the tick between the states.
+  static void interpolate(const Game& a, const Game& b, double alpha, Game& out) {
+    for (auto& [id, player] : a.players_) {
+      Player p = player;
+      auto found = b.players_.find(id);
+      if (found != b.players_.end()) {
+        p.pos_ = lerp(player.pos_, found->second.pos_, alpha);
+        p.angle_ = lerpAngle(player.angle_, found->second.angle_, alpha);
+      }
+      out.players_.insert({id, p});
+    }
+    // Bullets are placed from their spawn at the tick between the two states.
+    double tick = a.tick_ + alpha * (b.tick_ - a.tick_);
+    const BulletPool& bullets = a.bullets_;
+    for (std::size_t i = 0; i < bullets.size(); i++) {
+      BulletSpawn spawn = bullets.spawn(i);
+      out.bullets_.add(spawn.at(tick, a.ticksPerSecond_), spawn);
+    }
+  }
+
+  // Bullets are moved along their velocity and players along the direction they were moving
+  // in between the previous and the latest snapshot, for the given number of ticks.
+  // Without a previous snapshot, players stay where they are.
+  static void extrapolate(const Game& latest, const Game* previous, double ticks, Game& out) {
+    double span = previous ? latest.getTick() - previous->getTick() : 0;
+    for (auto& [id, player] : latest.players_) {
+      Player p = player;
+      if (previous) {
+        auto found = previous->players_.find(id);
+        if (found != previous->players_.end()) {
+          double alpha = 1 + ticks / span;
+          p.pos_ = lerp(found->second.pos_, player.pos_, alpha);
+          p.angle_ = lerpAngle(found->second.angle_, player.angle_, alpha);
+        }
+      }
+      out.players_.insert({id, p});
+    }
+    const BulletPool& bullets = latest.bullets_;
+    for (std::size_t i = 0; i < bullets.size(); i++) {
+      BulletSpawn spawn = bullets.spawn(i);
+      out.bullets_.add(spawn.at(latest.tick_ + ticks, latest.ticksPerSecond_), spawn);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef IO_THREAD_POOL_H
+#define IO_THREAD_POOL_H
+
+#include <thread>
+#include <vector>
+
+#include "asio.hpp"
+
+// Threads running an io context, so that handlers of different connections can run in parallel.
+// The context is kept running while there is no work, and is stopped and the threads joined
+// when the pool is destroyed.
+class IoThreadPool {
+  asio::io_context& ioContext_;
+  asio::executor_work_guard<asio::io_context::executor_type> work_;
+  std::vector<std::thread> threads_;
+
+public:
+  IoThreadPool(asio::io_context& ioContext, std::size_t numThreads)
+    : ioContext_(ioContext), work_(asio::make_work_guard(ioContext)) {
+    if (numThreads == 0)
+      numThreads = 1;
+    for (std::size_t i = 0; i < numThreads; i++)
+      threads_.emplace_back([this]() { ioContext_.run(); });
+  }
+
+  IoThreadPool(const IoThreadPool&) = delete;
+  IoThreadPool& operator=(const IoThreadPool&) = delete;
+
+  ~IoThreadPool() {
+    work_.reset();
+    ioContext_.stop();
+    for (std::thread& t : threads_)
+      t.join();
+  }
+
+  std::size_t size() const { return threads_.size(); }
+};
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ClientMessage.hpp"
+#include "GameMessage.hpp"
+#include "Message.hpp"
+#include "OwnedMessage.hpp"
+#include "Room.hpp"
+#include "Stats.hpp"
+#include "TickScheduler.hpp"
+#include "Utils.hpp"
+
+// Most rooms a server hosts at once. Joining a room beyond these closes the connection.
+const std::size_t MAX_ROOMS = 1024;
+
+// Routes the connections of a server to rooms. Every new connection is welcomed with the ID of
+// its player and the rate the rooms tick at, and then picks a room with a Join message; a room
+// is created when the first connection joins it and destroyed when the last one leaves.
+// Joining another room leaves the current one. The other messages of a connection are passed
+// on to its room, and are ignored until it has joined one. update() is called regularly from a
+// single thread, the server's main loop, while the rooms tick on their own threads. Given a
+// directory, the lobby records every room it creates there, in a file named after the room and
+// the time it was created. Every room ticks at the given rate.
+template <typename GameServer>
+class Lobby {
+  GameServer& server_;
+  uint32_t ticksPerSnapshot_;
+  WorldSize world_;
+  // Directory rooms are recorded in, or empty if they are not.
+  std::string replayDir_;
+  TickRate rate_;
+
+  // Rooms by the ID clients join them with.
+  std::map<uint32_t, std::unique_ptr<Room<GameServer>>> rooms_;
+  // Room of each connection that has joined one, by connection ID.
+  std::map<uint32_t, uint32_t> roomOf_;
+  // Connections that have been told the ID of their player, as of the server's
+  // connectionChanges() count in syncedChanges_.
+  std::set<uint32_t> welcomed_;
+  uint64_t syncedChanges_ = 0;
+  // Stats and dropped messages of the rooms destroyed so far.
+  TickStats retiredStats_;
+  uint64_t retiredDropped_ = 0;
+
+public:
+  Lobby(GameServer& server, uint32_t ticksPerSnapshot, const WorldSize& world, const std::string& replayDir = "",
+        const TickRate& rate = DEFAULT_TICK_RATE)
+    : server_(server), ticksPerSnapshot_(ticksPerSnapshot), world_(world), replayDir_(replayDir), rate_(rate) {}
+
+  // Welcome new connections, take connections that are gone out of their rooms and route the
+  // messages received since the last call.
+  void update() {
+    // Counting the connections is not enough: one can go and another come between two calls.
+    uint64_t changes = server_.connectionChanges();
+    if (changes != syncedChanges_) {
+      syncedChanges_ = changes;
+      syncConnections(server_.getIDs());
+    }
+    server_.getIncomingMsgs().drain([&](OwnedMessage<ClientMessage>&& ownedMessage) {
+      uint32_t id = ownedMessage.id;
+      if (ownedMessage.msg.header.messageId == ClientMessage::Join) {
+        uint32_t roomId;
+        if (ownedMessage.msg.getData(roomId))
+          join(id, roomId);
+        return;
+      }
+      auto found = roomOf_.find(id);
+      if (found != roomOf_.end())
+        rooms_.at(found->second)->push(std::move(ownedMessage));
+    });
+  }
+
+  std::size_t numRooms() const { return rooms_.size(); }
+
+  // Add the tick stats of every room there has been to total.
+  void addTickStats(TickStats& total) const {
+    total.add(retiredStats_);
+    for (auto& [roomId, room] : rooms_)
+      total.add(room->stats());
+  }
+
+  // Number of messages dropped because a room's queue was full, in every room there has been.
+  uint64_t droppedMessages() const {
+    uint64_t dropped = retiredDropped_;
+    for (auto& [roomId, room] : rooms_)
+      dropped += room->dropped();
+    return dropped;
+  }
+
+private:
+  // Welcome connections that are new and take the ones that are gone out of their rooms.
+  void syncConnections(const std::vector<uint32_t>& ids) {
+    std::set<uint32_t> current(ids.begin(), ids.end());
+    for (uint32_t id : current) {
+      if (welcomed_.count(id) == 0) {
+        Message<GameMessage> msg;
+        msg.header.messageId = GameMessage::Welcome;
+        msg.setData(WelcomeInfo{id, rate_.ticksPerSecond});
+        server_.writeTo(id, msg);
+      }
+    }
+    for (uint32_t id : welcomed_) {
+      if (current.count(id) == 0)
+        leave(id);
+    }
+    welcomed_ = std::move(current);
+  }
+
+  void join(uint32_t id, uint32_t roomId) {
+    auto found = roomOf_.find(id);
+    if (found != roomOf_.end()) {
+      if (found->second == roomId)
+        return;
+      leave(id);
+    }
+    auto room = rooms_.find(roomId);
+    if (room == rooms_.end()) {
+      if (rooms_.size() >= MAX_ROOMS) {
+        std::cout << "Connection with ID " << id << " cannot join room " << roomId << ": too many rooms\n";
+        server_.disconnect(id);
+        return;
+      }
+      room = rooms_.emplace(roomId, std::make_unique<Room<GameServer>>(server_, ticksPerSnapshot_, world_,
+                                                                       replayPath(roomId), rate_)).first;
+    }
+    room->second->add(id);
+    roomOf_[id] = roomId;
+  }
+
+  // Where to record a room created now, or an empty path if rooms are not recorded.
+  std::string replayPath(uint32_t roomId) const {
+    if (replayDir_.empty())
+      return "";
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
+    return replayDir_ + "/room-" + std::to_string(roomId) + "-" + std::to_string(now.count()) + ".replay";
+  }
+
+  // Take a connection out of its room, if it is in one, destroying the room if it is left empty.
+  void leave(uint32_t id) {
+    auto found = roomOf_.find(id);
+    if (found == roomOf_.end())
+      return;
+    auto room = rooms_.find(found->second);
+    if (room->second->remove(id) == 0) {
+      // Without the tick the room may be in the middle of.
+      retiredStats_.add(room->second->stats());
+      retiredDropped_ += room->second->dropped();
+      rooms_.erase(room);
+    }
+    roomOf_.erase(found);
+  }
+};
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free queue with any number of producer threads and a single consumer thread.
+// It is a ring of slots, each with a sequence number telling whether the slot is free for the
+// producer claiming position pos (seq == pos) or holds a value for the consumer (seq == pos + 1).
+// Producers claim positions with a compare-and-swap on the tail; the consumer owns the head.
+//
+// When the queue is full, push() fails immediately and the value is dropped; producers never
+// block or wait for the consumer. The number of dropped values is counted so it can be monitored.
+// pop(), drain() and empty() may only be called from the consumer thread.
+template <typename T>
+class MPSCQueue {
+  struct Slot {
+    std::atomic<std::size_t> seq;
+    T data;
+  };
+
+  std::size_t capacity_;
+  std::size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  // Producers and the consumer write to different cache lines.
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  alignas(64) std::size_t head_ = 0;
+  std::atomic<uint64_t> dropped_{0};
+
+public:
+  // The capacity is rounded up to a power of two.
+  explicit MPSCQueue(std::size_t capacity = 4096)
+    : capacity_(roundUpToPowerOfTwo(capacity)),
+      mask_(capacity_ - 1),
+      slots_(new Slot[capacity_]) {
+    for (std::size_t i = 0; i < capacity_; i++)
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  MPSCQueue(const MPSCQueue&) = delete;
+  MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+  // Add a value to the queue. Returns false, dropping the value, if the queue is full.
+  bool push(T data) {
+    std::size_t pos = tail_.load(std::memory_order_relaxed);
+    while (true) {
+      Slot& slot = slots_[pos & mask_];
+      std::size_t seq = slot.seq.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        // The slot is free; claim the position. On failure pos is updated to the current tail.
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          slot.data = std::move(data);
+          slot.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        // The consumer has not emptied the slot from the previous lap yet.
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        // Another producer claimed the position first.
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Take the oldest value. Returns false if there is none.
+  bool pop(T& out) {
+    Slot& slot = slots_[head_ & mask_];
+    if (slot.seq.load(std::memory_order_acquire) != head_ + 1)
+      return false;
+    out = std::move(slot.data);
+    // Hand the slot to the producer that will claim it on the next lap.
+    slot.seq.store(head_ + capacity_, std::memory_order_release);
+    head_++;
+    return true;
+  }
+
+  // Call f(value) for every value in the queue, oldest first, and return how many there were.
+  // At most one queue's worth is taken, so producers cannot keep the consumer here forever.
+  template <typename F>
+  std::size_t drain(F f) {
+    std::size_t count = 0;
+    T data;
+    while (count < capacity_ && pop(data)) {
+      f(std::move(data));
+      count++;
+    }
+    return count;
+  }
+
+  bool empty() const {
+    return slots_[head_ & mask_].seq.load(std::memory_order_acquire) != head_ + 1;
+  }
+
+  std::size_t capacity() const { return capacity_; }
+
+  // Number of values dropped because the queue was full.
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  static std::size_t roundUpToPowerOfTwo(std::size_t n) {
+    std::size_t p = 1;
+    while (p < n)
+      p <<= 1;
+    return p;
+  }
+};
+
+#endif
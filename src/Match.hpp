@@ -0,0 +1,71 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include <vector>
+
+#include "Game.hpp"
+#include "GameMessage.hpp"
+#include "InputBuffer.hpp"
+#include "PlayerInput.hpp"
+#include "Snapshot.hpp"
+
+// The state of a match without any io: the game, the inputs waiting to be applied and the
+// snapshots sent to the players. A Room plays a match with the connections in it; a replay
+// plays one from a recording (see Replay.hpp). Given the same members, inputs and
+// acknowledgements between the same ticks, two matches go exactly the same way.
+class Match {
+  uint32_t ticksPerSnapshot_;
+  Game game_;
+  // Snapshots sent to the players, for delta compression against what each has acknowledged.
+  SnapshotHistory history_;
+  // Inputs received from each player, applied one per player per tick.
+  InputBuffer inputs_;
+
+public:
+  Match(uint32_t ticksPerSnapshot, const WorldSize& world, uint32_t ticksPerSecond = FRAMES_PER_SECOND)
+    : ticksPerSnapshot_(ticksPerSnapshot), game_(world, ticksPerSecond), history_(world) {}
+
+  const Game& game() const { return game_; }
+
+  uint32_t ticksPerSnapshot() const { return ticksPerSnapshot_; }
+
+  // Make the players the connections with the given IDs, in ascending order. Players who were
+  // hit since the last call are added back.
+  void setMembers(const std::vector<uint32_t>& ids) {
+    game_.syncPlayers(ids);
+    history_.retain(ids);
+    inputs_.retain(ids);
+  }
+
+  // Queue an input from a player, applied at a later tick.
+  void input(uint32_t id, const PlayerInput& input) { inputs_.push(id, input); }
+
+  // A player has received the snapshot with the given sequence number.
+  void ack(uint32_t id, uint32_t seq) { history_.ack(id, seq); }
+
+  // Apply the next input of each player and advance the game. invalid(id) is called for each
+  // input from a player who is not in the game. Returns the IDs of the players that were hit,
+  // which are valid until the next tick.
+  template <typename Invalid>
+  const std::vector<uint32_t>& tick(Invalid invalid) {
+    inputs_.popEach([&](uint32_t id, const PlayerInput& input) {
+      if (!game_.applyInput(id, input))
+        invalid(id);
+    });
+    return game_.advance();
+  }
+
+  // Take a snapshot of the game if one is due at this tick. Returns whether one was taken;
+  // frameFor() then gives the frame to send each player.
+  bool snapshot() {
+    if (game_.getTick() % ticksPerSnapshot_ != 0)
+      return false;
+    history_.push(game_);
+    return true;
+  }
+
+  // The latest snapshot encoded for the player with the given ID.
+  FramePtr<GameMessage> frameFor(uint32_t id) { return history_.frameFor(id); }
+};
+
+#endif
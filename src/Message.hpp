@@ -1,11 +1,15 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <vector>
 #include <cstring>
-#include <boost/archive/text_iarchive.hpp>
-#include <boost/archive/text_oarchive.hpp>
+#include <memory>
 #include <string>
+#include <type_traits>
+#include "Codec.hpp"
 
 // Header of a message.
 // Contains a message ID and the size of the body.
@@ -13,37 +17,143 @@ template <typename T>
 struct Header {
   T messageId;
   uint32_t size = 0;
+
+  // The header is sent field by field in little-endian order, so the bytes on the wire
+  // contain no padding and do not depend on the host's struct layout.
+  static constexpr std::size_t wireSize = sizeof(T) + sizeof(uint32_t);
+
+  void encode(uint8_t* out) const {
+    using Id = RawBits<T>;
+    Id id;
+    std::memcpy(&id, &messageId, sizeof(T));
+    storeLE(out, id);
+    storeLE(out + sizeof(T), size);
+  }
+
+  void decode(const uint8_t* in) {
+    using Id = RawBits<T>;
+    Id id = loadLE<Id>(in);
+    std::memcpy(&messageId, &id, sizeof(T));
+    size = loadLE<uint32_t>(in + sizeof(T));
+  }
 };
 
 // This class represents a message that can be exchanged between peers.
-// It uses the Boost serialization library to encode and decode data.
+// The body is encoded with the binary archives in Codec.hpp.
 // Hence the objects to be sent in the message body must implement serialization functions.
 template <typename T>
 struct Message {
   Header<T> header;
   std::string body;
 
+  // Encode data into the body. The body's storage is reused, so a message object that is
+  // kept around does not reallocate once its body has grown to the usual size.
   template<typename BodyData>
-  void setData(BodyData data) {
-    std::stringstream ss;
-    {
-      boost::archive::text_oarchive oa(ss);
-      oa & data;
-    }
-    body = ss.str();
+  void setData(const BodyData& data) {
+    body.clear();
+    BinaryWriter writer(body);
+    writer & data;
     header.size = body.size();
   }
 
+  // Decode the body into data. Returns false if the body is malformed.
   template <typename BodyData>
-  void getData(BodyData& data) {
-    std::stringstream ss;
-    ss << body;
-    {
-      boost::archive::text_iarchive ia(ss);
-      ia & data;
-    }
+  bool getData(BodyData& data) const {
+    BinaryReader reader(body.data(), body.size());
+    reader & data;
+    return reader.ok();
   }
   
 };
 
+// A message encoded for sending: the header's wire bytes and the body.
+// A frame cannot be changed once made, so one frame can be shared by the send queues of any
+// number of connections; broadcasting a message encodes and stores it once, not once per client.
+template <typename T>
+class Frame {
+  Header<T> header_;
+  std::array<uint8_t, Header<T>::wireSize> wireHeader_;
+  std::string body_;
+
+  template <typename>
+  friend class FramePool;
+
+public:
+  explicit Frame(Message<T> msg) : header_(msg.header), body_(std::move(msg.body)) {
+    header_.size = body_.size();
+    header_.encode(wireHeader_.data());
+  }
+
+  const Header<T>& header() const { return header_; }
+  const std::array<uint8_t, Header<T>::wireSize>& wireHeader() const { return wireHeader_; }
+  const std::string& body() const { return body_; }
+};
+
+template <typename T>
+using FramePtr = std::shared_ptr<const Frame<T>>;
+
+template <typename T>
+FramePtr<T> makeFrame(Message<T> msg) {
+  return std::make_shared<const Frame<T>>(std::move(msg));
+}
+
+// Frames whose storage is used again once every connection they were written to is done with
+// them, so that encoding messages allocates nothing once the pool holds as many frames as are
+// in flight at a time and their bodies have grown to the usual size. A frame is only rewritten
+// when the pool holds the last reference to it, so frames still do not change once made.
+// Only used by one thread at a time; the frames it makes may be released by any thread.
+template <typename T>
+class FramePool {
+  std::vector<std::shared_ptr<Frame<T>>> frames_;
+  // Where to look for a free frame first. Frames are released in about the order they are made.
+  std::size_t next_ = 0;
+  // Size of the largest body written so far. A frame with less room than that is given room for
+  // twice as much before it is written, so that bodies a little larger than ever, which are
+  // common with snapshots of a few dozen bytes, do not make every frame grow again.
+  std::size_t largestBody_ = 0;
+
+public:
+  // Make a frame with the given message ID and the body written by write(writer), where the
+  // writer has the given scratch memory.
+  template <typename Write>
+  FramePtr<T> make(T messageId, std::pmr::memory_resource* scratch, Write write) {
+    Frame<T>& frame = *take();
+    frame.header_.messageId = messageId;
+    frame.body_.clear();
+    if (frame.body_.capacity() < largestBody_)
+      frame.body_.reserve(2 * largestBody_);
+    BinaryWriter writer(frame.body_, scratch);
+    write(writer);
+    frame.header_.size = frame.body_.size();
+    frame.header_.encode(frame.wireHeader_.data());
+    largestBody_ = std::max(largestBody_, frame.body_.size());
+    return frames_[next_++];
+  }
+
+  std::size_t size() const { return frames_.size(); }
+
+private:
+  // A frame nobody else holds, moved to next_.
+  std::shared_ptr<Frame<T>>& take() {
+    for (std::size_t n = 0; n < frames_.size(); n++) {
+      std::size_t i = (next_ + n) % frames_.size();
+      if (frames_[i].use_count() == 1) {
+        // Whoever released the frame last is done reading it before it is written here.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        next_ = i;
+        return frames_[i];
+      }
+    }
+    // None is free: double the pool, like a vector grows, so that the rare ticks needing more
+    // frames than ever soon stop finding the pool short.
+    next_ = frames_.size();
+    std::size_t added = std::max<std::size_t>(frames_.size(), 1);
+    for (std::size_t n = 0; n < added; n++) {
+      frames_.push_back(std::make_shared<Frame<T>>(Message<T>{}));
+      frames_.back()->body_.reserve(2 * largestBody_);
+    }
+    return frames_[next_];
+  }
+};
+
 #endif
@@ -5,19 +5,31 @@
 #include <boost/serialization/vector.hpp>
 
 #include "Point.hpp"
-#include "Velocity.hpp"
 #include "Bullet.hpp"
 #include "Utils.hpp"
 #include "PlayerAction.hpp"
+#include "PlayerInput.hpp"
+
+// How fast players move, in pixels a second, and turn, in steps of ANGLE_STEPS a second
+// (120 degrees), so that they always turn to angles that are sent exactly in snapshots.
+const int PLAYER_SPEED = 300;
+const int PLAYER_TURN_SPEED = 60;
 
 class Player {
   uint32_t id_;
   Point pos_;
-  std::vector<Bullet> bullets_;
   double angle_ = 0.0;
-
-  Velocity vel_ = {5, 5};
-  static constexpr double dAngle_ = 2.0;
+  // Sequence number of the latest input applied to the player, which tells a client
+  // which of its inputs a state already includes.
+  uint32_t lastInputSeq_ = 0;
+  // Tick of the game the player joined it at, which tells its bullets from those fired by an
+  // earlier player with the same ID. It is not sent to clients.
+  uint32_t joinTick_ = 0;
+
+  friend class Game;
+  friend class GameDelta;
+  friend class SnapshotCodec;
+  friend class SnapshotInterpolator;
   
 public:
 
@@ -25,9 +37,10 @@ public:
   friend class boost::serialization::access;
   template<class Archive>
   void serialize(Archive& ar, const unsigned int version) {
+    ar & id_;
     ar & pos_;
     ar & angle_;
-    ar & bullets_;
+    ar & lastInputSeq_;
   }
   
   Player() {}
@@ -45,47 +58,74 @@ public:
     return pos_;
   }
   
-  void moveUp() {
-    int newY = pos_.y - vel_.dy;
+  void moveUp(int distance) {
+    int newY = pos_.y - distance;
     if (newY >= 0)
       pos_.y = newY;
   }
 
-  void moveDown() {
-    int newY = pos_.y + vel_.dy;
-    if (newY + PLAYER_SIDE < SCREEN_HEIGHT)
+  void moveDown(int distance, const WorldSize& world) {
+    int newY = pos_.y + distance;
+    if (newY + PLAYER_SIDE < world.height)
       pos_.y = newY;
   }
 
-  void moveLeft() {
-    int newX = pos_.x - vel_.dx;
+  void moveLeft(int distance) {
+    int newX = pos_.x - distance;
     if (newX >= 0)
       pos_.x = newX;
   }
 
-  void moveRight() {
-    int newX = pos_.x + vel_.dx;
-    if (newX + PLAYER_SIDE < SCREEN_WIDTH)
+  void moveRight(int distance, const WorldSize& world) {
+    int newX = pos_.x + distance;
+    if (newX + PLAYER_SIDE < world.width)
       pos_.x = newX;
   }
 
-  void fire() {
-    bullets_.push_back(Bullet(pos_.x, pos_.y, angle_));
+  // A new bullet fired from the player's position in the direction the player is facing.
+  Bullet fire(uint32_t bulletId) const {
+    return Bullet(pos_.x, pos_.y, angle_, bulletId);
+  }
+
+  // Turn the player by the given number of steps of ANGLE_STEPS. Angles are kept within
+  // [0, 360), as they are sent in snapshots, so that a client predicting its player turns it
+  // to the same angle as the server.
+  void rotateLeft(int steps) {
+    angle_ = wrapAngle(angle_ - steps * 360.0 / ANGLE_STEPS);
   }
 
-  void rotateLeft() {
-    angle_ -= dAngle_;
+  void rotateRight(int steps) {
+    angle_ = wrapAngle(angle_ + steps * 360.0 / ANGLE_STEPS);
   }
 
-  void rotateRight() {
-    angle_ += dAngle_;
+  // Move and rotate the player within the world as the input says, for one tick of a game
+  // ticking ticksPerSecond times a second. Firing is left to the game. Clients predict their own
+  // player with this too, so it must only depend on the player's state, the input, the size of
+  // the world and the tick rate. Each input is one tick, so how far the player goes is told
+  // from the input's sequence number.
+  void applyInput(const PlayerInput& input, const WorldSize& world, uint32_t ticksPerSecond) {
+    int distance = stepOnTick(PLAYER_SPEED, ticksPerSecond, input.seq);
+    int turn = stepOnTick(PLAYER_TURN_SPEED, ticksPerSecond, input.seq);
+    if (input.has(PlayerAction::Up))
+      moveUp(distance);
+    if (input.has(PlayerAction::Down))
+      moveDown(distance, world);
+    if (input.has(PlayerAction::Left))
+      moveLeft(distance);
+    if (input.has(PlayerAction::Right))
+      moveRight(distance, world);
+    if (input.has(PlayerAction::RotateLeft))
+      rotateLeft(turn);
+    if (input.has(PlayerAction::RotateRight))
+      rotateRight(turn);
+    lastInputSeq_ = input.seq;
   }
 
-  std::vector<Bullet>& getBullets() {
-    return bullets_;
+  uint32_t getLastInputSeq() const {
+    return lastInputSeq_;
   }
 
-  double getAngle() {
+  double getAngle() const {
     return angle_;
   }
   
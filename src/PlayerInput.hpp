@@ -0,0 +1,34 @@
+#ifndef PLAYER_INPUT_H
+#define PLAYER_INPUT_H
+
+#include <cstdint>
+
+#include "PlayerAction.hpp"
+
+// The actions a player performs during one tick. A client samples its keys and sends one
+// input every tick, whether or not any key is held, and the server applies each input once.
+struct PlayerInput {
+  // Numbers the inputs a client sends, starting from 1.
+  uint32_t seq = 0;
+  // The client tick the keys were sampled at.
+  uint32_t tick = 0;
+  // Bit i is set if PlayerAction i is performed.
+  uint8_t actions = 0;
+
+  template<class Archive>
+  void serialize(Archive& ar, const unsigned int version) {
+    ar & seq;
+    ar & tick;
+    ar & actions;
+  }
+
+  static uint8_t bit(PlayerAction action) {
+    return 1 << static_cast<uint8_t>(action);
+  }
+
+  void set(PlayerAction action) { actions |= bit(action); }
+
+  bool has(PlayerAction action) const { return actions & bit(action); }
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef PREDICTION_H
+#define PREDICTION_H
+
+#include <deque>
+
+#include "Game.hpp"
+#include "Player.hpp"
+#include "PlayerInput.hpp"
+
+// Inputs kept for replaying, about two seconds' worth at the default tick rate. If the server falls further behind,
+// the oldest are forgotten and the prediction is corrected when the server catches up.
+const std::size_t MAX_UNACKED_INPUTS = 128;
+
+// Client side prediction of the local player. Inputs are applied to a local copy of the player
+// as soon as they are made, instead of a round trip later when the server's state shows them.
+// The inputs are kept until a state from the server includes them. When such a state arrives,
+// the prediction is rewound to the server's player and the inputs it does not include yet are
+// applied again on top of it. If the client and server applied the same inputs, this gives
+// the same player as before, and nothing visibly jumps.
+class PlayerPrediction {
+  // ID of the local player, once the server has told it.
+  uint32_t id_ = 0;
+  bool hasID_ = false;
+  // Whether the local player is in the latest state from the server.
+  bool alive_ = false;
+  Player predicted_;
+  // Size of the world and tick rate of the game, as told by the states from the server.
+  WorldSize world_ = DEFAULT_WORLD_SIZE;
+  uint32_t ticksPerSecond_ = FRAMES_PER_SECOND;
+  // Inputs applied to predicted_ that the latest state from the server does not include.
+  std::deque<PlayerInput> unacked_;
+  // Number of times reconcile() had to move the predicted player.
+  uint64_t corrections_ = 0;
+
+public:
+  void setPlayerID(uint32_t id) {
+    id_ = id;
+    hasID_ = true;
+  }
+
+  bool hasPlayerID() const { return hasID_; }
+
+  // Apply an input made by the local player. Inputs made before the player's first state
+  // arrives are kept as well, since the server applies them.
+  void applyLocal(const PlayerInput& input) {
+    if (alive_)
+      predicted_.applyInput(input, world_, ticksPerSecond_);
+    if (unacked_.size() == MAX_UNACKED_INPUTS)
+      unacked_.pop_front();
+    unacked_.push_back(input);
+  }
+
+  // Rewind to the local player in a state from the server and replay the inputs it does not include.
+  void reconcile(const Game& game) {
+    if (!hasID_)
+      return;
+    auto found = game.getPlayers().find(id_);
+    if (found == game.getPlayers().end()) {
+      if (alive_)
+        unacked_.clear(); // The player has died.
+      alive_ = false;
+      return;
+    }
+    world_ = game.getWorldSize();
+    ticksPerSecond_ = game.getTicksPerSecond();
+    const Player& authoritative = found->second;
+    while (!unacked_.empty() && unacked_.front().seq <= authoritative.getLastInputSeq())
+      unacked_.pop_front();
+    Player replayed = authoritative;
+    for (const PlayerInput& input : unacked_)
+      replayed.applyInput(input, world_, ticksPerSecond_);
+    if (alive_ && !samePlace(replayed, predicted_))
+      corrections_++;
+    predicted_ = replayed;
+    alive_ = true;
+  }
+
+  // Put the predicted local player into a state from the server, for drawing.
+  void overlay(Game& game) const {
+    if (alive_)
+      game.updatePlayer(predicted_);
+  }
+
+  bool alive() const { return alive_; }
+
+  const Player& predicted() const { return predicted_; }
+
+  std::size_t numUnacked() const { return unacked_.size(); }
+
+  uint64_t corrections() const { return corrections_; }
+
+private:
+  static bool samePlace(const Player& a, const Player& b) {
+    return a.getPos().x == b.getPos().x && a.getPos().y == b.getPos().y && a.getAngle() == b.getAngle();
+  }
+};
+
+#endif
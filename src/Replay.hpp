@@ -0,0 +1,269 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BitPacking.hpp"
+#include "Codec.hpp"
+#include "Game.hpp"
+#include "PlayerInput.hpp"
+#include "Utils.hpp"
+
+// Recordings of what happened in a room, for playing a match again exactly, headless and as
+// fast as it goes (see bin/replay). A recording starts with a header: REPLAY_MAGIC,
+// REPLAY_VERSION, the size of the world, the ticks per snapshot and the ticks per second the
+// room played at. Then come records in the order the room handled them, each a byte of
+// ReplayRecord followed by its fields as variable-length integers (see BitPacking.hpp):
+//   Members  the connections now in the room, after one joined or left: a count and the IDs as
+//            differences from the one before.
+//   Input    an input queued: the player's ID, then seq, tick and actions of the PlayerInput.
+//   Ack      a snapshot acknowledged: the player's ID and the snapshot's sequence number.
+//   Tick     the inputs were applied and the game advanced.
+//   Check    the tick the game is at and stateHash() of it, written once a second of play so
+//            that a replay can tell where it went another way than the match did.
+const uint32_t REPLAY_MAGIC = 0x59544853; // "SHTY" in little-endian order.
+const uint32_t REPLAY_VERSION = 3;
+
+enum class ReplayRecord : uint8_t { Members, Input, Ack, Tick, Check };
+
+// Bytes of records kept in memory before they are written out even if no check is due.
+const std::size_t REPLAY_FLUSH_SIZE = 1 << 16;
+
+// Hash of what a game's players and bullets are, FNV-1a over their IDs, positions, angles and
+// the inputs applied. Equal for two games that went the same way.
+uint64_t stateHash(const Game& game) {
+  uint64_t hash = 14695981039346656037ull;
+  auto mix = [&](uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+      hash ^= (value >> (8 * i)) & 0xff;
+      hash *= 1099511628211ull;
+    }
+  };
+  mix(game.getTick());
+  for (auto& [id, player] : game.getPlayers()) {
+    double angle = player.getAngle();
+    uint64_t angleBits;
+    std::memcpy(&angleBits, &angle, sizeof(angleBits));
+    mix(id);
+    mix(static_cast<uint32_t>(player.getPos().x));
+    mix(static_cast<uint32_t>(player.getPos().y));
+    mix(angleBits);
+    mix(player.getLastInputSeq());
+  }
+  const BulletPool& bullets = game.getBullets();
+  for (std::size_t i = 0; i < bullets.size(); i++) {
+    mix(bullets.ids()[i]);
+    mix(static_cast<uint32_t>(bullets.xs()[i]));
+    mix(static_cast<uint32_t>(bullets.ys()[i]));
+  }
+  return hash;
+}
+
+// Appends the records of a room to a file. Records are gathered in a buffer made large enough
+// up front and written to the file at the checks, so recording costs a room's tick a few bytes
+// copied per message and no allocation; the file is only written to once a second.
+class ReplayWriter {
+  std::FILE* file_;
+  std::string buffer_;
+  uint64_t bytesWritten_ = 0;
+  // Ticks between two Check records, and between two writes of the recording to its file, a
+  // second's worth, so that a server that stops loses at most about a second of it.
+  uint32_t checkTicks_;
+
+public:
+  // Create the file at path, replacing any file there. ok() is false if it cannot be created.
+  ReplayWriter(const std::string& path, const WorldSize& world, uint32_t ticksPerSnapshot, uint32_t ticksPerSecond)
+    : file_(std::fopen(path.c_str(), "wb")), checkTicks_(std::max<uint32_t>(1, ticksPerSecond)) {
+    if (file_ == nullptr)
+      return;
+    // The buffer here is the only one.
+    std::setvbuf(file_, nullptr, _IONBF, 0);
+    // Room for a full buffer and the records of a tick beyond it.
+    buffer_.reserve(2 * REPLAY_FLUSH_SIZE);
+    BinaryWriter writer(buffer_);
+    writer << REPLAY_MAGIC << REPLAY_VERSION << world << ticksPerSnapshot << ticksPerSecond;
+  }
+
+  ReplayWriter(const ReplayWriter&) = delete;
+  ReplayWriter& operator=(const ReplayWriter&) = delete;
+
+  ~ReplayWriter() {
+    if (file_ != nullptr) {
+      flush();
+      std::fclose(file_);
+    }
+  }
+
+  bool ok() const { return file_ != nullptr; }
+
+  // Bytes of records written to the file so far.
+  uint64_t bytesWritten() const { return bytesWritten_; }
+
+  void members(const std::vector<uint32_t>& ids) {
+    BitWriter bits(record(ReplayRecord::Members));
+    bits.writeVarint(ids.size());
+    uint32_t previous = 0;
+    for (uint32_t id : ids) {
+      bits.writeVarint(id - previous);
+      previous = id;
+    }
+  }
+
+  void input(uint32_t id, const PlayerInput& input) {
+    BitWriter bits(record(ReplayRecord::Input));
+    bits.writeVarint(id);
+    bits.writeVarint(input.seq);
+    bits.writeVarint(input.tick);
+    bits.write(input.actions, 8);
+  }
+
+  void ack(uint32_t id, uint32_t seq) {
+    BitWriter bits(record(ReplayRecord::Ack));
+    bits.writeVarint(id);
+    bits.writeVarint(seq);
+  }
+
+  // The end of a tick of the given game. Writes a check, and the records so far to the file,
+  // when one is due.
+  void tick(const Game& game) {
+    record(ReplayRecord::Tick);
+    if (game.getTick() % checkTicks_ == 0) {
+      BitWriter bits(record(ReplayRecord::Check));
+      bits.writeVarint(game.getTick());
+      uint64_t hash = stateHash(game);
+      bits.write(static_cast<uint32_t>(hash), 32);
+      bits.write(static_cast<uint32_t>(hash >> 32), 32);
+      bits.flush();
+      flush();
+    } else if (buffer_.size() >= REPLAY_FLUSH_SIZE) {
+      flush();
+    }
+  }
+
+  // Write the records gathered to the file.
+  void flush() {
+    if (file_ == nullptr || buffer_.empty())
+      return;
+    bytesWritten_ += std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    buffer_.clear();
+  }
+
+private:
+  // Start a record of the given type and return the buffer to write its fields to.
+  std::string& record(ReplayRecord type) {
+    buffer_.push_back(static_cast<char>(type));
+    return buffer_;
+  }
+};
+
+// One record of a recording, as read by ReplayReader. Only the fields of its type are set.
+struct ReplayEvent {
+  ReplayRecord type = ReplayRecord::Tick;
+  uint32_t id = 0;
+  PlayerInput input;
+  uint32_t seq = 0;
+  std::vector<uint32_t> members;
+  uint32_t tick = 0;
+  uint64_t hash = 0;
+};
+
+// Reads a recording written by a ReplayWriter. The whole file is read into memory first, so
+// that replaying it is not held up by the disk.
+class ReplayReader {
+  std::string data_;
+  WorldSize world_ = DEFAULT_WORLD_SIZE;
+  uint32_t ticksPerSnapshot_ = 1;
+  uint32_t ticksPerSecond_ = FRAMES_PER_SECOND;
+  std::size_t offset_ = 0;
+  bool ok_ = false;
+
+public:
+  // Read the file at path. ok() is false if it cannot be read or is not a recording.
+  explicit ReplayReader(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+      return;
+    char chunk[1 << 16];
+    std::size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+      data_.append(chunk, n);
+    std::fclose(file);
+    BinaryReader reader(data_.data(), data_.size());
+    uint32_t magic = 0, version = 0;
+    reader >> magic >> version >> world_ >> ticksPerSnapshot_ >> ticksPerSecond_;
+    ok_ = reader.ok() && magic == REPLAY_MAGIC && version == REPLAY_VERSION && ticksPerSnapshot_ > 0 &&
+          ticksPerSecond_ > 0;
+    offset_ = reader.position() - reinterpret_cast<const uint8_t*>(data_.data());
+  }
+
+  bool ok() const { return ok_; }
+
+  const WorldSize& world() const { return world_; }
+
+  uint32_t ticksPerSnapshot() const { return ticksPerSnapshot_; }
+
+  // Rate the room ticked at.
+  uint32_t ticksPerSecond() const { return ticksPerSecond_; }
+
+  std::size_t size() const { return data_.size(); }
+
+  // Read the next record into event. Returns false at the end of the recording, or if the
+  // record is malformed, when ok() becomes false too. A recording cut off in the middle of a
+  // record, as a server that stopped may leave it, reads as ending before that record.
+  bool next(ReplayEvent& event) {
+    if (!ok_ || offset_ == data_.size())
+      return false;
+    BitReader bits(data_.data() + offset_, data_.size() - offset_);
+    event.type = static_cast<ReplayRecord>(bits.read(8));
+    switch (event.type) {
+    case ReplayRecord::Members:
+      {
+        uint32_t count = bits.readCount();
+        event.members.clear();
+        uint32_t previous = 0;
+        for (uint32_t i = 0; i < count && bits.ok(); i++) {
+          previous += bits.readVarint();
+          event.members.push_back(previous);
+        }
+      }
+      break;
+
+    case ReplayRecord::Input:
+      event.id = bits.readVarint();
+      event.input.seq = bits.readVarint();
+      event.input.tick = bits.readVarint();
+      event.input.actions = bits.read(8);
+      break;
+
+    case ReplayRecord::Ack:
+      event.id = bits.readVarint();
+      event.seq = bits.readVarint();
+      break;
+
+    case ReplayRecord::Tick:
+      break;
+
+    case ReplayRecord::Check:
+      event.tick = bits.readVarint();
+      event.hash = bits.read(32);
+      event.hash |= static_cast<uint64_t>(bits.read(32)) << 32;
+      break;
+
+    default:
+      ok_ = false;
+      return false;
+    }
+    if (!bits.ok()) {
+      offset_ = data_.size();
+      return false;
+    }
+    offset_ = data_.size() - bits.remainingBits() / 8;
+    return true;
+  }
+};
+
+#endif
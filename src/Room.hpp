@@ -0,0 +1,189 @@
+#ifndef ROOM_H
+#define ROOM_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ClientMessage.hpp"
+#include "GameMessage.hpp"
+#include "Match.hpp"
+#include "Message.hpp"
+#include "MPSCQueue.hpp"
+#include "OwnedMessage.hpp"
+#include "Replay.hpp"
+#include "Stats.hpp"
+#include "TickScheduler.hpp"
+
+// Messages a room can hold between two ticks. A room has far fewer players than the server
+// has connections, so its queue is smaller than the server's and cheap to create.
+const std::size_t ROOM_QUEUE_CAPACITY = 512;
+
+// A match with its own players (see Match), ticked on its own thread so that a busy room does
+// not hold up the others. Which connections play in the room is decided by the Lobby, which
+// also passes on their messages; the room writes its snapshots to them through the server.
+// The room ticks at the given rate, on deadlines that do not drift
+// whatever its ticks take (see TickScheduler.hpp). A room given a path records its members and
+// the messages it handles there, to be replayed later (see Replay.hpp). The room times the
+// phases of its ticks (see Stats.hpp). The room stops and joins its thread when destroyed.
+template <typename GameServer>
+class Room {
+  GameServer& server_;
+  Match match_;
+  TickRate rate_;
+  // Null if the room is not recorded.
+  std::unique_ptr<ReplayWriter> replay_;
+  // Messages from the players, pushed by the lobby and drained by the room's thread every tick.
+  MPSCQueue<OwnedMessage<ClientMessage>> incomingMsgs_{ROOM_QUEUE_CAPACITY};
+  // Written by the room's thread and read by any.
+  TickStats stats_;
+
+  // Connection IDs of the players, in ascending order, changed by the lobby and taken by the
+  // room's thread at the start of a tick.
+  std::vector<uint32_t> members_;
+  bool membersChanged_ = false;
+  bool stop_ = false;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::thread thread_;
+
+public:
+  Room(GameServer& server, uint32_t ticksPerSnapshot, const WorldSize& world, const std::string& replayPath = "",
+       const TickRate& rate = DEFAULT_TICK_RATE)
+    : server_(server), match_(ticksPerSnapshot, world, rate.ticksPerSecond), rate_(rate) {
+    if (!replayPath.empty()) {
+      replay_ = std::make_unique<ReplayWriter>(replayPath, world, ticksPerSnapshot, rate.ticksPerSecond);
+      if (!replay_->ok()) {
+        std::cout << "Cannot record the room to " << replayPath << "\n";
+        replay_.reset();
+      }
+    }
+    thread_ = std::thread([this]() { run(); });
+  }
+
+  Room(const Room&) = delete;
+  Room& operator=(const Room&) = delete;
+
+  ~Room() {
+    {
+      std::scoped_lock guard(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+
+  // Add the connection with the given ID to the room. It gets a player from the next tick on.
+  void add(uint32_t id) {
+    std::scoped_lock guard(mutex_);
+    members_.insert(std::lower_bound(members_.begin(), members_.end(), id), id);
+    membersChanged_ = true;
+  }
+
+  // Remove the connection with the given ID from the room, and return how many are left.
+  std::size_t remove(uint32_t id) {
+    std::scoped_lock guard(mutex_);
+    members_.erase(std::remove(members_.begin(), members_.end(), id), members_.end());
+    membersChanged_ = true;
+    return members_.size();
+  }
+
+  // Pass on a message from a player. Messages from connections that are not or no longer in
+  // the room when it is handled are ignored. Returns false if the room's queue is full.
+  bool push(OwnedMessage<ClientMessage> msg) { return incomingMsgs_.push(std::move(msg)); }
+
+  // Number of messages dropped because the room's queue was full.
+  uint64_t dropped() const { return incomingMsgs_.dropped(); }
+
+  // How long the room's ticks have taken so far.
+  const TickStats& stats() const { return stats_; }
+
+private:
+  void run() {
+    std::vector<uint32_t> members;
+    TickScheduler scheduler(rate_);
+    while (true) {
+      TickScheduler::Clock::time_point due = scheduler.deadline();
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (wake_.wait_until(lock, due, [this]() { return stop_; }))
+          return;
+      }
+      TickTimer timer(stats_, due);
+      {
+        std::scoped_lock guard(mutex_);
+        if (membersChanged_) {
+          members = members_;
+          membersChanged_ = false;
+          match_.setMembers(members);
+          if (replay_)
+            replay_->members(members);
+        }
+      }
+      timer.phase(TickPhase::Members);
+      tick(members, timer);
+      timer.end(scheduler.period());
+      stats_.skip(scheduler.next(TickScheduler::Clock::now()));
+    }
+  }
+
+  // Update the game according to the messages received since the last tick, advance it and
+  // send the players a snapshot, timing each phase.
+  void tick(const std::vector<uint32_t>& members, TickTimer& timer) {
+    std::size_t numMessages = incomingMsgs_.drain([&](OwnedMessage<ClientMessage>&& ownedMessage) {
+      uint32_t id = ownedMessage.id;
+      // The player may have just left, or not be in the game yet.
+      if (!std::binary_search(members.begin(), members.end(), id))
+        return;
+      switch (ownedMessage.msg.header.messageId) {
+      case ClientMessage::Input:
+        {
+          PlayerInput input;
+          if (ownedMessage.msg.getData(input)) {
+            match_.input(id, input);
+            if (replay_)
+              replay_->input(id, input);
+          }
+        }
+        break;
+
+      case ClientMessage::SnapshotAck:
+        {
+          uint32_t seq;
+          if (ownedMessage.msg.getData(seq)) {
+            match_.ack(id, seq);
+            if (replay_)
+              replay_->ack(id, seq);
+          }
+        }
+        break;
+
+      case ClientMessage::Join:
+        break;
+      }
+    });
+    stats_.messages(numMessages);
+    timer.phase(TickPhase::Messages);
+
+    const std::vector<uint32_t>& idsToRemove = match_.tick([&](uint32_t id) { server_.disconnect(id); });
+    timer.phase(TickPhase::Simulate);
+    if (replay_)
+      replay_->tick(match_.game());
+    timer.phase(TickPhase::Record);
+
+    if (!idsToRemove.empty())
+      server_.disconnectFrom(idsToRemove);
+
+    if (match_.snapshot())
+      server_.writeToEach(members, [&](uint32_t id) { return match_.frameFor(id); });
+    timer.phase(TickPhase::Snapshot);
+  }
+};
+
+#endif
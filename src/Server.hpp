@@ -1,7 +1,10 @@
 #ifndef SERVER_H
 #define SERVER_H
 
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <set>
 #include <queue>
 
@@ -11,9 +14,14 @@
 #include "Message.hpp"
 #include "Player.hpp"
 #include "Game.hpp"
-#include "TSQueue.hpp"
+#include "MPSCQueue.hpp"
+#include "WakeSignal.hpp"
 
-// Class of a single-threaded server that can be connected to multiple clients.
+// Class of a server that can be connected to multiple clients.
+// The io context may be run by any number of threads (see IoThreadPool); each connection
+// handles its own reads and writes on its strand, and the list of connections is shared
+// between the io threads accepting connections and the game loop under a mutex. The game loop
+// can wait for messages and connections to come or go with waitForActivity().
 template <typename InMsgType, typename OutMsgType>
 class Server {
   // For giving IDs to connections.
@@ -25,7 +33,15 @@ class Server {
   
   // The server's connections to clients.
   std::vector<std::shared_ptr<Connection<InMsgType, OutMsgType>>> connections_;
-  TSQueue<OwnedMessage<InMsgType>> incomingMsgs_;
+  std::mutex connectionsMutex_;
+  // Number of times a connection was added to or removed from connections_, counted under the mutex.
+  std::atomic<uint64_t> connectionChanges_{0};
+  // Messages from all connections, pushed by the io thread and drained by the game loop.
+  MPSCQueue<OwnedMessage<InMsgType>> incomingMsgs_;
+  // Notified after every message pushed and every change to the connections.
+  WakeSignal activity_;
+  // Bytes and messages of all connections, added by the io threads.
+  TrafficCounters traffic_;
   
 public:
   // Server needs a work context and which port to be reachable from.
@@ -36,23 +52,47 @@ public:
   }
 
   int numConnections() {
+    std::scoped_lock guard(connectionsMutex_);
     return connections_.size();
   }
 
+  // Number of times a connection has come or gone. The IDs of the connections are worth
+  // getting again when it changes.
+  uint64_t connectionChanges() const { return connectionChanges_.load(std::memory_order_acquire); }
+
+  // Wait until a message has been received or a connection has come or gone since the last
+  // call, or until the deadline.
+  template <typename TimePoint>
+  void waitForActivity(const TimePoint& deadline) { activity_.waitUntil(deadline); }
+
   // Get IDs of the connections. Used for syncing number of players in the game.
   std::vector<uint32_t> getIDs() {
+    std::scoped_lock guard(connectionsMutex_);
     std::vector<uint32_t> ids;
     for (auto& connection : connections_)
       ids.push_back(connection->getID());
     return ids;
   }
   
-  TSQueue<OwnedMessage<InMsgType>>& getIncomingMsgs()
+  // Counters of the send queue of each connection, by ID.
+  std::map<uint32_t, SendQueueStats> sendQueueStats() {
+    std::scoped_lock guard(connectionsMutex_);
+    std::map<uint32_t, SendQueueStats> stats;
+    for (auto& connection : connections_)
+      stats[connection->getID()] = connection->sendQueueStats();
+    return stats;
+  }
+
+  // Bytes and messages received from and sent to all clients so far.
+  const TrafficCounters& traffic() const { return traffic_; }
+
+  MPSCQueue<OwnedMessage<InMsgType>>& getIncomingMsgs()
   {
     return incomingMsgs_;
   }
 
   void disconnectFrom(std::vector<uint32_t> ids) {
+    std::scoped_lock guard(connectionsMutex_);
     for (auto& connection : connections_) {
       if (std::find(ids.begin(), ids.end(), connection->getID()) != ids.end()) {
         connection->disconnect();
@@ -60,15 +100,28 @@ public:
       }
     }
     connections_.erase(std::remove(connections_.begin(), connections_.end(),  nullptr), connections_.end());
+    connectionsChanged();
   }
   
-  // Write a message to all connected clients.
+  // Write a message to all connected clients. The message is encoded once and the frame is
+  // shared by all connections.
   void writeToAll(Message<OutMsgType> msg) {
+    FramePtr<OutMsgType> frame = makeFrame(std::move(msg));
+    writeToEach([&frame](uint32_t /* id */) { return frame; });
+  }
+
+  // Write a frame to each connected client, where makeFrame(id) gives the frame for the
+  // client with the given connection ID, or null for none. Clients given the same frame share it.
+  template <typename MakeFrame>
+  void writeToEach(MakeFrame makeFrame) {
     //std::cout << "begin\n";
+    std::scoped_lock guard(connectionsMutex_);
     bool invalidClients = false;
     for (auto& connection : connections_) {
       if (connection->isConnected()) {
-        connection->write(msg);
+        FramePtr<OutMsgType> frame(makeFrame(connection->getID()));
+        if (frame)
+          connection->write(std::move(frame));
       }
       else  {
         //std::cout << "Connection with ID " << connection->getID() << "is invalid\n";
@@ -80,6 +133,7 @@ public:
     // Remove disconnected clients, if any
     if (invalidClients) {
       connections_.erase(std::remove(connections_.begin(), connections_.end(),  nullptr), connections_.end());
+      connectionsChanged();
       //std::cout << "new num connections: " << connections_.size() << "\n";
     }
     // The call to std::remove shifts all non-null connections to the beginning and returns an iterator
@@ -87,8 +141,29 @@ public:
     // and the end, eliminating all null connections.
   }
 
+  // Write a frame to each of the connected clients with the given IDs, in ascending order,
+  // where makeFrame(id) gives the frame for the client. Clients of other IDs are skipped.
+  template <typename MakeFrame>
+  void writeToEach(const std::vector<uint32_t>& ids, MakeFrame makeFrame) {
+    writeToEach([&ids, &makeFrame](uint32_t id) {
+        return std::binary_search(ids.begin(), ids.end(), id) ? FramePtr<OutMsgType>(makeFrame(id)) : nullptr;
+      });
+  }
+
+  // Write a message to the client with the given ID, if it is connected.
+  void writeTo(uint32_t id, Message<OutMsgType> msg) {
+    std::scoped_lock guard(connectionsMutex_);
+    for (auto& connection : connections_) {
+      if (connection->getID() == id && connection->isConnected()) {
+        connection->write(std::move(msg));
+        break;
+      }
+    }
+  }
+
   // Disconnect from client with the given id.
   void disconnect(uint32_t id) {
+    std::scoped_lock guard(connectionsMutex_);
     for (auto& connection : connections_) {
       if (connection->getID() == id) {
         connection->disconnect();
@@ -97,19 +172,26 @@ public:
                                           [id](std::shared_ptr<Connection<InMsgType, OutMsgType>> c)
                                           { return c->getID() == id; }),
                            connections_.end());
+        connectionsChanged();
         break;
       }
     }
   }
   
 private:
+  // Count a change to connections_, with connectionsMutex_ held, and wake the game loop.
+  void connectionsChanged() {
+    connectionChanges_++;
+    activity_.notify();
+  }
 
   // Listen for clients that are trying to connect.
   void listenForConnections() {
     // The next connection to be accepted, which takes the io context as argument
     // so it can create a socket that is listened to.
     std::shared_ptr<Connection<InMsgType, OutMsgType>> connection =
-      std::make_shared<Connection<InMsgType, OutMsgType>>(ioContext_, incomingMsgs_, ConnectionOwner::Server);
+      std::make_shared<Connection<InMsgType, OutMsgType>>(ioContext_, incomingMsgs_, ConnectionOwner::Server,
+                                                          &traffic_, &activity_);
 
     // The acceptor accepts connections that connect to the given port.
     // When a connection is established via the socket, the handler is called.
@@ -117,7 +199,9 @@ private:
         if (!ec) {
           std::cout << "[Client connected] " << connection->socket().remote_endpoint() << ". ID: " << id_ << "\n";
           connection->connectToClient(id_++); // Give connection an ID and start reading messages
+          std::scoped_lock guard(connectionsMutex_);
           connections_.push_back(std::move(connection));
+          connectionsChanged();
         }
         else
           {
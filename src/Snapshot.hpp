@@ -0,0 +1,441 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <array>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "AreaOfInterest.hpp"
+#include "Arena.hpp"
+#include "Camera.hpp"
+#include "Codec.hpp"
+#include "Game.hpp"
+#include "GameMessage.hpp"
+#include "Message.hpp"
+#include "SnapshotCodec.hpp"
+
+// Microseconds since the epoch on the system clock. Snapshots are stamped with the time they
+// were taken, so that clients on the same machine, or with synchronized clocks, can tell
+// how long a snapshot took to reach them.
+uint64_t systemTimeUs() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+// Number of snapshots kept for delta compression, on the server as well as on the client.
+// A client whose last acknowledgement is older than this gets a keyframe.
+const uint32_t SNAPSHOT_HISTORY_SIZE = 32;
+
+// Encodes and applies the difference between two game states.
+// Bullets fly in a straight line from where they were fired, so they are sent as events: a
+// spawn when a bullet first appears to a client, carrying its origin, angle and tick, and a
+// despawn with the reason when it is gone. Clients work out where the bullets are from their
+// spawns; no bullet position is ever sent, so a delta grows with the rate of fire, not with the
+// number of bullets in flight. The server alone decides what the bullets hit.
+// The states need not be consecutive ticks; the server may send a snapshot every few ticks.
+// Deltas are packed into bits like keyframes, see SnapshotCodec.
+class GameDelta {
+  // Which fields of a player follow in a delta.
+  enum Field : uint8_t { Pos = 1, Angle = 2, LastInput = 4 };
+  static const int NUM_FIELD_BITS = 3;
+  // Bits of a despawn reason, which are all four the bits can hold.
+  static const int NUM_REASON_BITS = 2;
+  static_assert(static_cast<int>(DespawnReason::LeftView) == (1 << NUM_REASON_BITS) - 1);
+
+public:
+  // Write the changes from base to current, which is a later state of the same game. The
+  // lists of changes are made in the writer's scratch memory. If current is a client's view of
+  // a game, interest must have been built from that game; it tells the bullets that only left
+  // the view from those that are gone.
+  static void encode(const Game& base, const Game& current, BitWriter& bits,
+                     const AreaOfInterest* interest = nullptr) {
+    std::pmr::memory_resource* scratch = bits.scratch();
+    Quantization q(current.world_);
+    std::pmr::vector<uint32_t> removed(scratch);
+    for (auto& [id, _] : base.players_) {
+      if (current.players_.find(id) == current.players_.end())
+        removed.push_back(id);
+    }
+    std::pmr::map<uint32_t, Player> added(scratch);
+    std::pmr::vector<uint32_t> changed(scratch);
+    for (auto& [id, player] : current.players_) {
+      auto found = base.players_.find(id);
+      if (found == base.players_.end())
+        added.insert({id, player});
+      else if (fieldsChanged(found->second, player) != 0)
+        changed.push_back(id);
+    }
+
+    bits.writeVarint(current.tick_ - base.tick_);
+    bits.writeVarint(removed.size());
+    uint32_t previous = 0;
+    for (uint32_t id : removed)
+      SnapshotCodec::writeID(bits, id, previous);
+    SnapshotCodec::writePlayers(bits, added, q);
+    bits.writeVarint(changed.size());
+    previous = 0;
+    for (uint32_t id : changed) {
+      const Player& before = base.players_.at(id);
+      const Player& after = current.players_.at(id);
+      uint8_t fields = fieldsChanged(before, after);
+      SnapshotCodec::writeID(bits, id, previous);
+      bits.write(fields, NUM_FIELD_BITS);
+      if (fields & Pos)
+        q.writePos(bits, after.pos_);
+      if (fields & Angle)
+        q.writeAngle(bits, after.angle_);
+      if (fields & LastInput)
+        bits.writeSigned(after.lastInputSeq_ - before.lastInputSeq_);
+    }
+
+    std::pmr::vector<BulletDespawn> despawned(scratch);
+    std::pmr::vector<BulletSpawn> spawned(scratch);
+    diffBullets(base, current, interest, despawned, spawned);
+    bits.writeVarint(despawned.size());
+    previous = 0;
+    for (const BulletDespawn& d : despawned) {
+      SnapshotCodec::writeID(bits, d.id, previous);
+      bits.write(static_cast<uint32_t>(d.reason), NUM_REASON_BITS);
+    }
+    bits.writeVarint(spawned.size());
+    previous = 0;
+    for (const BulletSpawn& spawn : spawned) {
+      SnapshotCodec::writeID(bits, spawn.id, previous);
+      SnapshotCodec::writeSpawn(bits, spawn, current.tick_, q);
+    }
+  }
+
+  // Turn game, which must hold the base state, into the state described by the delta.
+  // Returns false if the delta is malformed. The bullets that are gone are put in despawned.
+  static bool apply(Game& game, BitReader& bits, std::vector<BulletDespawn>& despawned) {
+    Quantization q(game.world_);
+    uint32_t ticks = bits.readVarint();
+    game.tick_ += ticks;
+
+    // Only the players are removed; the bullets that are gone are listed below. A player can
+    // leave a client's area of interest while its bullets are still in it.
+    uint32_t numRemoved = bits.readCount();
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < numRemoved && bits.ok(); i++)
+      game.players_.erase(SnapshotCodec::readID(bits, previous));
+    SnapshotCodec::readPlayers(bits, game.players_, q);
+    uint32_t numChanged = bits.readCount();
+    previous = 0;
+    for (uint32_t i = 0; i < numChanged && bits.ok(); i++) {
+      uint32_t id = SnapshotCodec::readID(bits, previous);
+      uint8_t fields = bits.read(NUM_FIELD_BITS);
+      auto found = game.players_.find(id);
+      if (found == game.players_.end())
+        return false;
+      Player& player = found->second;
+      if (fields & Pos)
+        player.pos_ = q.readPos(bits);
+      if (fields & Angle)
+        player.angle_ = q.readAngle(bits);
+      if (fields & LastInput)
+        player.lastInputSeq_ += bits.readSigned();
+    }
+
+    uint32_t numDespawned = bits.readCount();
+    despawned.clear();
+    previous = 0;
+    for (uint32_t i = 0; i < numDespawned && bits.ok(); i++) {
+      uint32_t id = SnapshotCodec::readID(bits, previous);
+      despawned.push_back({id, static_cast<DespawnReason>(bits.read(NUM_REASON_BITS))});
+    }
+    if (!bits.ok())
+      return false;
+    // Despawns are sorted by ID, so bullets can be looked up with a binary search.
+    BulletPool& bullets = game.bullets_;
+    bullets.removeIf([&](std::size_t i) {
+      auto found = std::lower_bound(despawned.begin(), despawned.end(), bullets.ids()[i],
+                                    [](const BulletDespawn& d, uint32_t id) { return d.id < id; });
+      return found != despawned.end() && found->id == bullets.ids()[i];
+    });
+    bullets.moveTo(game.tick_, game.ticksPerSecond_);
+    uint32_t numSpawned = bits.readCount();
+    previous = 0;
+    for (uint32_t i = 0; i < numSpawned && bits.ok(); i++) {
+      uint32_t id = SnapshotCodec::readID(bits, previous);
+      bullets.add(SnapshotCodec::readSpawn(bits, id, game.tick_, q), game.tick_, game.ticksPerSecond_);
+    }
+    return bits.ok();
+  }
+
+private:
+  static uint8_t fieldsChanged(const Player& before, const Player& after) {
+    uint8_t fields = 0;
+    if (before.pos_.x != after.pos_.x || before.pos_.y != after.pos_.y)
+      fields |= Pos;
+    if (before.angle_ != after.angle_)
+      fields |= Angle;
+    if (before.lastInputSeq_ != after.lastInputSeq_)
+      fields |= LastInput;
+    return fields;
+  }
+
+  // Find the bullets despawned and spawned between two states, both sorted by bullet ID.
+  static void diffBullets(const Game& base, const Game& current, const AreaOfInterest* interest,
+                          std::pmr::vector<BulletDespawn>& despawned, std::pmr::vector<BulletSpawn>& spawned) {
+    const BulletPool& before = base.bullets_;
+    const BulletPool& after = current.bullets_;
+    std::pmr::vector<uint32_t> b = before.byID(despawned.get_allocator().resource());
+    std::pmr::vector<uint32_t> a = after.byID(despawned.get_allocator().resource());
+    std::size_t bi = 0;
+    std::size_t ai = 0;
+    while (bi < b.size() || ai < a.size()) {
+      if (ai == a.size() || (bi < b.size() && before.ids()[b[bi]] < after.ids()[a[ai]])) {
+        despawned.push_back({before.ids()[b[bi]], despawnReason(before.spawn(b[bi]), current, interest)});
+        bi++;
+      } else if (bi == b.size() || after.ids()[a[ai]] < before.ids()[b[bi]]) {
+        spawned.push_back(after.spawn(a[ai]));
+        ai++;
+      } else {
+        ai++;
+        bi++;
+      }
+    }
+  }
+
+  // Why the bullet of the given spawn is not in current. The reason is told from the state of
+  // the game rather than recorded when the bullet is removed: a bullet that has flown out of
+  // the world stays out of it, and a player who is gone, even if a player with the same ID has
+  // joined since, takes its bullets along. A bullet that hit a player just before it would have
+  // left the world, or as its owner was killed, is reported as having left the world, or with
+  // its owner.
+  static DespawnReason despawnReason(const BulletSpawn& spawn, const Game& current, const AreaOfInterest* interest) {
+    if (interest && interest->hasBullet(spawn.id))
+      return DespawnReason::LeftView;
+    // Bullets are removed the tick after the one they are out of the world at.
+    Point pos = spawn.at(current.tick_ - 1, current.ticksPerSecond_).getPos();
+    if (pos.x < 0 || pos.x > current.world_.width || pos.y < 0 || pos.y > current.world_.height)
+      return DespawnReason::LeftWorld;
+    const Game& game = interest ? interest->game() : current;
+    if (!game.hasShooter(spawn.owner, spawn.tick))
+      return DespawnReason::OwnerGone;
+    return DespawnReason::HitPlayer;
+  }
+};
+
+// Server side history of the snapshots sent to clients and of what each client has acknowledged.
+// Each client gets a delta against the latest snapshot it acknowledged, or a keyframe if it has
+// not acknowledged any snapshot that is still in the history.
+// In a world larger than the window, each client is only sent its area of interest (see
+// AreaOfInterest), and the views sent to each client are kept for each client. Otherwise all
+// clients are sent the whole game and clients that acknowledged the same snapshot share a frame.
+class SnapshotHistory {
+  std::array<Game, SNAPSHOT_HISTORY_SIZE> snapshots_;
+  std::array<uint32_t, SNAPSHOT_HISTORY_SIZE> seqs_ = {};
+  // Sequence number of the latest snapshot. Zero means no snapshot.
+  uint32_t seq_ = 0;
+  // When the latest snapshot was taken.
+  uint64_t timeUs_ = 0;
+  // Latest acknowledged sequence number of each client, by connection ID.
+  std::map<uint32_t, uint32_t> acks_;
+  // Frames encoded for the latest snapshot, with the sequence number they are based on
+  // (zero for the keyframe). Clients with the same base share one frame.
+  std::vector<std::pair<uint32_t, FramePtr<GameMessage>>> frames_;
+  // Storage of the frames, and scratch memory for encoding them, reset with every snapshot.
+  // Once both have grown to what a snapshot needs, making frames allocates nothing.
+  FramePool<GameMessage> framePool_;
+  TickArena scratch_;
+
+  // Views of the snapshots sent to one client, when clients are sent their area of interest.
+  struct Views {
+    std::array<Game, SNAPSHOT_HISTORY_SIZE> games;
+    std::array<uint32_t, SNAPSHOT_HISTORY_SIZE> seqs = {};
+  };
+  std::unique_ptr<AreaOfInterest> interest_;
+  std::map<uint32_t, Views> views_;
+
+public:
+  // History for a game in a world of the given size. Unless filter is false, clients are only
+  // sent their area of interest if the world is larger than the window.
+  explicit SnapshotHistory(const WorldSize& world = DEFAULT_WORLD_SIZE, bool filter = true) {
+    if (filter && !cameraShowsWorld(world))
+      interest_ = std::make_unique<AreaOfInterest>(world);
+    // One frame per base at most: a keyframe and a delta against each snapshot kept.
+    frames_.reserve(SNAPSHOT_HISTORY_SIZE + 1);
+  }
+
+  // Whether clients are sent only their area of interest.
+  bool filtered() const { return interest_ != nullptr; }
+
+  // Store a new snapshot and return its sequence number.
+  uint32_t push(const Game& game) {
+    seq_++;
+    timeUs_ = systemTimeUs();
+    snapshots_[seq_ % SNAPSHOT_HISTORY_SIZE].copyState(game);
+    seqs_[seq_ % SNAPSHOT_HISTORY_SIZE] = seq_;
+    frames_.clear();
+    scratch_.reset();
+    if (interest_)
+      interest_->build(snapshots_[seq_ % SNAPSHOT_HISTORY_SIZE]);
+    return seq_;
+  }
+
+  // Record that a client has received the snapshot with the given sequence number.
+  void ack(uint32_t id, uint32_t seq) {
+    if (seq > seq_)
+      return;
+    uint32_t& acked = acks_[id];
+    if (seq > acked)
+      acked = seq;
+  }
+
+  // Forget the acknowledgements of clients that are no longer connected.
+  void retain(const std::vector<uint32_t>& ids) {
+    for (auto it = acks_.begin(); it != acks_.end();) {
+      if (std::find(ids.begin(), ids.end(), it->first) == ids.end())
+        it = acks_.erase(it);
+      else
+        ++it;
+    }
+    for (auto it = views_.begin(); it != views_.end();) {
+      if (std::find(ids.begin(), ids.end(), it->first) == ids.end())
+        it = views_.erase(it);
+      else
+        ++it;
+    }
+    if (interest_)
+      interest_->retain(ids);
+  }
+
+  // The frame that brings the client with the given ID up to date with the latest snapshot.
+  FramePtr<GameMessage> frameFor(uint32_t id) {
+    if (interest_)
+      return viewFrameFor(id);
+    uint32_t baseSeq = 0;
+    auto found = acks_.find(id);
+    if (found != acks_.end() && find(found->second))
+      baseSeq = found->second;
+
+    for (auto& [seq, frame] : frames_) {
+      if (seq == baseSeq)
+        return frame;
+    }
+    frames_.push_back({baseSeq, encode(*find(seq_), baseSeq == 0 ? nullptr : find(baseSeq), baseSeq)});
+    return frames_.back().second;
+  }
+
+private:
+  // The frame of the client's view of the latest snapshot, as a delta against its view of the
+  // latest snapshot it acknowledged.
+  FramePtr<GameMessage> viewFrameFor(uint32_t id) {
+    Views& views = views_[id];
+    Game& current = views.games[seq_ % SNAPSHOT_HISTORY_SIZE];
+    interest_->view(*find(seq_), id, current);
+    views.seqs[seq_ % SNAPSHOT_HISTORY_SIZE] = seq_;
+
+    uint32_t baseSeq = 0;
+    auto found = acks_.find(id);
+    if (found != acks_.end() && found->second != 0 &&
+        views.seqs[found->second % SNAPSHOT_HISTORY_SIZE] == found->second)
+      baseSeq = found->second;
+
+    return encode(current, baseSeq == 0 ? nullptr : &views.games[baseSeq % SNAPSHOT_HISTORY_SIZE], baseSeq,
+                  interest_.get());
+  }
+
+  // Encode current as a keyframe if base is null, or else as a delta against base, the
+  // snapshot with sequence number baseSeq. interest is given if current is a view.
+  FramePtr<GameMessage> encode(const Game& current, const Game* base, uint32_t baseSeq,
+                               const AreaOfInterest* interest = nullptr) {
+    if (!base) {
+      return framePool_.make(GameMessage::GameState, &scratch_, [&](BinaryWriter& writer) {
+          writer << seq_ << timeUs_;
+          BitWriter bits(writer);
+          SnapshotCodec::writeGame(bits, current);
+        });
+    }
+    return framePool_.make(GameMessage::GameStateDelta, &scratch_, [&](BinaryWriter& writer) {
+        writer << seq_ << timeUs_ << baseSeq;
+        BitWriter bits(writer);
+        GameDelta::encode(*base, current, bits, interest);
+      });
+  }
+
+  const Game* find(uint32_t seq) const {
+    if (seq == 0 || seqs_[seq % SNAPSHOT_HISTORY_SIZE] != seq)
+      return nullptr;
+    return &snapshots_[seq % SNAPSHOT_HISTORY_SIZE];
+  }
+};
+
+// Client side reconstruction of game states from keyframes and deltas.
+class SnapshotReceiver {
+  std::array<Game, SNAPSHOT_HISTORY_SIZE> snapshots_;
+  std::array<uint32_t, SNAPSHOT_HISTORY_SIZE> seqs_ = {};
+  uint32_t latestSeq_ = 0;
+  uint64_t latestTimeUs_ = 0;
+  // Bullets gone since the previous game state, for the latest one.
+  std::vector<BulletDespawn> despawned_;
+
+public:
+  // Rebuild the game state carried by a message. Returns false if the message is malformed
+  // or based on a snapshot that is no longer known, in which case it should not be acknowledged.
+  bool receive(const Message<GameMessage>& msg) {
+    BinaryReader reader(msg.body.data(), msg.body.size());
+    uint32_t seq = 0;
+    uint64_t timeUs = 0;
+    reader >> seq >> timeUs;
+    if (!reader.ok() || seq <= latestSeq_)
+      return false;
+
+    Game& game = snapshots_[seq % SNAPSHOT_HISTORY_SIZE];
+    seqs_[seq % SNAPSHOT_HISTORY_SIZE] = 0; // Invalid until fully decoded.
+    switch (msg.header.messageId) {
+    case GameMessage::GameState:
+      {
+        BitReader bits(reader);
+        if (!SnapshotCodec::readGame(bits, game))
+          return false;
+      }
+      despawned_.clear();
+      break;
+
+    case GameMessage::GameStateDelta:
+      {
+        uint32_t baseSeq = 0;
+        reader >> baseSeq;
+        if (!reader.ok() || baseSeq >= seq || seqs_[baseSeq % SNAPSHOT_HISTORY_SIZE] != baseSeq)
+          return false;
+        game = snapshots_[baseSeq % SNAPSHOT_HISTORY_SIZE];
+        BitReader bits(reader);
+        if (!GameDelta::apply(game, bits, despawned_))
+          return false;
+      }
+      break;
+
+    default:
+      return false;
+    }
+    seqs_[seq % SNAPSHOT_HISTORY_SIZE] = seq;
+    latestSeq_ = seq;
+    latestTimeUs_ = timeUs;
+    return true;
+  }
+
+  // The rate the server's game ticks at, as told by its welcome, which snapshots do not carry.
+  // Set before the first snapshot is received.
+  void setTicksPerSecond(uint32_t ticksPerSecond) {
+    for (Game& game : snapshots_)
+      game.setTicksPerSecond(ticksPerSecond);
+  }
+
+  // Sequence number of the latest game state received, to be acknowledged to the server.
+  uint32_t latestSeq() const { return latestSeq_; }
+
+  const Game& latest() const { return snapshots_[latestSeq_ % SNAPSHOT_HISTORY_SIZE]; }
+
+  // When the server took the latest game state, see systemTimeUs().
+  uint64_t latestTimeUs() const { return latestTimeUs_; }
+
+  // The bullets that are gone from the latest game state and why, compared with the state it
+  // was based on. Empty after a keyframe.
+  const std::vector<BulletDespawn>& latestDespawns() const { return despawned_; }
+};
+
+#endif
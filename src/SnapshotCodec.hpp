@@ -0,0 +1,151 @@
+#ifndef SNAPSHOT_CODEC_H
+#define SNAPSHOT_CODEC_H
+
+#include <algorithm>
+#include <map>
+
+#include "BitPacking.hpp"
+#include "Game.hpp"
+
+// How positions and angles are packed in snapshots. Positions are whole units within the world
+// and take as many bits as its size does: 10 bits for each coordinate in a world of 1000 x 1000.
+// Angles are sent as one of angleSteps steps per turn. Server and clients both know the size of
+// the world from the game state and use ANGLE_STEPS, so they pack and unpack the same way.
+struct Quantization {
+  WorldSize world;
+  uint32_t angleSteps;
+  int xBits;
+  int yBits;
+  int angleBits;
+
+  explicit Quantization(const WorldSize& world, uint32_t angleSteps = ANGLE_STEPS)
+    : world(world), angleSteps(angleSteps), xBits(bitsFor(std::max(world.width, 0))),
+      yBits(bitsFor(std::max(world.height, 0))), angleBits(bitsFor(angleSteps - 1)) {}
+
+  // Positions outside the world are moved to its edge.
+  void writePos(BitWriter& bits, Point pos) const {
+    bits.write(std::clamp(pos.x, 0, world.width), xBits);
+    bits.write(std::clamp(pos.y, 0, world.height), yBits);
+  }
+
+  Point readPos(BitReader& bits) const {
+    int x = bits.read(xBits);
+    int y = bits.read(yBits);
+    return {x, y};
+  }
+
+  void writeAngle(BitWriter& bits, double angle) const {
+    bits.write(std::lround(wrapAngle(angle) * angleSteps / 360.0) % angleSteps, angleBits);
+  }
+
+  double readAngle(BitReader& bits) const { return bits.read(angleBits) * 360.0 / angleSteps; }
+};
+
+// Packs the players and bullets of snapshots, keyframes as well as deltas (see GameDelta).
+// Lists of entities are sorted by ID and each ID is written as the difference from the one
+// before it, so most take a byte. Bullets are written as their spawns, with the tick they were
+// fired at as the number of ticks before the snapshot. A player's ID and a bullet's ID are
+// written by the list they are in; the functions for single entities leave them out.
+class SnapshotCodec {
+public:
+  // Write the whole state of a game, as sent in keyframes.
+  static void writeGame(BitWriter& bits, const Game& game) {
+    bits.writeVarint(game.tick_);
+    bits.writeVarint(game.world_.width);
+    bits.writeVarint(game.world_.height);
+    Quantization q(game.world_);
+    writePlayers(bits, game.players_, q);
+    const BulletPool& bullets = game.bullets_;
+    std::pmr::vector<uint32_t> order = bullets.byID(bits.scratch());
+    bits.writeVarint(order.size());
+    uint32_t previous = 0;
+    for (uint32_t i : order) {
+      writeID(bits, bullets.ids()[i], previous);
+      writeSpawn(bits, bullets.spawn(i), game.tick_, q);
+    }
+  }
+
+  // Read the state written by writeGame() into game. Returns false if it is malformed.
+  static bool readGame(BitReader& bits, Game& game) {
+    game.tick_ = bits.readVarint();
+    game.world_.width = bits.readVarint();
+    game.world_.height = bits.readVarint();
+    Quantization q(game.world_);
+    game.players_.clear();
+    readPlayers(bits, game.players_, q);
+    game.bullets_.clear();
+    uint32_t numBullets = bits.readCount();
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < numBullets && bits.ok(); i++) {
+      BulletSpawn spawn = readSpawn(bits, readID(bits, previous), game.tick_, q);
+      game.bullets_.add(spawn, game.tick_, game.ticksPerSecond_);
+    }
+    return bits.ok();
+  }
+
+  // A list of players by ID.
+  template <typename Players>
+  static void writePlayers(BitWriter& bits, const Players& players, const Quantization& q) {
+    bits.writeVarint(players.size());
+    uint32_t previous = 0;
+    for (auto& [id, player] : players) {
+      writeID(bits, id, previous);
+      writePlayer(bits, player, q);
+    }
+  }
+
+  // Read a list of players written by writePlayers() into players, replacing those with the same IDs.
+  static void readPlayers(BitReader& bits, std::map<uint32_t, Player>& players, const Quantization& q) {
+    uint32_t count = bits.readCount();
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < count && bits.ok(); i++) {
+      uint32_t id = readID(bits, previous);
+      players.insert_or_assign(id, readPlayer(bits, id, q));
+    }
+  }
+
+  static void writePlayer(BitWriter& bits, const Player& player, const Quantization& q) {
+    q.writePos(bits, player.pos_);
+    q.writeAngle(bits, player.angle_);
+    bits.writeVarint(player.lastInputSeq_);
+  }
+
+  static Player readPlayer(BitReader& bits, uint32_t id, const Quantization& q) {
+    Point pos = q.readPos(bits);
+    Player player(pos.x, pos.y, id);
+    player.angle_ = q.readAngle(bits);
+    player.lastInputSeq_ = bits.readVarint();
+    return player;
+  }
+
+  // The spawn of a bullet in a snapshot of the given tick.
+  static void writeSpawn(BitWriter& bits, const BulletSpawn& spawn, uint32_t tick, const Quantization& q) {
+    bits.writeVarint(spawn.owner);
+    q.writePos(bits, spawn.origin);
+    q.writeAngle(bits, spawn.angle);
+    bits.writeVarint(tick - spawn.tick);
+  }
+
+  static BulletSpawn readSpawn(BitReader& bits, uint32_t id, uint32_t tick, const Quantization& q) {
+    BulletSpawn spawn;
+    spawn.id = id;
+    spawn.owner = bits.readVarint();
+    spawn.origin = q.readPos(bits);
+    spawn.angle = q.readAngle(bits);
+    spawn.tick = tick - bits.readVarint();
+    return spawn;
+  }
+
+  // An ID in a list sorted by ID, after the given previous one, which is then updated.
+  static void writeID(BitWriter& bits, uint32_t id, uint32_t& previous) {
+    bits.writeVarint(id - previous);
+    previous = id;
+  }
+
+  static uint32_t readID(BitReader& bits, uint32_t& previous) {
+    previous += bits.readVarint();
+    return previous;
+  }
+};
+
+#endif
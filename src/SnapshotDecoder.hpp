@@ -0,0 +1,168 @@
+#ifndef SNAPSHOT_DECODER_H
+#define SNAPSHOT_DECODER_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "ClientMessage.hpp"
+#include "Codec.hpp"
+#include "Game.hpp"
+#include "GameMessage.hpp"
+#include "Message.hpp"
+#include "OwnedMessage.hpp"
+#include "Snapshot.hpp"
+#include "TripleBuffer.hpp"
+
+// A game state decoded from a snapshot, with the time its message was taken from the queue, in
+// milliseconds on the steady clock like GameController::nowMs().
+struct DecodedSnapshot {
+  Game game;
+  uint32_t seq = 0;
+  double arrivalMs = 0;
+};
+
+// Decodes the snapshots a client receives on a thread of its own and hands the newest to the
+// render thread through a TripleBuffer, so that drawing never waits for decoding. Of the
+// snapshots that arrived since it last looked, only the one with the highest sequence number
+// is decoded and acknowledged: the server sends deltas against acknowledged snapshots only,
+// which the decoder has, so the ones skipped are never needed. After a hiccup the client thus
+// decodes and draws one snapshot, the newest, instead of a backlog of stale ones.
+// The decoder also answers the server's welcome by joining the room, and decodes the snapshots
+// at the tick rate the welcome tells. GameClient is the client of either transport; only the
+// decoder takes messages from its queue.
+template <typename GameClient>
+class SnapshotDecoder {
+  GameClient& client_;
+  uint32_t room_;
+  SnapshotReceiver snapshots_;
+  TripleBuffer<DecodedSnapshot> latest_;
+  // The newest snapshot of the messages taken, if any.
+  Message<GameMessage> newest_;
+  bool hasNewest_ = false;
+  uint32_t newestSeq_ = 0;
+  // What the server told us when it welcomed us.
+  std::atomic<uint32_t> playerId_{0};
+  std::atomic<uint32_t> ticksPerSecond_{0};
+  std::atomic<bool> welcomed_{false};
+  // Snapshots decoded, and snapshots skipped because a newer one had arrived.
+  std::atomic<uint64_t> decoded_{0};
+  std::atomic<uint64_t> skipped_{0};
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+
+public:
+  // Join the given room once welcomed.
+  SnapshotDecoder(GameClient& client, uint32_t room) : client_(client), room_(room) {}
+
+  SnapshotDecoder(const SnapshotDecoder&) = delete;
+  SnapshotDecoder& operator=(const SnapshotDecoder&) = delete;
+
+  ~SnapshotDecoder() { stop(); }
+
+  // Decode on a thread of its own until stopped, looking for messages every millisecond.
+  void start() {
+    thread_ = std::thread([this]() {
+        while (!stop_) {
+          poll();
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      });
+  }
+
+  void stop() {
+    stop_ = true;
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+  // Take the messages received so far, and decode, acknowledge and publish the newest
+  // snapshot among them. Returns whether one was published. Called by the decoder's thread,
+  // or instead of it without start().
+  bool poll() {
+    using namespace std::chrono;
+    double nowMs = duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+    client_.getIncomingMsgs().drain([&](OwnedMessage<GameMessage>&& ownedMsg) { take(ownedMsg.msg); });
+    if (!hasNewest_)
+      return false;
+    hasNewest_ = false;
+    if (!snapshots_.receive(newest_))
+      return false;
+    decoded_.fetch_add(1, std::memory_order_relaxed);
+    acknowledge(snapshots_.latestSeq());
+    DecodedSnapshot& snapshot = latest_.back();
+    snapshot.game.copyState(snapshots_.latest());
+    snapshot.seq = snapshots_.latestSeq();
+    snapshot.arrivalMs = nowMs;
+    latest_.publish();
+    return true;
+  }
+
+  // The ID of the local player and the server's tick rate, once the server has sent them.
+  // Any thread.
+  bool welcome(WelcomeInfo& info) const {
+    if (!welcomed_.load(std::memory_order_acquire))
+      return false;
+    info.playerId = playerId_.load(std::memory_order_relaxed);
+    info.ticksPerSecond = ticksPerSecond_.load(std::memory_order_relaxed);
+    return true;
+  }
+
+  // Take the newest snapshot decoded, if there is one the render thread has not taken yet.
+  // Never waits. Only the render thread may call this and latest().
+  bool takeLatest() { return latest_.take(); }
+
+  // The snapshot taken last by takeLatest().
+  const DecodedSnapshot& latest() const { return latest_.front(); }
+
+  uint64_t decoded() const { return decoded_.load(std::memory_order_relaxed); }
+
+  uint64_t skipped() const { return skipped_.load(std::memory_order_relaxed); }
+
+private:
+  void take(Message<GameMessage>& msg) {
+    if (msg.header.messageId == GameMessage::Welcome) {
+      WelcomeInfo info;
+      if (msg.getData(info) && info.ticksPerSecond > 0) {
+        snapshots_.setTicksPerSecond(info.ticksPerSecond);
+        playerId_.store(info.playerId, std::memory_order_relaxed);
+        ticksPerSecond_.store(info.ticksPerSecond, std::memory_order_relaxed);
+        welcomed_.store(true, std::memory_order_release);
+        join();
+      }
+      return;
+    }
+    BinaryReader reader(msg.body.data(), msg.body.size());
+    uint32_t seq = 0;
+    reader >> seq;
+    if (!reader.ok())
+      return;
+    if (hasNewest_) {
+      skipped_.fetch_add(1, std::memory_order_relaxed);
+      // Snapshots sent unreliably may arrive out of order.
+      if (seq <= newestSeq_)
+        return;
+    }
+    newest_ = std::move(msg);
+    newestSeq_ = seq;
+    hasNewest_ = true;
+  }
+
+  // Ask the server to play in the room.
+  void join() {
+    Message<ClientMessage> msg;
+    msg.header.messageId = ClientMessage::Join;
+    msg.setData(room_);
+    client_.send(msg);
+  }
+
+  // Tell the server which snapshot we have, so it can send deltas against it.
+  void acknowledge(uint32_t seq) {
+    Message<ClientMessage> msg;
+    msg.header.messageId = ClientMessage::SnapshotAck;
+    msg.setData(seq);
+    client_.send(msg);
+  }
+};
+
+#endif
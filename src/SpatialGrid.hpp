@@ -0,0 +1,108 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Utils.hpp"
+
+// Uniform grid for finding the rectangles that may overlap a given rectangle.
+// The grid is rebuilt from scratch with build() whenever the rectangles move; its storage is
+// kept between builds. Rectangles are referred to by their index in the vector given to build().
+// Rectangles outside the grid's area are put in the nearest cells along the edge.
+class SpatialGrid {
+  int width_;
+  int height_;
+  int cellSize_;
+  int cols_;
+  int rows_;
+  // Indices of the rectangles in each cell, stored cell after cell.
+  // The indices of cell c are entries_[cellStart_[c]] up to entries_[cellStart_[c + 1]].
+  std::vector<uint32_t> cellStart_;
+  std::vector<uint32_t> entries_;
+  // For reporting each rectangle once per query even if it spans several cells.
+  std::vector<uint32_t> lastQuery_;
+  uint32_t query_ = 0;
+
+public:
+  SpatialGrid(int width, int height, int cellSize)
+    : width_(width),
+      height_(height),
+      cellSize_(cellSize),
+      cols_((width + cellSize - 1) / cellSize),
+      rows_((height + cellSize - 1) / cellSize),
+      cellStart_(cols_ * rows_ + 1) {}
+
+  // Whether the grid was made for an area of the given size.
+  bool covers(int width, int height) const { return width_ == width && height_ == height; }
+
+  // Make room for count rectangles covering cellsEach cells at most, so that building the grid
+  // with no more of them does not allocate.
+  void reserve(std::size_t count, std::size_t cellsEach = 1) {
+    entries_.reserve(count * cellsEach);
+    lastQuery_.reserve(count);
+  }
+
+  // Put the given rectangles in the grid, replacing the previous ones.
+  void build(const std::vector<Rect>& rects) {
+    build(rects.size(), [&rects](uint32_t i) { return rects[i]; });
+  }
+
+  // Put count rectangles in the grid, replacing the previous ones. rectOf(i) gives rectangle i.
+  template <typename RectOf>
+  void build(std::size_t count, RectOf rectOf) {
+    // Count the entries of each cell, turn the counts into start offsets, then fill in the entries.
+    std::fill(cellStart_.begin(), cellStart_.end(), 0);
+    for (uint32_t i = 0; i < count; i++) {
+      forEachCell(rectOf(i), [&](int cell) { cellStart_[cell + 1]++; });
+    }
+    for (std::size_t c = 1; c < cellStart_.size(); c++)
+      cellStart_[c] += cellStart_[c - 1];
+    entries_.resize(cellStart_.back());
+    for (uint32_t i = 0; i < count; i++) {
+      forEachCell(rectOf(i), [&](int cell) { entries_[cellStart_[cell]++] = i; });
+    }
+    // Filling in advanced each start to the start of the next cell; shift them back.
+    for (std::size_t c = cellStart_.size() - 1; c > 0; c--)
+      cellStart_[c] = cellStart_[c - 1];
+    cellStart_[0] = 0;
+
+    lastQuery_.assign(count, 0);
+    query_ = 0;
+  }
+
+  // Call f(index) once for every rectangle sharing a cell with r. These are candidates only;
+  // whether they actually overlap r has to be checked by the caller.
+  template <typename F>
+  void query(Rect r, F f) {
+    query_++;
+    forEachCell(r, [&](int cell) {
+      for (uint32_t e = cellStart_[cell]; e < cellStart_[cell + 1]; e++) {
+        uint32_t i = entries_[e];
+        if (lastQuery_[i] != query_) {
+          lastQuery_[i] = query_;
+          f(i);
+        }
+      }
+    });
+  }
+
+private:
+  int clampCol(int x) const { return std::clamp(x / cellSize_, 0, cols_ - 1); }
+  int clampRow(int y) const { return std::clamp(y / cellSize_, 0, rows_ - 1); }
+
+  template <typename F>
+  void forEachCell(Rect r, F f) const {
+    int firstCol = clampCol(r.x);
+    int lastCol = clampCol(r.x + r.w - 1);
+    int firstRow = clampRow(r.y);
+    int lastRow = clampRow(r.y + r.h - 1);
+    for (int row = firstRow; row <= lastRow; row++) {
+      for (int col = firstCol; col <= lastCol; col++)
+        f(row * cols_ + col);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <cmath>
+#include <vector>
+
+#include "SDL.h"
+
+#include "Utils.hpp"
+
+// Sprites cut from one texture, gathered over a frame and drawn with a single call to
+// SDL_RenderGeometry instead of a call each. Every sprite is a quad of two triangles, rotated
+// about its centre the way SDL_RenderCopyEx rotates, clockwise by the angle in degrees. The
+// vertices and indices are kept from one frame to the next, so a batch no larger than one
+// before it does not allocate. Works with any renderer that supports geometry, the software
+// renderer included (SDL 2.0.18 and later).
+class SpriteBatch {
+  std::vector<SDL_Vertex> vertices_;
+  // Two triangles per quad, kept for the most quads there have been.
+  std::vector<int> indices_;
+
+public:
+  // Start a new frame, dropping the sprites added so far.
+  void clear() { vertices_.clear(); }
+
+  // Number of sprites added since the last clear().
+  std::size_t size() const { return vertices_.size() / 4; }
+
+  // Add a sprite drawn at dest, on the screen, rotated by angle. uv is the part of the texture
+  // to draw, in texture coordinates from 0 to 1.
+  void add(const SDL_FRect& dest, const SDL_FRect& uv, double angle) {
+    float halfW = dest.w / 2, halfH = dest.h / 2;
+    float centreX = dest.x + halfW, centreY = dest.y + halfH;
+    float c = static_cast<float>(std::cos(angle * DEG_TO_RAD));
+    float s = static_cast<float>(std::sin(angle * DEG_TO_RAD));
+    // Corners clockwise from the top left, relative to the centre.
+    const float cornerX[4] = {-halfW, halfW, halfW, -halfW};
+    const float cornerY[4] = {-halfH, -halfH, halfH, halfH};
+    const float u[4] = {uv.x, uv.x + uv.w, uv.x + uv.w, uv.x};
+    const float v[4] = {uv.y, uv.y, uv.y + uv.h, uv.y + uv.h};
+    int first = static_cast<int>(vertices_.size());
+    for (int i = 0; i < 4; i++) {
+      SDL_Vertex vertex;
+      vertex.position.x = centreX + cornerX[i] * c - cornerY[i] * s;
+      vertex.position.y = centreY + cornerX[i] * s + cornerY[i] * c;
+      vertex.color = {0xFF, 0xFF, 0xFF, 0xFF};
+      vertex.tex_coord.x = u[i];
+      vertex.tex_coord.y = v[i];
+      vertices_.push_back(vertex);
+    }
+    if (indices_.size() < 6 * size()) {
+      for (int offset : {0, 1, 2, 2, 3, 0})
+        indices_.push_back(first + offset);
+    }
+  }
+
+  // Draw the sprites added since the last clear() with the given texture. Returns 0 on
+  // success, or -1 if the renderer cannot draw geometry.
+  int draw(SDL_Renderer* renderer, SDL_Texture* texture) const {
+    if (vertices_.empty())
+      return 0;
+    return SDL_RenderGeometry(renderer, texture, vertices_.data(), static_cast<int>(vertices_.size()),
+                              indices_.data(), static_cast<int>(6 * size()));
+  }
+};
+
+#endif
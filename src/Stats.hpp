@@ -0,0 +1,283 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Counters and latency histograms of the server, exported to a stats file by bin/server. Every
+// counter has a single writer, the thread whose work it counts, and may be read from any thread
+// at any time. Building with NO_STATS defined (make NO_STATS=1) compiles the counting out:
+// StatCounter and TickStats are then empty and TickTimer reads no clock.
+#ifdef NO_STATS
+constexpr bool STATS_ENABLED = false;
+#else
+constexpr bool STATS_ENABLED = true;
+#endif
+
+// Counters of a connection's send queue.
+struct SendQueueStats {
+  // Frames waiting to be sent, including the one being written, and the most there have been.
+  std::size_t depth = 0;
+  std::size_t maxDepth = 0;
+  // Bytes of the frames waiting.
+  std::size_t bytes = 0;
+  // Frames sent, and frames replaced by a newer one before being sent.
+  uint64_t sent = 0;
+  uint64_t replaced = 0;
+};
+
+// Histogram of durations in nanoseconds, or of any other non-negative values, in the manner of
+// HdrHistogram: values below 2^SUB_BITS have a bucket each, and every range from a power of two
+// to the next is split into 2^SUB_BITS buckets, so a value is known within 1/16 of itself from
+// a nanosecond up to a minute with a few hundred buckets. Recording is a shift and an increment
+// and never allocates. Only one thread may record into a histogram at a time.
+class LatencyHistogram {
+  static const int SUB_BITS = 4;
+  // Values from 2^MAX_BITS on, about 69 s in nanoseconds, are counted in the last bucket.
+  static const int MAX_BITS = 36;
+  static const std::size_t NUM_BUCKETS = static_cast<std::size_t>(MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+  std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> max_{0};
+
+public:
+  LatencyHistogram() = default;
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  void record(uint64_t value) {
+    increment(buckets_[bucketOf(value)], 1);
+    increment(count_, 1);
+    increment(sum_, value);
+    if (value > max_.load(std::memory_order_relaxed))
+      max_.store(value, std::memory_order_relaxed);
+  }
+
+  // Add the values recorded in another histogram.
+  void add(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < NUM_BUCKETS; i++)
+      increment(buckets_[i], other.buckets_[i].load(std::memory_order_relaxed));
+    increment(count_, other.count());
+    increment(sum_, other.sum_.load(std::memory_order_relaxed));
+    if (other.max() > max())
+      max_.store(other.max(), std::memory_order_relaxed);
+  }
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+  double mean() const {
+    uint64_t n = count();
+    return n == 0 ? 0 : static_cast<double>(sum_.load(std::memory_order_relaxed)) / n;
+  }
+
+  // Value below which the given fraction of the values recorded lie, as the middle of its
+  // bucket, and never more than the largest value recorded.
+  double percentile(double fraction) const {
+    uint64_t n = count();
+    if (n == 0)
+      return 0;
+    uint64_t rank = std::min(n - 1, static_cast<uint64_t>(fraction * n));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < NUM_BUCKETS; i++) {
+      seen += buckets_[i].load(std::memory_order_relaxed);
+      if (seen > rank)
+        return std::min(lowest(i) + (width(i) - 1) / 2.0, static_cast<double>(max()));
+    }
+    return static_cast<double>(max());
+  }
+
+  // Bucket of a value.
+  static std::size_t bucketOf(uint64_t value) {
+    if (value < (uint64_t(1) << SUB_BITS))
+      return value;
+    if (value >= (uint64_t(1) << MAX_BITS))
+      return NUM_BUCKETS - 1;
+    int msb = 63 - __builtin_clzll(value);
+    uint64_t sub = (value >> (msb - SUB_BITS)) & ((uint64_t(1) << SUB_BITS) - 1);
+    return (static_cast<std::size_t>(msb - SUB_BITS + 1) << SUB_BITS) + sub;
+  }
+
+  // Smallest value of a bucket, and the number of values in it.
+  static uint64_t lowest(std::size_t bucket) {
+    std::size_t group = bucket >> SUB_BITS;
+    uint64_t sub = bucket & ((std::size_t(1) << SUB_BITS) - 1);
+    if (group == 0)
+      return sub;
+    return ((uint64_t(1) << SUB_BITS) + sub) << (group - 1);
+  }
+
+  static uint64_t width(std::size_t bucket) {
+    std::size_t group = bucket >> SUB_BITS;
+    return group == 0 ? 1 : uint64_t(1) << (group - 1);
+  }
+
+private:
+  // Add to a counter that only this thread writes, without the cost of an atomic increment.
+  static void increment(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+};
+
+// Print the count, mean, percentiles and largest value of a histogram on one line, each value
+// divided by scale, e.g. 1000 for durations in nanoseconds printed in microseconds.
+void printHistogram(std::ostream& out, const std::string& name, const LatencyHistogram& histogram, double scale = 1) {
+  out << name << " count " << histogram.count() << " mean " << histogram.mean() / scale << " p50 "
+      << histogram.percentile(0.5) / scale << " p90 " << histogram.percentile(0.9) / scale << " p99 "
+      << histogram.percentile(0.99) / scale << " p999 " << histogram.percentile(0.999) / scale << " max "
+      << histogram.max() / scale << "\n";
+}
+
+// A count that only one thread adds to.
+class StatCounter {
+#ifndef NO_STATS
+  std::atomic<uint64_t> value_{0};
+
+public:
+  void add(uint64_t n = 1) { value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+  uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+#else
+public:
+  void add(uint64_t /* n */ = 1) {}
+
+  uint64_t get() const { return 0; }
+#endif
+};
+
+// A count that several threads add to, like the io threads of a server.
+class SharedStatCounter {
+#ifndef NO_STATS
+  std::atomic<uint64_t> value_{0};
+
+public:
+  void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+
+  uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+#else
+public:
+  void add(uint64_t /* n */ = 1) {}
+
+  uint64_t get() const { return 0; }
+#endif
+};
+
+// Bytes and messages a server has received from and sent to all its clients, headers included.
+struct TrafficCounters {
+  SharedStatCounter bytesIn;
+  SharedStatCounter bytesOut;
+  SharedStatCounter messagesIn;
+  SharedStatCounter messagesOut;
+};
+
+// The phases of a room's tick (see Room::tick()), in the order they run.
+enum class TickPhase : uint8_t { Members, Messages, Simulate, Record, Snapshot, Total };
+
+const std::size_t NUM_TICK_PHASES = 6;
+
+const char* tickPhaseName(TickPhase phase) {
+  switch (phase) {
+  case TickPhase::Members: return "members";
+  case TickPhase::Messages: return "messages";
+  case TickPhase::Simulate: return "simulate";
+  case TickPhase::Record: return "record";
+  case TickPhase::Snapshot: return "snapshot";
+  case TickPhase::Total: return "total";
+  }
+  return "";
+}
+
+// How long the phases of a room's ticks took, how late they started after they were due, how
+// many messages each tick handled, how many ticks took longer than the time between two ticks
+// and how many were skipped because the room was behind (see TickScheduler.hpp).
+struct TickStats {
+#ifndef NO_STATS
+  std::array<LatencyHistogram, NUM_TICK_PHASES> phaseNs;
+  LatencyHistogram lateNs;
+  LatencyHistogram messagesPerTick;
+  StatCounter overruns;
+  StatCounter skipped;
+
+  // Add the counts of another room's stats.
+  void add(const TickStats& other) {
+    for (std::size_t i = 0; i < NUM_TICK_PHASES; i++)
+      phaseNs[i].add(other.phaseNs[i]);
+    lateNs.add(other.lateNs);
+    messagesPerTick.add(other.messagesPerTick);
+    overruns.add(other.overruns.get());
+    skipped.add(other.skipped.get());
+  }
+
+  // A tick handled the given number of messages.
+  void messages(std::size_t n) { messagesPerTick.record(n); }
+
+  // The given number of ticks were skipped.
+  void skip(uint64_t n) { skipped.add(n); }
+
+  const LatencyHistogram& phase(TickPhase phase) const { return phaseNs[static_cast<std::size_t>(phase)]; }
+#else
+  void add(const TickStats& /* other */) {}
+
+  void messages(std::size_t /* n */) {}
+
+  void skip(uint64_t /* n */) {}
+#endif
+};
+
+// Times the phases of one tick into a TickStats: each call to phase() records the time since
+// the previous one, or since the timer was made, and end() the time of the whole tick. Given
+// when the tick was due, the timer also records how late it started.
+class TickTimer {
+#ifndef NO_STATS
+  using Clock = std::chrono::steady_clock;
+
+  TickStats& stats_;
+  Clock::time_point start_ = Clock::now();
+  Clock::time_point last_ = start_;
+
+public:
+  explicit TickTimer(TickStats& stats) : stats_(stats) {}
+
+  TickTimer(TickStats& stats, Clock::time_point due) : stats_(stats) {
+    stats_.lateNs.record(start_ > due ? nanoseconds(start_ - due) : 0);
+  }
+
+  void phase(TickPhase phase) {
+    Clock::time_point now = Clock::now();
+    stats_.phaseNs[static_cast<std::size_t>(phase)].record(nanoseconds(now - last_));
+    last_ = now;
+  }
+
+  // The tick is over; it overran if it took longer than budget.
+  void end(std::chrono::nanoseconds budget) {
+    auto total = last_ - start_;
+    stats_.phaseNs[static_cast<std::size_t>(TickPhase::Total)].record(nanoseconds(total));
+    if (total > budget)
+      stats_.overruns.add();
+  }
+
+private:
+  static uint64_t nanoseconds(Clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  }
+#else
+public:
+  explicit TickTimer(TickStats& /* stats */) {}
+
+  TickTimer(TickStats& /* stats */, std::chrono::steady_clock::time_point /* due */) {}
+
+  void phase(TickPhase /* phase */) {}
+
+  void end(std::chrono::nanoseconds /* budget */) {}
+#endif
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef TICK_SCHEDULER_H
+#define TICK_SCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "Utils.hpp"
+
+// What a loop does about ticks it was too late for, after a tick or the machine took longer
+// than the time between two ticks.
+//   CatchUp  run the missed ticks back to back until the loop is on time again, so that no tick
+//            is lost, but skip any beyond the most it may be behind.
+//   Skip     skip every tick whose time has passed and wait for the next one.
+enum class OverrunPolicy : uint8_t { CatchUp, Skip };
+
+// Most ticks a loop that catches up may be behind. After a longer stall, such as the machine
+// being suspended, the ticks beyond these are skipped rather than run all at once.
+const uint32_t MAX_CATCH_UP_TICKS = 8;
+
+// How often a room ticks and what it does when it falls behind. Speeds and the fire cooldown
+// are given per second and spread over the ticks of the rate (see Game.hpp), and clients are
+// told the rate when they connect, so a room plays the same at any rate, only more or less
+// finely.
+struct TickRate {
+  uint32_t ticksPerSecond;
+  OverrunPolicy overrun;
+};
+
+const TickRate DEFAULT_TICK_RATE = {FRAMES_PER_SECOND, OverrunPolicy::CatchUp};
+
+// Deadlines of a loop ticking at a fixed rate. The deadline of the nth tick is computed from
+// the time of the first one, never from when the previous tick ended, so that the time ticks
+// take, waking up late and a rate that is not a whole number of clock ticks do not add up: n
+// ticks always take n / rate seconds. The loop waits until deadline(), runs the tick and calls
+// next(); which ticks to skip when it is behind is up to the OverrunPolicy.
+class TickScheduler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+private:
+  uint32_t ticksPerSecond_;
+  OverrunPolicy overrun_;
+  Clock::time_point start_;
+  // Number of the tick deadline() is for.
+  uint64_t tick_ = 0;
+  uint64_t skipped_ = 0;
+
+public:
+  // The first tick is due at start.
+  explicit TickScheduler(const TickRate& rate, Clock::time_point start = Clock::now())
+    : ticksPerSecond_(std::max<uint32_t>(1, rate.ticksPerSecond)), overrun_(rate.overrun), start_(start) {}
+
+  uint32_t ticksPerSecond() const { return ticksPerSecond_; }
+
+  // Time between two ticks, rounded down to a whole number of clock ticks.
+  Clock::duration period() const { return deadlineOf(1) - start_; }
+
+  // When the next tick is due.
+  Clock::time_point deadline() const { return deadlineOf(tick_); }
+
+  // Ticks skipped so far.
+  uint64_t skipped() const { return skipped_; }
+
+  // The tick due at deadline() is done at the given time. Moves the deadline on to the next
+  // tick that is to run and returns how many were skipped on the way.
+  uint64_t next(Clock::time_point now) {
+    tick_++;
+    if (now < deadline())
+      return 0;
+    // The first tick that is not due yet.
+    uint64_t notDue = ticksBefore(now) + 1;
+    uint64_t resume = notDue;
+    if (overrun_ == OverrunPolicy::CatchUp)
+      resume = notDue > tick_ + MAX_CATCH_UP_TICKS ? notDue - MAX_CATCH_UP_TICKS : tick_;
+    uint64_t skipped = resume - tick_;
+    tick_ = resume;
+    skipped_ += skipped;
+    return skipped;
+  }
+
+private:
+  Clock::time_point deadlineOf(uint64_t tick) const {
+    // In whole seconds and the rest, so that the product does not overflow in a long run.
+    uint64_t seconds = tick / ticksPerSecond_;
+    uint64_t rest = tick % ticksPerSecond_;
+    auto offset = std::chrono::seconds(seconds) + std::chrono::nanoseconds(rest * 1000000000 / ticksPerSecond_);
+    return start_ + std::chrono::duration_cast<Clock::duration>(offset);
+  }
+
+  // Number of the last tick due at or before the given time, which is not before the start.
+  uint64_t ticksBefore(Clock::time_point now) const {
+    uint64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_).count();
+    uint64_t seconds = elapsedNs / 1000000000;
+    uint64_t restNs = elapsedNs % 1000000000;
+    uint64_t tick = seconds * ticksPerSecond_ + restNs * ticksPerSecond_ / 1000000000;
+    // Rounding down the deadlines may put the next one at or before now as well.
+    while (deadlineOf(tick + 1) <= now)
+      tick++;
+    return tick;
+  }
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest of a stream of values from one thread, the writer, to another, the reader,
+// without locks and without either ever waiting for the other. There are three slots: the
+// writer fills the back one, the reader reads the front one, and publishing or taking a value
+// swaps the middle one with the back or the front in a single atomic exchange. A value
+// published before the reader took the previous one replaces it, so the reader always gets
+// the newest and never a backlog. The slots are kept, so values with storage of their own are
+// filled in again without allocating once they have grown.
+template <typename T>
+class TripleBuffer {
+  // Set in middle_ when the middle slot holds a value the reader has not taken.
+  static const uint8_t FRESH = 4;
+  static const uint8_t INDEX = 3;
+
+  std::array<T, 3> slots_;
+  // Index of the middle slot, and FRESH.
+  std::atomic<uint8_t> middle_{1};
+  // Only used by the writer.
+  uint8_t back_ = 0;
+  // Only used by the reader.
+  uint8_t front_ = 2;
+
+public:
+  TripleBuffer() = default;
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  // The slot the writer fills before publishing it. It holds an older value, or nothing.
+  T& back() { return slots_[back_]; }
+
+  // Make the value in the back slot the one the reader takes next, replacing any it has not
+  // taken yet.
+  void publish() {
+    back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Take the latest value published into the front slot. Returns false, leaving the front
+  // slot as it was, if none has been published since the last call.
+  bool take() {
+    if ((middle_.load(std::memory_order_relaxed) & FRESH) == 0)
+      return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  // The value taken last by the reader.
+  const T& front() const { return slots_[front_]; }
+};
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef UDP_CHANNEL_H
+#define UDP_CHANNEL_H
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "Codec.hpp"
+#include "Message.hpp"
+
+// Wire format of the UDP transport (UdpServer and UdpClient). Every datagram starts with the
+// protocol ID and a packet type, and datagrams with another protocol ID are ignored.
+//   Connect     Client to server, sent again and again until the server accepts.
+//   Accept      Server to client, followed by the u32 ID the server gave the connection.
+//   Data        A u32 ack, then messages up to the end of the datagram, each as a u32 sequence
+//               number, the message header and the body. The ack tells the other peer that
+//               every reliable message with a lower sequence number has arrived. Unreliable
+//               messages have sequence number 0.
+//   Disconnect  Either way. The connection is closed.
+// Integers are little-endian, as in the rest of the wire format.
+const uint32_t UDP_PROTOCOL_ID = 0x59544853; // "SHTY"
+
+enum class PacketType : uint8_t { Connect, Accept, Data, Disconnect };
+
+const std::size_t PACKET_HEADER_SIZE = sizeof(UDP_PROTOCOL_ID) + sizeof(PacketType);
+// Largest UDP payload over IPv4. Datagrams larger than the link's MTU are fragmented by IP, and
+// losing one fragment loses the datagram; for snapshots that is fine, the next one replaces it.
+const std::size_t MAX_DATAGRAM_SIZE = 65507;
+// How often the reliable messages not yet acknowledged are sent again when nothing else is
+// sent, how often a client asks to connect, and the longest time without sending anything.
+const int UDP_RESEND_MS = 100;
+// A connection that receives nothing for this long is closed, as is a connection attempt
+// that is not accepted within this time.
+const int UDP_TIMEOUT_MS = 3000;
+// A peer that leaves this many reliable messages unacknowledged is considered gone.
+const std::size_t MAX_UNACKED_RELIABLE = 256;
+
+// Start a datagram of the given type.
+std::string makePacket(PacketType type) {
+  std::string packet;
+  BinaryWriter writer(packet);
+  writer << UDP_PROTOCOL_ID << type;
+  return packet;
+}
+
+// Read the type of a datagram. Returns false if it is not of this protocol.
+bool readPacketType(const uint8_t* data, std::size_t size, PacketType& type) {
+  BinaryReader reader(data, size);
+  uint32_t protocolId = 0;
+  reader >> protocolId >> type;
+  return reader.ok() && protocolId == UDP_PROTOCOL_ID && type <= PacketType::Disconnect;
+}
+
+// Simulated network conditions for testing over loopback: every datagram sent is lost with
+// probability loss, or else delayed by delayMs to delayMs + jitterMs. Delayed datagrams can
+// overtake each other, as on a real network.
+struct LinkConditions {
+  double loss = 0;
+  int delayMs = 0;
+  int jitterMs = 0;
+};
+
+// A datagram to send: its own bytes, followed by the wire header and body of a frame if it
+// refers to one. A datagram that carries nothing but an unreliable message, as snapshots mostly
+// are, is sent straight from the message's frame instead of a copy of it, so a frame written to
+// many clients is not copied once for each.
+struct Datagram {
+  std::string bytes;
+  // Keeps the frame wireHeader and body are in alive until the datagram has been sent.
+  std::shared_ptr<const void> frame;
+  asio::const_buffer wireHeader;
+  asio::const_buffer body;
+
+  std::size_t size() const { return bytes.size() + wireHeader.size() + body.size(); }
+
+  std::array<asio::const_buffer, 3> buffers() const { return {asio::buffer(bytes), wireHeader, body}; }
+};
+
+using DatagramPtr = std::shared_ptr<const Datagram>;
+
+// A datagram of the given bytes.
+DatagramPtr makeDatagram(std::string bytes) {
+  return std::make_shared<const Datagram>(Datagram{std::move(bytes), nullptr, {}, {}});
+}
+
+// Sends the datagrams of a socket, through the simulated link conditions if any are set.
+// Must only be used on the socket's strand.
+class UdpSender {
+  asio::ip::udp::socket& socket_;
+  LinkConditions conditions_;
+  std::mt19937 rng_{std::random_device{}()};
+
+public:
+  explicit UdpSender(asio::ip::udp::socket& socket) : socket_(socket) {}
+
+  void setConditions(const LinkConditions& conditions) { conditions_ = conditions; }
+
+  // Send a datagram. owner is kept alive until the datagram has been sent.
+  void send(DatagramPtr datagram, const asio::ip::udp::endpoint& to, std::shared_ptr<const void> owner = nullptr) {
+    if (conditions_.loss > 0 && std::uniform_real_distribution<double>(0, 1)(rng_) < conditions_.loss)
+      return;
+    int delayMs = conditions_.delayMs + (conditions_.jitterMs > 0 ? rng_() % (conditions_.jitterMs + 1) : 0);
+    if (delayMs == 0) {
+      sendNow(std::move(datagram), to, std::move(owner));
+      return;
+    }
+    auto timer = std::make_shared<asio::steady_timer>(socket_.get_executor(), std::chrono::milliseconds(delayMs));
+    timer->async_wait([this, timer, datagram, to, owner](const asio::error_code& ec) {
+        if (!ec && socket_.is_open())
+          sendNow(datagram, to, owner);
+      });
+  }
+
+private:
+  void sendNow(DatagramPtr datagram, const asio::ip::udp::endpoint& to, std::shared_ptr<const void> owner) {
+    auto buffers = datagram->buffers();
+    socket_.async_send_to(buffers, to,
+                          [datagram = std::move(datagram), owner = std::move(owner)](const asio::error_code& /* ec */,
+                                                                                     std::size_t /* bytes_transferred */) {
+                            // A datagram that cannot be sent is as good as lost.
+                          });
+  }
+};
+
+// One end of a connection over UDP, without the socket. Messages are sent either reliably,
+// for messages that must all arrive in order (like inputs), or unreliably, for messages where
+// only the newest matters (like snapshots). Reliable messages stay in every datagram sent
+// until the other peer acknowledges them, so a lost datagram costs no round trip as long as
+// datagrams are sent regularly; a message is never held back waiting for one that was lost
+// before it, unless both are reliable.
+template <typename InMsgType, typename OutMsgType>
+class UdpChannel {
+  using Clock = std::chrono::steady_clock;
+
+  // Reliable messages sent but not yet acknowledged, with their sequence numbers, oldest first.
+  std::deque<std::pair<uint32_t, FramePtr<OutMsgType>>> unacked_;
+  uint32_t nextSendSeq_ = 1;
+  // Sequence number of the next reliable message to pass on.
+  uint32_t nextReceiveSeq_ = 1;
+  Clock::time_point lastReceived_ = Clock::now();
+  Clock::time_point lastSent_ = Clock::now();
+
+  static constexpr std::size_t dataHeaderSize = PACKET_HEADER_SIZE + sizeof(uint32_t);
+  static constexpr std::size_t messageHeaderSize = sizeof(uint32_t) + Header<OutMsgType>::wireSize;
+
+public:
+  // Queue a message to be delivered reliably. Returns false if the message cannot be sent, because
+  // it does not fit in a datagram or because the other peer has too many messages to acknowledge.
+  bool addReliable(FramePtr<OutMsgType> frame) {
+    if (unacked_.size() >= MAX_UNACKED_RELIABLE ||
+        dataHeaderSize + messageHeaderSize + frame->body().size() > MAX_DATAGRAM_SIZE)
+      return false;
+    unacked_.push_back({nextSendSeq_++, std::move(frame)});
+    return true;
+  }
+
+  // Make the datagrams carrying the unacknowledged reliable messages and, if given, an unreliable
+  // message, and add them to out. Usually this makes one datagram; the unreliable message gets
+  // its own if it does not fit with the others, and is dropped if it does not fit in any.
+  // With no reliable message to send, the datagram refers to the unreliable message's frame
+  // rather than copying it.
+  void makeDatagrams(const FramePtr<OutMsgType>& unreliable, std::vector<DatagramPtr>& out) {
+    lastSent_ = Clock::now();
+    if (unacked_.empty() && unreliable &&
+        dataHeaderSize + messageHeaderSize + unreliable->body().size() <= MAX_DATAGRAM_SIZE) {
+      Datagram datagram{startData(), unreliable, asio::buffer(unreliable->wireHeader()),
+                        asio::buffer(unreliable->body())};
+      BinaryWriter writer(datagram.bytes);
+      writer << uint32_t{0};
+      out.push_back(std::make_shared<const Datagram>(std::move(datagram)));
+      return;
+    }
+    std::string datagram = startData();
+    for (auto& [seq, frame] : unacked_) {
+      if (datagram.size() + messageHeaderSize + frame->body().size() > MAX_DATAGRAM_SIZE)
+        break;
+      appendMessage(datagram, seq, *frame);
+    }
+    if (unreliable) {
+      std::size_t size = messageHeaderSize + unreliable->body().size();
+      if (datagram.size() + size > MAX_DATAGRAM_SIZE && dataHeaderSize + size <= MAX_DATAGRAM_SIZE) {
+        out.push_back(makeDatagram(std::move(datagram)));
+        datagram = startData();
+      }
+      if (datagram.size() + size <= MAX_DATAGRAM_SIZE)
+        appendMessage(datagram, 0, *unreliable);
+    }
+    out.push_back(makeDatagram(std::move(datagram)));
+  }
+
+  // Take the messages out of a Data datagram, passing each to deliver(Message&&). Reliable
+  // messages are passed on once each and in the order they were sent; unreliable ones as they
+  // come. Returns false if the datagram is malformed.
+  template <typename Deliver>
+  bool receive(const uint8_t* data, std::size_t size, Deliver deliver) {
+    if (size < dataHeaderSize)
+      return false;
+    lastReceived_ = Clock::now();
+    uint32_t ack = loadLE<uint32_t>(data + PACKET_HEADER_SIZE);
+    while (!unacked_.empty() && unacked_.front().first < ack)
+      unacked_.pop_front();
+
+    std::size_t pos = dataHeaderSize;
+    while (pos < size) {
+      if (size - pos < sizeof(uint32_t) + Header<InMsgType>::wireSize)
+        return false;
+      uint32_t seq = loadLE<uint32_t>(data + pos);
+      pos += sizeof(uint32_t);
+      Message<InMsgType> msg;
+      msg.header.decode(data + pos);
+      pos += Header<InMsgType>::wireSize;
+      if (msg.header.size > size - pos)
+        return false;
+      // A reliable message other than the next one is either a copy of one already passed on or
+      // comes after one that was left out for lack of room; either way it will be sent again.
+      if (seq == 0 || seq == nextReceiveSeq_) {
+        msg.body.assign(reinterpret_cast<const char*>(data + pos), msg.header.size);
+        if (seq != 0)
+          nextReceiveSeq_++;
+        deliver(std::move(msg));
+      }
+      pos += msg.header.size;
+    }
+    return true;
+  }
+
+  // True if there are reliable messages the other peer has not acknowledged yet.
+  bool hasUnacked() const { return !unacked_.empty(); }
+
+  // Number and bytes of the reliable messages the other peer has not acknowledged yet, which
+  // are what waits to be sent on a channel.
+  std::size_t numUnacked() const { return unacked_.size(); }
+
+  std::size_t unackedBytes() const {
+    std::size_t bytes = 0;
+    for (auto& [seq, frame] : unacked_)
+      bytes += Header<OutMsgType>::wireSize + frame->body().size();
+    return bytes;
+  }
+
+  // True if nothing has been sent for the resend interval, so something should be sent to
+  // resend the unacknowledged messages, acknowledge the other peer's and keep the connection alive.
+  bool idle() const { return Clock::now() - lastSent_ >= std::chrono::milliseconds(UDP_RESEND_MS); }
+
+  // True if nothing has been received for the timeout.
+  bool timedOut() const { return Clock::now() - lastReceived_ >= std::chrono::milliseconds(UDP_TIMEOUT_MS); }
+
+private:
+  std::string startData() const {
+    std::string datagram = makePacket(PacketType::Data);
+    BinaryWriter writer(datagram);
+    writer << nextReceiveSeq_;
+    return datagram;
+  }
+
+  static void appendMessage(std::string& datagram, uint32_t seq, const Frame<OutMsgType>& frame) {
+    BinaryWriter writer(datagram);
+    writer << seq;
+    datagram.append(reinterpret_cast<const char*>(frame.wireHeader().data()), frame.wireHeader().size());
+    datagram.append(frame.body());
+  }
+};
+
+#endif
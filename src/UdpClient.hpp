@@ -0,0 +1,235 @@
+#ifndef UDP_CLIENT_H
+#define UDP_CLIENT_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+#include "asio.hpp"
+
+#include "Message.hpp"
+#include "OwnedMessage.hpp"
+#include "MPSCQueue.hpp"
+#include "UdpChannel.hpp"
+
+// Connection of a UdpClient to the server. Everything but isConnected() runs on its strand.
+template <typename InMsgType, typename OutMsgType>
+class UdpConnection : public std::enable_shared_from_this<UdpConnection<InMsgType, OutMsgType>> {
+  using Clock = std::chrono::steady_clock;
+
+  asio::strand<asio::io_context::executor_type> strand_;
+  asio::ip::udp::socket socket_;
+  asio::steady_timer timer_;
+  UdpSender sender_;
+  asio::ip::udp::endpoint serverEndpoint_;
+  // False once the connection is closed. Read by other threads than the strand's.
+  std::atomic<bool> open_{false};
+  bool accepted_ = false;
+  uint32_t id_ = 0;
+  Clock::time_point connectStart_;
+
+  UdpChannel<InMsgType, OutMsgType> channel_;
+  MPSCQueue<OwnedMessage<InMsgType>>& incomingMsgs_;
+
+  std::array<uint8_t, MAX_DATAGRAM_SIZE> receiveBuffer_;
+  asio::ip::udp::endpoint senderEndpoint_;
+
+public:
+  UdpConnection(asio::io_context& ioContext, MPSCQueue<OwnedMessage<InMsgType>>& incomingMsgs)
+    : strand_(asio::make_strand(ioContext)),
+      socket_(strand_),
+      timer_(strand_),
+      sender_(socket_),
+      incomingMsgs_(incomingMsgs) {}
+
+  // Ask the server to connect, again every resend interval until it accepts or the attempt times out.
+  void connectToServer(const asio::ip::udp::resolver::results_type& endpoints) {
+    open_ = true;
+    auto self(this->shared_from_this());
+    asio::post(strand_, [this, self, endpoint = endpoints.begin()->endpoint()]() {
+        serverEndpoint_ = endpoint;
+        asio::error_code ec;
+        socket_.open(serverEndpoint_.protocol(), ec);
+        if (ec) {
+          std::cout << "connectToServer(): " << ec.message() << "\n";
+          close();
+          return;
+        }
+        connectStart_ = Clock::now();
+        sendPacket(makePacket(PacketType::Connect));
+        receive();
+        startTimer();
+      });
+  }
+
+  void setLinkConditions(const LinkConditions& conditions) {
+    auto self(this->shared_from_this());
+    asio::post(strand_, [this, self, conditions]() { sender_.setConditions(conditions); });
+  }
+
+  // Write an encoded message to the server, reliably or not depending on its message ID.
+  // Reliable messages written before the server accepts are sent once it does; unreliable
+  // ones are dropped.
+  void write(FramePtr<OutMsgType> frame) {
+    auto self(this->shared_from_this());
+    asio::post(strand_, [this, self, frame = std::move(frame)]() {
+        if (!open_)
+          return;
+        bool reliable = isReliable(frame->header().messageId);
+        if (reliable && !channel_.addReliable(frame)) {
+          std::cout << "write(): the server does not acknowledge messages\n";
+          disconnect();
+          return;
+        }
+        if (accepted_)
+          sendData(reliable ? nullptr : frame);
+      });
+  }
+
+  bool isConnected() { return open_; }
+
+  // Close the connection, telling the server.
+  void disconnect() {
+    std::cout << "Disconnecting connection with ID " << id_ << "\n";
+    open_ = false;
+    auto self(this->shared_from_this());
+    asio::post(strand_, [this, self]() {
+        if (!socket_.is_open())
+          return;
+        // Sent right away, as the socket is closed next.
+        std::string packet = makePacket(PacketType::Disconnect);
+        asio::error_code ec;
+        socket_.send_to(asio::buffer(packet), serverEndpoint_, 0, ec);
+        close();
+      });
+  }
+
+private:
+  void receive() {
+    auto self(this->shared_from_this());
+    socket_.async_receive_from(asio::buffer(receiveBuffer_), senderEndpoint_,
+                               [this, self](const asio::error_code& ec, std::size_t size) {
+                                 if (ec == asio::error::operation_aborted || !socket_.is_open())
+                                   return;
+                                 if (!ec && senderEndpoint_ == serverEndpoint_)
+                                   handleDatagram(size);
+                                 receive();
+                               });
+  }
+
+  void handleDatagram(std::size_t size) {
+    PacketType type;
+    if (!readPacketType(receiveBuffer_.data(), size, type))
+      return;
+    switch (type) {
+    case PacketType::Accept:
+      if (!accepted_ && size >= PACKET_HEADER_SIZE + sizeof(uint32_t)) {
+        accepted_ = true;
+        id_ = loadLE<uint32_t>(receiveBuffer_.data() + PACKET_HEADER_SIZE);
+        // Send what was written while connecting.
+        sendData(nullptr);
+      }
+      break;
+
+    case PacketType::Data:
+      if (accepted_) {
+        channel_.receive(receiveBuffer_.data(), size, [this](Message<InMsgType>&& msg) {
+            incomingMsgs_.push({0, std::move(msg)});
+          });
+      }
+      break;
+
+    case PacketType::Disconnect:
+      std::cout << "The server closed the connection\n";
+      open_ = false;
+      close();
+      break;
+
+    case PacketType::Connect:
+      break;
+    }
+  }
+
+  void sendData(const FramePtr<OutMsgType>& unreliable) {
+    std::vector<DatagramPtr> datagrams;
+    channel_.makeDatagrams(unreliable, datagrams);
+    for (auto& datagram : datagrams)
+      sender_.send(std::move(datagram), serverEndpoint_, this->shared_from_this());
+  }
+
+  void sendPacket(std::string packet) {
+    sender_.send(makeDatagram(std::move(packet)), serverEndpoint_, this->shared_from_this());
+  }
+
+  // Every resend interval, ask to connect again while not accepted, and time out the
+  // connection or send to the server if nothing has been sent for a while.
+  void startTimer() {
+    auto self(this->shared_from_this());
+    timer_.expires_after(std::chrono::milliseconds(UDP_RESEND_MS));
+    timer_.async_wait([this, self](const asio::error_code& ec) {
+        if (ec || !open_)
+          return;
+        if (!accepted_) {
+          if (Clock::now() - connectStart_ >= std::chrono::milliseconds(UDP_TIMEOUT_MS)) {
+            std::cout << "connectToServer(): no answer from the server\n";
+            open_ = false;
+            close();
+            return;
+          }
+          sendPacket(makePacket(PacketType::Connect));
+        } else if (channel_.timedOut()) {
+          std::cout << "Connection to the server timed out\n";
+          open_ = false;
+          close();
+          return;
+        } else if (channel_.hasUnacked() || channel_.idle()) {
+          sendData(nullptr);
+        }
+        startTimer();
+      });
+  }
+
+  void close() {
+    open_ = false;
+    timer_.cancel();
+    asio::error_code ec;
+    socket_.close(ec);
+  }
+};
+
+// Client like Client, but connecting to a UdpServer.
+template <typename InMsgType, typename OutMsgType>
+class UdpClient {
+  std::shared_ptr<UdpConnection<InMsgType, OutMsgType>> connection_;
+
+  MPSCQueue<OwnedMessage<InMsgType>> incomingMsgs_;
+
+public:
+  // A client needs a context for the connection to work in, along with which endpoints it should connect to.
+  UdpClient(asio::io_context& ioContext, const asio::ip::udp::resolver::results_type& endpoints) {
+    connection_ = std::make_shared<UdpConnection<InMsgType, OutMsgType>>(ioContext, incomingMsgs_);
+    connection_->connectToServer(endpoints);
+  }
+
+  // Simulate a lossy network for the datagrams sent by the client.
+  void setLinkConditions(const LinkConditions& conditions) { connection_->setLinkConditions(conditions); }
+
+  MPSCQueue<OwnedMessage<InMsgType>>& getIncomingMsgs() { return incomingMsgs_; }
+
+  void send(Message<OutMsgType> msg) {
+    if (connection_->isConnected()) {
+      connection_->write(makeFrame(std::move(msg)));
+    }
+  }
+
+  bool isConnected() { return connection_->isConnected(); }
+
+  void disconnect() {
+    std::cout << "UdpClient::disconnect(): Disconnecting from server\n";
+    connection_->disconnect();
+  }
+};
+
+#endif
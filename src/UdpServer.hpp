@@ -0,0 +1,387 @@
+#ifndef UDP_SERVER_H
+#define UDP_SERVER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "Message.hpp"
+#include "OwnedMessage.hpp"
+#include "MPSCQueue.hpp"
+#include "Stats.hpp"
+#include "UdpChannel.hpp"
+#include "WakeSignal.hpp"
+
+// Most shards a UdpServer spreads its clients over.
+const std::size_t MAX_UDP_SHARDS = 64;
+
+// Server like Server, but over UDP: a client connects with a handshake and a client that sends
+// nothing for a while is disconnected. Whether a message is sent reliably is decided by
+// isReliable(message ID); see UdpChannel.
+// The clients are spread over shards, each with a socket of its own bound to the port with
+// SO_REUSEPORT, so that the kernel hands every datagram of a client to the same shard. A shard's
+// socket and peers are used on the shard's strand, so the datagrams of clients in different
+// shards are received, built and sent on as many io threads at once; a client's ID tells its
+// shard. Where SO_REUSEPORT is not available, all clients share one socket. The IDs of the
+// connected clients are shared with the game loop under a mutex, and the game loop can wait for
+// messages and clients to come or go with waitForActivity().
+template <typename InMsgType, typename OutMsgType>
+class UdpServer {
+  struct Peer {
+    uint32_t id;
+    UdpChannel<InMsgType, OutMsgType> channel;
+    // Most reliable messages waiting to be acknowledged at once, and messages sent.
+    std::size_t maxUnacked = 0;
+    uint64_t sent = 0;
+  };
+
+  struct Shard {
+    asio::strand<asio::io_context::executor_type> strand;
+    asio::ip::udp::socket socket;
+    // For resending, keeping connections alive and timing them out.
+    asio::steady_timer timer;
+    UdpSender sender;
+    std::size_t index;
+    // ID to give the next client of the shard. The IDs of shard i are i plus multiples of the
+    // number of shards.
+    uint32_t nextId;
+    // Connected clients by address, and their addresses by ID. Only used on the strand.
+    std::map<asio::ip::udp::endpoint, Peer> peers;
+    std::map<uint32_t, asio::ip::udp::endpoint> endpoints;
+    std::array<uint8_t, MAX_DATAGRAM_SIZE> receiveBuffer;
+    asio::ip::udp::endpoint senderEndpoint;
+
+    Shard(asio::io_context& ioContext, std::size_t index)
+      : strand(asio::make_strand(ioContext)), socket(strand), timer(strand), sender(socket), index(index),
+        nextId(index) {}
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // IDs of the connected clients, for the game loop.
+  std::vector<uint32_t> ids_;
+  std::mutex idsMutex_;
+  // Number of times an ID was added to or removed from ids_, counted under the mutex.
+  std::atomic<uint64_t> connectionChanges_{0};
+  // Messages from all clients, pushed by the io threads and drained by the game loop.
+  MPSCQueue<OwnedMessage<InMsgType>> incomingMsgs_;
+  // Notified after every message pushed and every change to ids_.
+  WakeSignal activity_;
+  // Bytes and messages of all clients, added on the strands.
+  TrafficCounters traffic_;
+  // Send queue counters of the clients of each shard as of its last resend interval, for other
+  // threads.
+  std::vector<std::map<uint32_t, SendQueueStats>> sendQueueStats_;
+  std::mutex statsMutex_;
+
+public:
+  // Server needs a work context, which port to be reachable from and how many shards to spread
+  // the clients over, usually as many as there are io threads.
+  UdpServer(asio::io_context& ioContext, unsigned int port, std::size_t numShards = 1) {
+#ifndef SO_REUSEPORT
+    numShards = 1;
+#endif
+    numShards = std::clamp<std::size_t>(numShards, 1, MAX_UDP_SHARDS);
+    asio::ip::udp::endpoint endpoint(asio::ip::udp::v4(), port);
+    for (std::size_t i = 0; i < numShards; i++) {
+      shards_.push_back(std::make_unique<Shard>(ioContext, i));
+      asio::ip::udp::socket& socket = shards_.back()->socket;
+      socket.open(endpoint.protocol());
+#ifdef SO_REUSEPORT
+      if (numShards > 1)
+        socket.set_option(asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+#endif
+      socket.bind(endpoint);
+      // Room for the inputs of many clients arriving between two reads.
+      socket.set_option(asio::socket_base::receive_buffer_size(1 << 20));
+    }
+    sendQueueStats_.resize(numShards);
+    std::cout << "Server listening on UDP port " << port << " with " << numShards << " sockets\n";
+    for (auto& s : shards_) {
+      asio::post(s->strand, [this, &shard = *s]() {
+          receive(shard);
+          startTimer(shard);
+        });
+    }
+  }
+
+  // Simulate a lossy network for the datagrams sent by the server.
+  void setLinkConditions(const LinkConditions& conditions) {
+    for (auto& s : shards_)
+      asio::post(s->strand, [&shard = *s, conditions]() { shard.sender.setConditions(conditions); });
+  }
+
+  int numConnections() {
+    std::scoped_lock guard(idsMutex_);
+    return ids_.size();
+  }
+
+  // Number of times a client has connected or gone. The IDs of the connections are worth
+  // getting again when it changes.
+  uint64_t connectionChanges() const { return connectionChanges_.load(std::memory_order_acquire); }
+
+  // Wait until a message has been received or a client has come or gone since the last call,
+  // or until the deadline.
+  template <typename TimePoint>
+  void waitForActivity(const TimePoint& deadline) { activity_.waitUntil(deadline); }
+
+  // Get IDs of the connections. Used for syncing number of players in the game.
+  std::vector<uint32_t> getIDs() {
+    std::scoped_lock guard(idsMutex_);
+    return ids_;
+  }
+
+  MPSCQueue<OwnedMessage<InMsgType>>& getIncomingMsgs() { return incomingMsgs_; }
+
+  // Bytes and messages received from and sent to all clients so far, datagram headers included.
+  const TrafficCounters& traffic() const { return traffic_; }
+
+  // Counters of the send queue of each client, by ID, updated every resend interval. Over UDP
+  // only reliable messages wait, until the client acknowledges them; snapshots are sent at once.
+  std::map<uint32_t, SendQueueStats> sendQueueStats() {
+    std::map<uint32_t, SendQueueStats> stats;
+    std::scoped_lock guard(statsMutex_);
+    for (auto& shardStats : sendQueueStats_)
+      stats.insert(shardStats.begin(), shardStats.end());
+    return stats;
+  }
+
+  void disconnectFrom(std::vector<uint32_t> ids) {
+    for (uint32_t id : ids)
+      disconnect(id);
+  }
+
+  // Write a message to all connected clients. The message is encoded once.
+  void writeToAll(Message<OutMsgType> msg) {
+    FramePtr<OutMsgType> frame = makeFrame(std::move(msg));
+    writeToEach([&frame](uint32_t /* id */) { return frame; });
+  }
+
+  // Write a frame to each connected client, where makeFrame(id) gives the frame for the
+  // client with the given connection ID.
+  template <typename MakeFrame>
+  void writeToEach(MakeFrame makeFrame) {
+    std::vector<uint32_t> ids = getIDs();
+    writeToEach(ids, makeFrame);
+  }
+
+  // Write a frame to each of the connected clients with the given IDs, where makeFrame(id)
+  // gives the frame for the client. The frames are handed to the shard of each client at
+  // once, so the shards send them in parallel.
+  template <typename MakeFrame>
+  void writeToEach(const std::vector<uint32_t>& ids, MakeFrame makeFrame) {
+    // Clients that are not connected are skipped by sendTo().
+    std::vector<std::vector<std::pair<uint32_t, FramePtr<OutMsgType>>>> frames(shards_.size());
+    for (uint32_t id : ids)
+      frames[id % shards_.size()].push_back({id, FramePtr<OutMsgType>(makeFrame(id))});
+    for (std::size_t i = 0; i < shards_.size(); i++) {
+      if (frames[i].empty())
+        continue;
+      asio::post(shards_[i]->strand, [this, &shard = *shards_[i], frames = std::move(frames[i])]() {
+          for (auto& [id, frame] : frames)
+            sendTo(shard, id, frame);
+        });
+    }
+  }
+
+  // Write a message to the client with the given ID, if it is connected.
+  void writeTo(uint32_t id, Message<OutMsgType> msg) {
+    Shard& shard = shardOf(id);
+    asio::post(shard.strand, [this, &shard, id, frame = makeFrame(std::move(msg))]() { sendTo(shard, id, frame); });
+  }
+
+  // Disconnect from client with the given id.
+  void disconnect(uint32_t id) {
+    removeID(id);
+    Shard& shard = shardOf(id);
+    asio::post(shard.strand, [this, &shard, id]() {
+        auto found = shard.endpoints.find(id);
+        if (found == shard.endpoints.end())
+          return;
+        std::cout << "Disconnecting connection with ID " << id << "\n";
+        sendPacket(shard, makePacket(PacketType::Disconnect), found->second);
+        removePeer(shard, found->second);
+      });
+  }
+
+private:
+  Shard& shardOf(uint32_t id) { return *shards_[id % shards_.size()]; }
+
+  // Read the next datagram from any client of the shard.
+  void receive(Shard& shard) {
+    shard.socket.async_receive_from(asio::buffer(shard.receiveBuffer), shard.senderEndpoint,
+                                    [this, &shard](const asio::error_code& ec, std::size_t size) {
+                                      if (ec == asio::error::operation_aborted)
+                                        return;
+                                      if (!ec) {
+                                        traffic_.bytesIn.add(size);
+                                        handleDatagram(shard, size);
+                                      }
+                                      // Errors of single datagrams do not affect the other clients.
+                                      receive(shard);
+                                    });
+  }
+
+  void handleDatagram(Shard& shard, std::size_t size) {
+    PacketType type;
+    if (!readPacketType(shard.receiveBuffer.data(), size, type))
+      return;
+    const asio::ip::udp::endpoint& from = shard.senderEndpoint;
+    auto found = shard.peers.find(from);
+    switch (type) {
+    case PacketType::Connect:
+      if (found == shard.peers.end()) {
+        uint32_t id = shard.nextId;
+        shard.nextId += shards_.size();
+        std::cout << "[Client connected] " << from << ". ID: " << id << "\n";
+        found = shard.peers.insert({from, Peer{id, {}}}).first;
+        shard.endpoints[id] = from;
+        std::scoped_lock guard(idsMutex_);
+        ids_.push_back(id);
+        connectionChanges_++;
+        activity_.notify();
+      }
+      // Accepted again if the client did not get the first answer.
+      sendAccept(shard, found->second.id, from);
+      break;
+
+    case PacketType::Data:
+      if (found == shard.peers.end()) {
+        // The client is not known, perhaps because it timed out or the server restarted.
+        sendPacket(shard, makePacket(PacketType::Disconnect), from);
+        break;
+      }
+      {
+        uint32_t id = found->second.id;
+        found->second.channel.receive(shard.receiveBuffer.data(), size, [this, id](Message<InMsgType>&& msg) {
+            // If the queue is full the message is dropped; the queue counts the drops.
+            traffic_.messagesIn.add();
+            incomingMsgs_.push({id, std::move(msg)});
+            activity_.notify();
+          });
+      }
+      break;
+
+    case PacketType::Disconnect:
+      if (found != shard.peers.end()) {
+        std::cout << "Client with ID " << found->second.id << " disconnected\n";
+        removeID(found->second.id);
+        removePeer(shard, from);
+      }
+      break;
+
+    case PacketType::Accept:
+      break;
+    }
+  }
+
+  // Send a frame to a client of the shard, reliably or not depending on its message ID.
+  void sendTo(Shard& shard, uint32_t id, const FramePtr<OutMsgType>& frame) {
+    auto found = shard.endpoints.find(id);
+    if (found == shard.endpoints.end())
+      return;
+    asio::ip::udp::endpoint endpoint = found->second;
+    Peer& peer = shard.peers.at(endpoint);
+    UdpChannel<InMsgType, OutMsgType>& channel = peer.channel;
+    if (isReliable(frame->header().messageId)) {
+      if (!channel.addReliable(frame)) {
+        std::cout << "Client with ID " << id << " does not acknowledge messages\n";
+        disconnect(id);
+        return;
+      }
+      peer.maxUnacked = std::max(peer.maxUnacked, channel.numUnacked());
+      sendData(shard, channel, nullptr, endpoint);
+    } else {
+      sendData(shard, channel, frame, endpoint);
+    }
+    peer.sent++;
+    traffic_.messagesOut.add();
+  }
+
+  void sendData(Shard& shard, UdpChannel<InMsgType, OutMsgType>& channel, const FramePtr<OutMsgType>& unreliable,
+                const asio::ip::udp::endpoint& endpoint) {
+    std::vector<DatagramPtr> datagrams;
+    channel.makeDatagrams(unreliable, datagrams);
+    for (auto& datagram : datagrams) {
+      traffic_.bytesOut.add(datagram->size());
+      shard.sender.send(std::move(datagram), endpoint);
+    }
+  }
+
+  void sendAccept(Shard& shard, uint32_t id, const asio::ip::udp::endpoint& endpoint) {
+    std::string packet = makePacket(PacketType::Accept);
+    BinaryWriter writer(packet);
+    writer << id;
+    sendPacket(shard, std::move(packet), endpoint);
+  }
+
+  void sendPacket(Shard& shard, std::string packet, const asio::ip::udp::endpoint& endpoint) {
+    traffic_.bytesOut.add(packet.size());
+    shard.sender.send(makeDatagram(std::move(packet)), endpoint);
+  }
+
+  // Every resend interval, time out the shard's silent clients and send to the others if
+  // nothing has been sent to them for a while.
+  void startTimer(Shard& shard) {
+    shard.timer.expires_after(std::chrono::milliseconds(UDP_RESEND_MS));
+    shard.timer.async_wait([this, &shard](const asio::error_code& ec) {
+        if (ec)
+          return;
+        std::vector<uint32_t> timedOut;
+        for (auto& [endpoint, peer] : shard.peers) {
+          if (peer.channel.timedOut())
+            timedOut.push_back(peer.id);
+          else if (peer.channel.hasUnacked() || peer.channel.idle())
+            sendData(shard, peer.channel, nullptr, endpoint);
+        }
+        for (uint32_t id : timedOut) {
+          std::cout << "Connection with ID " << id << " timed out\n";
+          removeID(id);
+          removePeer(shard, shard.endpoints.at(id));
+        }
+        if (STATS_ENABLED)
+          updateSendQueueStats(shard);
+        startTimer(shard);
+      });
+  }
+
+  void updateSendQueueStats(Shard& shard) {
+    std::map<uint32_t, SendQueueStats> stats;
+    for (auto& [endpoint, peer] : shard.peers) {
+      SendQueueStats& s = stats[peer.id];
+      s.depth = peer.channel.numUnacked();
+      s.maxDepth = peer.maxUnacked;
+      s.bytes = peer.channel.unackedBytes();
+      s.sent = peer.sent;
+    }
+    std::scoped_lock guard(statsMutex_);
+    sendQueueStats_[shard.index] = std::move(stats);
+  }
+
+  void removePeer(Shard& shard, asio::ip::udp::endpoint endpoint) {
+    auto found = shard.peers.find(endpoint);
+    if (found == shard.peers.end())
+      return;
+    shard.endpoints.erase(found->second.id);
+    shard.peers.erase(found);
+  }
+
+  void removeID(uint32_t id) {
+    std::scoped_lock guard(idsMutex_);
+    auto removed = std::remove(ids_.begin(), ids_.end(), id);
+    if (removed != ids_.end()) {
+      ids_.erase(removed, ids_.end());
+      connectionChanges_++;
+      activity_.notify();
+    }
+  }
+};
+
+#endif
@@ -1,20 +1,73 @@
 #ifndef UTILS_H
 #define UTILS_H
 
-#include "SDL.h"
+#include <cmath>
+#include <cstdint>
 
+// Size of the client's window, which shows the part of the world around the player.
 const int SCREEN_WIDTH = 1000;
 const int SCREEN_HEIGHT = 1000;
 
 const int PLAYER_SIDE = 30;
 const int BULLET_SIDE = 10;
 
+// Ticks per second games are played at unless the server is told otherwise. How fast things
+// move is given per second, and spread over the ticks of a game at whatever rate it ticks.
 const int FRAMES_PER_SECOND = 60;
 
 const double PI = 3.141592653589793238463;
 const double DEG_TO_RAD = PI / 180.0;
 
-bool collidesRect(SDL_Rect r1, SDL_Rect r2) {
+// Number of steps per turn angles are sent with in snapshots: 2 degrees. Players turn by whole
+// steps, so that their angles are sent exactly.
+const uint32_t ANGLE_STEPS = 180;
+
+// The same angle in degrees, within [0, 360).
+double wrapAngle(double angle) {
+  double wrapped = std::fmod(angle, 360.0);
+  return wrapped < 0 ? wrapped + 360.0 : wrapped;
+}
+
+// The nearest angle to the given one on a grid of the given number of steps per turn, within
+// [0, 360). Server and client both put bullets on the grid of ANGLE_STEPS when they are fired,
+// so a bullet flies the same way in both, whatever angle it was fired at.
+double quantizeAngle(double angle, uint32_t steps = ANGLE_STEPS) {
+  uint32_t step = static_cast<uint32_t>(std::lround(wrapAngle(angle) * steps / 360.0)) % steps;
+  return step * 360.0 / steps;
+}
+
+// How many whole units something going unitsPerSecond units a second goes on the nth tick,
+// counted from 1, of a game ticking ticksPerSecond times a second. The steps of any
+// ticksPerSecond ticks in a row add up to exactly unitsPerSecond, whatever the rate.
+int stepOnTick(int unitsPerSecond, uint32_t ticksPerSecond, uint32_t n) {
+  int64_t total = static_cast<int64_t>(unitsPerSecond) * n;
+  return static_cast<int>(total / ticksPerSecond - (total - unitsPerSecond) / ticksPerSecond);
+}
+
+// Axis-aligned rectangle, with the same layout as SDL_Rect. The game itself does not depend on
+// SDL; only the drawing code does.
+struct Rect {
+  int x, y;
+  int w, h;
+};
+
+// Size of the world the players move in. It is chosen when the server starts, and is sent to
+// clients as part of the game state.
+struct WorldSize {
+  int width;
+  int height;
+
+  template<class Archive>
+  void serialize(Archive& ar, const unsigned int version) {
+    ar & width;
+    ar & height;
+  }
+};
+
+// By default the world is as large as the window.
+const WorldSize DEFAULT_WORLD_SIZE = {SCREEN_WIDTH, SCREEN_HEIGHT};
+
+bool collidesRect(Rect r1, Rect r2) {
   int left_r1 = r1.x;
   int right_r1 = r1.x + r1.w;
   int top_r1 = r1.y;
@@ -0,0 +1,37 @@
+#ifndef WAKE_SIGNAL_H
+#define WAKE_SIGNAL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// Wakes a thread waiting for something to do, like messages in a queue, from any number of
+// other threads. notify() only takes the mutex when the waiter has not been told yet since it
+// last woke, so threads that notify on every message they push rarely contend.
+class WakeSignal {
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  // Whether notify() has been called since the waiter last woke.
+  std::atomic<bool> pending_{false};
+
+public:
+  void notify() {
+    if (pending_.exchange(true, std::memory_order_acq_rel))
+      return;
+    std::scoped_lock guard(mutex_);
+    cond_.notify_one();
+  }
+
+  // Wait until notify() is called, or has been since the last wait returned, or until the
+  // deadline. Returns false if woken by the deadline. What was done before notify() is visible
+  // once this returns.
+  template <typename Clock, typename Duration>
+  bool waitUntil(const std::chrono::time_point<Clock, Duration>& deadline) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait_until(lock, deadline, [this]() { return pending_.load(std::memory_order_acquire); });
+    return pending_.exchange(false, std::memory_order_acq_rel);
+  }
+};
+
+#endif
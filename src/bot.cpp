@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "Client.hpp"
+#include "UdpClient.hpp"
+#include "ClientMessage.hpp"
+#include "GameMessage.hpp"
+#include "IoThreadPool.hpp"
+#include "PlayerInput.hpp"
+#include "Snapshot.hpp"
+#include "TickScheduler.hpp"
+
+// Headless load generator: many bot clients connected to a server, each sending inputs every
+// tick of the rate the server welcomes it with and decoding every snapshot like the real
+// client, without opening any window.
+// Reports snapshot latency, bytes received, decode time and disconnects.
+// Usage: bot [clients] [seconds] [pattern] [host] [port] [udp|tcp] [rooms]
+// The bots are spread over the given number of rooms (default 1), bot i joining room i % rooms.
+// Patterns: random (random keys, with firing), move (random keys, no firing),
+//           spin (rotate in place) and idle (send empty inputs).
+
+enum class Pattern { Random, Move, Spin, Idle };
+
+bool parsePattern(const std::string& name, Pattern& pattern) {
+  if (name == "random")
+    pattern = Pattern::Random;
+  else if (name == "move")
+    pattern = Pattern::Move;
+  else if (name == "spin")
+    pattern = Pattern::Spin;
+  else if (name == "idle")
+    pattern = Pattern::Idle;
+  else
+    return false;
+  return true;
+}
+
+// One bot and what it has measured.
+template <typename GameClient>
+struct Bot {
+  std::unique_ptr<GameClient> client;
+  uint32_t room = 0;
+  SnapshotReceiver snapshots;
+  uint32_t inputSeq = 0;
+  uint8_t held = 0;
+  bool welcomed = false;
+  bool disconnected = false;
+
+  uint64_t bytes = 0;
+  uint64_t numSnapshots = 0;
+  uint64_t rejected = 0;
+};
+
+// Value below which the given fraction of the sorted values lie.
+double percentile(const std::vector<double>& sorted, double fraction) {
+  if (sorted.empty())
+    return 0;
+  std::size_t i = std::min(sorted.size() - 1, static_cast<std::size_t>(fraction * sorted.size()));
+  return sorted[i];
+}
+
+void printDistribution(const char* name, std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  std::cout << name << ": p50 " << percentile(values, 0.5) << "  p90 " << percentile(values, 0.9)
+            << "  p99 " << percentile(values, 0.99) << "  max " << (values.empty() ? 0 : values.back())
+            << "  (" << values.size() << " samples)\n";
+}
+
+// The keys a bot holds this tick. Bots keep the same keys for a while, like a player would.
+uint8_t nextKeys(Pattern pattern, uint8_t held, std::mt19937& rng) {
+  switch (pattern) {
+  case Pattern::Random:
+    return rng() % 20 == 0 ? rng() % (PlayerInput::bit(PlayerAction::FireBullet) << 1) : held;
+  case Pattern::Move:
+    return rng() % 20 == 0 ? rng() % PlayerInput::bit(PlayerAction::FireBullet) : held;
+  case Pattern::Spin:
+    return PlayerInput::bit(PlayerAction::RotateLeft);
+  case Pattern::Idle:
+    break;
+  }
+  return 0;
+}
+
+// Run the bots with clients of either transport, connecting to the given endpoints.
+template <typename GameClient, typename Endpoints>
+void run(int numBots, int seconds, Pattern pattern, uint32_t numRooms, asio::io_context& ioContext,
+         const Endpoints& endpoints) {
+  std::vector<Bot<GameClient>> bots(numBots);
+  for (int i = 0; i < numBots; i++) {
+    bots[i].client = std::make_unique<GameClient>(ioContext, endpoints);
+    bots[i].room = i % numRooms;
+  }
+  IoThreadPool ioThreads(ioContext, std::max(1u, std::thread::hardware_concurrency()));
+
+  std::mt19937 rng(std::random_device{}());
+  std::vector<double> latenciesMs;
+  std::vector<double> decodeUs;
+  int disconnects = 0;
+  // Ticks inputs are sent at, from the first welcome; the server welcomes every bot with the
+  // same rate.
+  std::optional<TickScheduler> inputClock;
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + std::chrono::seconds(seconds);
+  uint32_t tick = 0;
+  // Snapshots are taken from the queues every millisecond, so the latency measured is at most
+  // a millisecond more than the time the snapshot took to arrive. Inputs are sent every tick
+  // by the bots that have been welcomed.
+  while (std::chrono::steady_clock::now() < end) {
+    for (Bot<GameClient>& bot : bots) {
+      if (bot.disconnected)
+        continue;
+      if (!bot.client->isConnected()) {
+        bot.disconnected = true;
+        disconnects++;
+        continue;
+      }
+      bot.client->getIncomingMsgs().drain([&](OwnedMessage<GameMessage>&& ownedMsg) {
+          const Message<GameMessage>& msg = ownedMsg.msg;
+          bot.bytes += Header<GameMessage>::wireSize + msg.body.size();
+          if (msg.header.messageId == GameMessage::Welcome) {
+            WelcomeInfo info;
+            if (!msg.getData(info) || info.ticksPerSecond == 0)
+              return;
+            bot.snapshots.setTicksPerSecond(info.ticksPerSecond);
+            bot.welcomed = true;
+            if (!inputClock)
+              inputClock.emplace(TickRate{info.ticksPerSecond, OverrunPolicy::CatchUp});
+            Message<ClientMessage> join;
+            join.header.messageId = ClientMessage::Join;
+            join.setData(bot.room);
+            bot.client->send(join);
+            return;
+          }
+          auto decodeStart = std::chrono::steady_clock::now();
+          bool ok = bot.snapshots.receive(msg);
+          std::chrono::duration<double, std::micro> decodeTime = std::chrono::steady_clock::now() - decodeStart;
+          if (!ok) {
+            bot.rejected++;
+            return;
+          }
+          bot.numSnapshots++;
+          decodeUs.push_back(decodeTime.count());
+          latenciesMs.push_back((static_cast<int64_t>(systemTimeUs()) -
+                                 static_cast<int64_t>(bot.snapshots.latestTimeUs())) / 1000.0);
+          Message<ClientMessage> ack;
+          ack.header.messageId = ClientMessage::SnapshotAck;
+          ack.setData(bot.snapshots.latestSeq());
+          bot.client->send(ack);
+        });
+    }
+
+    if (inputClock && inputClock->deadline() <= TickScheduler::Clock::now()) {
+      for (Bot<GameClient>& bot : bots) {
+        if (bot.disconnected || !bot.welcomed)
+          continue;
+        bot.held = nextKeys(pattern, bot.held, rng);
+        Message<ClientMessage> msg;
+        msg.header.messageId = ClientMessage::Input;
+        msg.setData(PlayerInput{++bot.inputSeq, tick, bot.held});
+        bot.client->send(msg);
+      }
+      tick++;
+      inputClock->next(TickScheduler::Clock::now());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  uint64_t totalBytes = 0;
+  uint64_t totalSnapshots = 0;
+  uint64_t totalRejected = 0;
+  for (Bot<GameClient>& bot : bots) {
+    totalBytes += bot.bytes;
+    totalSnapshots += bot.numSnapshots;
+    totalRejected += bot.rejected;
+  }
+  std::cout << "\n" << numBots << " bots in " << numRooms << " rooms for " << elapsed.count() << " s, " << tick << " ticks";
+  if (inputClock)
+    std::cout << " at " << inputClock->ticksPerSecond() << " per second";
+  std::cout << "\n";
+  std::cout << "disconnects: " << disconnects << "\n";
+  std::cout << "snapshots decoded: " << totalSnapshots << ", rejected: " << totalRejected << "\n";
+  std::cout << "bytes received per client per second: "
+            << totalBytes / elapsed.count() / std::max(1, numBots) << "\n";
+  printDistribution("snapshot latency ms", latenciesMs);
+  printDistribution("decode time us", decodeUs);
+
+  for (Bot<GameClient>& bot : bots) {
+    if (bot.client->isConnected())
+      bot.client->disconnect();
+  }
+  // Give the disconnects time to be sent before the io threads are stopped.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+int main(int argc, char* argv[]) {
+  int numBots = argc > 1 ? std::stoi(argv[1]) : 100;
+  int seconds = argc > 2 ? std::stoi(argv[2]) : 10;
+  Pattern pattern = Pattern::Random;
+  if (argc > 3 && !parsePattern(argv[3], pattern)) {
+    std::cout << "Unknown pattern " << argv[3] << "\n";
+    return 1;
+  }
+  std::string host = argc > 4 ? argv[4] : "127.0.0.1";
+  std::string port = argc > 5 ? argv[5] : "60000";
+  std::string transport = argc > 6 ? argv[6] : "udp";
+  uint32_t numRooms = argc > 7 ? std::max(1ul, std::stoul(argv[7])) : 1;
+
+  asio::io_context ioContext;
+  if (transport == "udp") {
+    asio::ip::udp::resolver resolver(ioContext);
+    run<UdpClient<GameMessage, ClientMessage>>(numBots, seconds, pattern, numRooms, ioContext, resolver.resolve(host, port));
+  } else if (transport == "tcp") {
+    asio::ip::tcp::resolver resolver(ioContext);
+    run<Client<GameMessage, ClientMessage>>(numBots, seconds, pattern, numRooms, ioContext, resolver.resolve(host, port));
+  } else {
+    std::cout << "Unknown transport " << transport << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -1,32 +1,52 @@
 #include "asio.hpp"
 
 #include <iostream>
+#include <string>
 
 #include "Client.hpp"
+#include "UdpClient.hpp"
 #include "GameController.hpp"
 #include "GameMessage.hpp"
+#include "ClientMessage.hpp"
 
-int main() {
-
-  // The IO context does all the work for us.
-  asio::io_context ioContext;
-
-  // The resolver is used for resolving the host name and port.
-  asio::ip::tcp::resolver resolver(ioContext);
-
-  // Get endpoints based on host name and port.
-  asio::ip::tcp::resolver::results_type endpoints = resolver.resolve("127.0.0.1", "60000");
-
-
-  Client<GameMessage, PlayerAction> client(ioContext, endpoints);
-
+// Connect with the given client and play until the window is closed.
+template <typename GameClient>
+void play(asio::io_context& ioContext, GameClient& client, uint32_t room) {
   // Thread for Asio to work in.
   std::thread t([&]() { ioContext.run(); });
 
-  GameController gameController(client);
+  GameController<GameClient> gameController(client, room);
   gameController.start();
 
   // Wait for the thread that asio works in to end.
   if (t.joinable())
     t.join();
 }
+
+// Usage: client [udp|tcp] [room]
+// Use the same transport as the server. Clients that give the same room play together.
+int main(int argc, char* argv[]) {
+
+  // The IO context does all the work for us.
+  asio::io_context ioContext;
+  std::string transport = argc > 1 ? argv[1] : "udp";
+  uint32_t room = argc > 2 ? std::stoul(argv[2]) : 0;
+
+  if (transport == "udp") {
+    // The resolver is used for resolving the host name and port.
+    asio::ip::udp::resolver resolver(ioContext);
+    // Get endpoints based on host name and port.
+    asio::ip::udp::resolver::results_type endpoints = resolver.resolve("127.0.0.1", "60000");
+    UdpClient<GameMessage, ClientMessage> client(ioContext, endpoints);
+    play(ioContext, client, room);
+  } else if (transport == "tcp") {
+    asio::ip::tcp::resolver resolver(ioContext);
+    asio::ip::tcp::resolver::results_type endpoints = resolver.resolve("127.0.0.1", "60000");
+    Client<GameMessage, ClientMessage> client(ioContext, endpoints);
+    play(ioContext, client, room);
+  } else {
+    std::cout << "Unknown transport " << transport << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Match.hpp"
+#include "Replay.hpp"
+
+// Plays a room recorded by the server (see Replay.hpp) again, headless and as fast as it goes,
+// for profiling real match traffic. The recorded members, inputs and acknowledgements are fed
+// to a Match between the same ticks as in the room, so the game goes exactly the same way; the
+// checks in the recording make sure of it. Reports the time per tick and how much faster than
+// the room the match was played.
+// Usage: replay <file> [full|game] [runs]
+// Modes: full (the default) also encodes every member's snapshot frames, as the room does;
+//        game only applies the inputs and advances the game.
+
+enum class Mode { Full, Game };
+
+struct Result {
+  uint32_t ticks = 0;
+  std::size_t maxMembers = 0;
+  uint64_t inputs = 0;
+  uint64_t frameBytes = 0;
+  uint32_t checks = 0;
+  uint32_t mismatches = 0;
+  // First tick at which the game was not what it was in the room.
+  uint32_t firstMismatch = 0;
+  bool complete = true;
+  std::vector<double> tickUs;
+};
+
+Result replay(ReplayReader& reader, Mode mode) {
+  Match match(reader.ticksPerSnapshot(), reader.world(), reader.ticksPerSecond());
+  std::vector<uint32_t> members;
+  Result result;
+  ReplayEvent event;
+  while (reader.next(event)) {
+    switch (event.type) {
+    case ReplayRecord::Members:
+      members = event.members;
+      match.setMembers(members);
+      result.maxMembers = std::max(result.maxMembers, members.size());
+      break;
+
+    case ReplayRecord::Input:
+      match.input(event.id, event.input);
+      result.inputs++;
+      break;
+
+    case ReplayRecord::Ack:
+      match.ack(event.id, event.seq);
+      break;
+
+    case ReplayRecord::Tick:
+      {
+        auto start = std::chrono::steady_clock::now();
+        // The room disconnects players whose input it cannot apply, which shows up in the
+        // recording as a change of members.
+        match.tick([](uint32_t) {});
+        if (mode == Mode::Full && match.snapshot()) {
+          for (uint32_t id : members)
+            result.frameBytes += match.frameFor(id)->body().size();
+        }
+        auto end = std::chrono::steady_clock::now();
+        result.tickUs.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        result.ticks++;
+      }
+      break;
+
+    case ReplayRecord::Check:
+      result.checks++;
+      if (event.tick != match.game().getTick() || event.hash != stateHash(match.game())) {
+        if (result.mismatches == 0)
+          result.firstMismatch = match.game().getTick();
+        result.mismatches++;
+      }
+      break;
+    }
+  }
+  result.complete = reader.ok();
+  return result;
+}
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+  if (sorted.empty())
+    return 0;
+  std::size_t i = std::min(sorted.size() - 1, static_cast<std::size_t>(fraction * sorted.size()));
+  return sorted[i];
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cout << "Usage: replay <file> [full|game] [runs]\n";
+    return 1;
+  }
+  std::string path = argv[1];
+  std::string modeName = argc > 2 ? argv[2] : "full";
+  Mode mode;
+  if (modeName == "full") {
+    mode = Mode::Full;
+  } else if (modeName == "game") {
+    mode = Mode::Game;
+  } else {
+    std::cout << "Unknown mode " << modeName << "\n";
+    return 1;
+  }
+  int runs = argc > 3 ? std::max(1, std::stoi(argv[3])) : 1;
+
+  bool ok = true;
+  for (int run = 0; run < runs; run++) {
+    ReplayReader reader(path);
+    if (!reader.ok()) {
+      std::cout << "Cannot read a recording from " << path << "\n";
+      return 1;
+    }
+    if (run == 0) {
+      std::cout << path << ": " << reader.size() << " bytes, world " << reader.world().width << " x "
+                << reader.world().height << ", " << reader.ticksPerSecond() << " ticks per second, a snapshot every "
+                << reader.ticksPerSnapshot() << " ticks\n";
+    }
+    auto start = std::chrono::steady_clock::now();
+    Result result = replay(reader, mode);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> tickUs = result.tickUs;
+    std::sort(tickUs.begin(), tickUs.end());
+    double meanUs = 0;
+    for (double us : tickUs)
+      meanUs += us;
+    meanUs = tickUs.empty() ? 0 : meanUs / tickUs.size();
+    double matchSeconds = static_cast<double>(result.ticks) / reader.ticksPerSecond();
+    std::cout << "run " << run + 1 << ": " << result.ticks << " ticks (" << matchSeconds << " s of play), up to "
+              << result.maxMembers << " players, " << result.inputs << " inputs";
+    if (mode == Mode::Full)
+      std::cout << ", " << result.frameBytes << " bytes of snapshots";
+    std::cout << "\n  " << seconds << " s, " << (seconds > 0 ? result.ticks / seconds : 0) << " ticks/s, "
+              << (seconds > 0 ? matchSeconds / seconds : 0) << "x real time\n";
+    std::cout << "  us per tick: mean " << meanUs << "  p50 " << percentile(tickUs, 0.5) << "  p99 "
+              << percentile(tickUs, 0.99) << "  max " << (tickUs.empty() ? 0 : tickUs.back()) << "\n";
+    if (!result.complete)
+      std::cout << "  the recording is malformed after tick " << result.ticks << "\n";
+    if (result.mismatches > 0) {
+      std::cout << "  " << result.mismatches << " of " << result.checks
+                << " checks do not match the room, the first at tick " << result.firstMismatch << "\n";
+      ok = false;
+    } else {
+      std::cout << "  " << result.checks << " checks match the room\n";
+    }
+  }
+  return ok ? 0 : 1;
+}
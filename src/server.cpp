@@ -1,51 +1,140 @@
 #include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <memory>
 #include <thread>
 #include <chrono>
+#include <string>
 
 #include "Server.hpp"
-#include "Game.hpp"
+#include "UdpServer.hpp"
+#include "IoThreadPool.hpp"
 #include "GameMessage.hpp"
-#include "TSQueue.hpp"
+#include "ClientMessage.hpp"
+#include "Lobby.hpp"
+#include "Stats.hpp"
+#include "TickScheduler.hpp"
 
-int main()
+// How often the stats file is rewritten.
+const auto STATS_INTERVAL = std::chrono::seconds(1);
+
+// Rewrite the stats file with the counters of the server and its rooms since it started, one
+// line each: a name and then keys and values. Durations are in microseconds. The file is
+// written beside the path and renamed over it, so a reader never sees half of it.
+template <typename GameServer>
+void writeStats(const std::string& path, GameServer& server, const Lobby<GameServer>& lobby, double uptime)
 {
-  Game game;
-  
-  asio::io_context ioContext;
-  unsigned int port = 60000;
-  Server<PlayerAction, GameMessage> server(ioContext, port);
-  std::thread t([&]() { ioContext.run(); });
-  
-  //server.writeToAll(game);
-  TSQueue<OwnedMessage<PlayerAction>>& incomingMsgs = server.getIncomingMsgs();
-  int numPlayers = 0;
-  while(true) {
-    if (game.getNumPlayers() != server.numConnections()) {
-      game.syncPlayers(server.getIDs());
+#ifndef NO_STATS
+  std::string tempPath = path + ".tmp";
+  {
+    std::ofstream out(tempPath);
+    if (!out) {
+      std::cout << "Cannot write stats to " << tempPath << "\n";
+      return;
+    }
+    auto ticks = std::make_unique<TickStats>();
+    lobby.addTickStats(*ticks);
+    out << "uptime_s " << uptime << "\n";
+    out << "connections " << server.numConnections() << "\n";
+    out << "rooms " << lobby.numRooms() << "\n";
+    out << "tick_overruns " << ticks->overruns.get() << "\n";
+    out << "ticks_skipped " << ticks->skipped.get() << "\n";
+    for (std::size_t i = 0; i < NUM_TICK_PHASES; i++) {
+      TickPhase phase = static_cast<TickPhase>(i);
+      printHistogram(out, std::string("tick_us ") + tickPhaseName(phase), ticks->phase(phase), 1000);
     }
-    // If any incoming messages, update game state according to them
-    while (!incomingMsgs.empty()) {
-      OwnedMessage<PlayerAction> ownedMessage = incomingMsgs.pop();
-      uint32_t id = ownedMessage.id;
-      PlayerAction action = ownedMessage.msg.header.messageId;
-      if (!game.performAction(id, action)) {
-        //std::cout << "player " << id << " not found\n";
-        server.disconnect(id);
-      }
+    printHistogram(out, "tick_late_us", ticks->lateNs, 1000);
+    printHistogram(out, "room_messages_per_tick", ticks->messagesPerTick);
+    out << "messages_dropped lobby " << server.getIncomingMsgs().dropped() << " rooms " << lobby.droppedMessages()
+        << "\n";
+    const TrafficCounters& traffic = server.traffic();
+    out << "traffic bytes_in " << traffic.bytesIn.get() << " bytes_out " << traffic.bytesOut.get()
+        << " messages_in " << traffic.messagesIn.get() << " messages_out " << traffic.messagesOut.get() << "\n";
+    for (auto& [id, queue] : server.sendQueueStats()) {
+      out << "send_queue id " << id << " depth " << queue.depth << " max_depth " << queue.maxDepth << " bytes "
+          << queue.bytes << " sent " << queue.sent << " replaced " << queue.replaced << "\n";
     }
+  }
+  std::rename(tempPath.c_str(), path.c_str());
+#endif
+}
 
-    std::vector<uint32_t> idsToRemove = game.advance();
-    if (!idsToRemove.empty()) {
-      server.disconnectFrom(idsToRemove);
+// Host rooms for the clients of the server, over either transport. Each room runs its own game
+// on its own thread; this thread only routes connections and their messages to the rooms, and
+// writes the stats file if there is one. It sleeps until the server wakes it with a message or
+// a connection coming or going, so messages are passed on to their rooms as soon as they arrive.
+template <typename GameServer>
+void serve(GameServer& server, uint32_t ticksPerSnapshot, const WorldSize& world, const std::string& replayDir,
+           const std::string& statsPath, const TickRate& rate)
+{
+  Lobby<GameServer> lobby(server, ticksPerSnapshot, world, replayDir, rate);
+  auto start = std::chrono::steady_clock::now();
+  auto nextStats = start + STATS_INTERVAL;
+  while(true) {
+    lobby.update();
+    auto now = std::chrono::steady_clock::now();
+    if (now >= nextStats) {
+      if (!statsPath.empty())
+        writeStats(statsPath, server, lobby, std::chrono::duration<double>(now - start).count());
+      nextStats += STATS_INTERVAL;
     }
-      
-    Message<GameMessage> msg;
-    msg.header.messageId = GameMessage::GameState;
-    msg.setData(game);
-    server.writeToAll(msg);
-    std::this_thread::sleep_for(std::chrono::milliseconds(1000 / FRAMES_PER_SECOND));
+    // A full queue may not have been drained in one update.
+    if (server.getIncomingMsgs().empty())
+      server.waitForActivity(nextStats);
+  }
+}
+
+// Usage: server [number of io threads] [ticks per snapshot] [udp|tcp] [world width] [world height] [replay directory]
+//               [stats file] [ticks per second] [catchup|skip]
+// Clients pick a room to play in when they connect; every room has a world of the given size.
+// Given a directory, every room is recorded there and can be played again with bin/replay.
+// Given a stats file, it is rewritten every second with how long the rooms' ticks take, the
+// server's traffic and the send queue of each client. An empty argument skips either.
+// Rooms tick FRAMES_PER_SECOND times a second unless told otherwise (see TickScheduler.hpp), and
+// clients are told the rate when they connect; a room that falls behind catches up on the ticks
+// it missed, or skips them.
+// Over UDP a lost snapshot does not hold up the ones after it, and the clients are spread over a
+// socket per io thread. TCP is there for networks that block UDP.
+int main(int argc, char* argv[])
+{
+  asio::io_context ioContext;
+  unsigned int port = 60000;
+  // Threads doing the network io; the rooms have their own threads.
+  std::size_t numIoThreads = argc > 1 ? std::stoul(argv[1]) : 1;
+  // Snapshots can be sent less often than every tick; clients interpolate between them.
+  uint32_t ticksPerSnapshot = argc > 2 ? std::max(1ul, std::stoul(argv[2])) : 1;
+  std::string transport = argc > 3 ? argv[3] : "udp";
+  WorldSize world = DEFAULT_WORLD_SIZE;
+  if (argc > 5)
+    world = {std::max(2 * PLAYER_SIDE, std::stoi(argv[4])), std::max(2 * PLAYER_SIDE, std::stoi(argv[5]))};
+  std::string replayDir = argc > 6 ? argv[6] : "";
+  std::string statsPath = argc > 7 ? argv[7] : "";
+  TickRate rate = DEFAULT_TICK_RATE;
+  if (argc > 8)
+    rate.ticksPerSecond = std::max(1ul, std::stoul(argv[8]));
+  std::string overrun = argc > 9 ? argv[9] : "catchup";
+  if (overrun == "skip") {
+    rate.overrun = OverrunPolicy::Skip;
+  } else if (overrun != "catchup") {
+    std::cout << "Unknown overrun policy " << overrun << "\n";
+    return 1;
+  }
+  if (!statsPath.empty() && !STATS_ENABLED) {
+    std::cout << "The server is built without stats (NO_STATS), so " << statsPath << " is not written\n";
+    statsPath.clear();
   }
 
-  
+  if (transport == "udp") {
+    UdpServer<ClientMessage, GameMessage> server(ioContext, port, numIoThreads);
+    IoThreadPool ioThreads(ioContext, numIoThreads);
+    serve(server, ticksPerSnapshot, world, replayDir, statsPath, rate);
+  } else if (transport == "tcp") {
+    Server<ClientMessage, GameMessage> server(ioContext, port);
+    IoThreadPool ioThreads(ioContext, numIoThreads);
+    serve(server, ticksPerSnapshot, world, replayDir, statsPath, rate);
+  } else {
+    std::cout << "Unknown transport " << transport << "\n";
+    return 1;
+  }
   return 0;
 }